@@ -0,0 +1,161 @@
+// Code size and throughput of an assertion-heavy inner loop with and
+// without moving the failure path out of line (DLG_OUTLINE_COLD).
+// The code size of the kernels is read from the symbol table of the
+// executable (linux only), the size of the hot part does not include
+// the outlined lambdas and the .cold part generated by gcc.
+
+#define ASSERTS_KERNEL asserts_outlined
+#include "asserts_kernel.h"
+#include "bench.h"
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+	#include <elf.h>
+#endif
+
+extern "C" unsigned long long asserts_inline(const unsigned* data, unsigned size,
+	unsigned iterations);
+
+namespace {
+
+constexpr auto kernel_size = 1024u;
+
+struct Kernel {
+	const char* name;
+	const char* symbol;
+	unsigned long long (*func)(const unsigned*, unsigned, unsigned);
+	std::vector<unsigned>* data;
+	unsigned long long sum;
+};
+
+// runs the kernel for the given number of loop iterations
+void bench_kernel(void* data, unsigned iterations) {
+	auto& kernel = *static_cast<Kernel*>(data);
+	kernel.sum += kernel.func(kernel.data->data(), kernel_size, iterations / kernel_size);
+	kernel.sum += kernel.func(kernel.data->data(), iterations % kernel_size, 1u);
+}
+
+#ifdef __linux__
+
+// Returns the size of the given symbol and the summed size of all local
+// symbols starting with "<symbol>." or containing it mangled, i.e. the
+// outlined parts. Returns false if the symbol table could not be read.
+bool symbol_size(const char* symbol, unsigned long long& hot,
+		unsigned long long& outlined) {
+	FILE* file = std::fopen("/proc/self/exe", "rb");
+	if(!file) {
+		return false;
+	}
+
+	std::vector<char> buf;
+	char chunk[65536];
+	std::size_t read;
+	while((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		buf.insert(buf.end(), chunk, chunk + read);
+	}
+	std::fclose(file);
+
+	if(buf.size() < sizeof(Elf64_Ehdr) ||
+			std::memcmp(buf.data(), ELFMAG, SELFMAG) != 0 ||
+			buf[EI_CLASS] != ELFCLASS64) {
+		return false;
+	}
+
+	Elf64_Ehdr ehdr;
+	std::memcpy(&ehdr, buf.data(), sizeof(ehdr));
+	if(ehdr.e_shoff + std::size_t(ehdr.e_shnum) * sizeof(Elf64_Shdr) > buf.size()) {
+		return false;
+	}
+
+	std::vector<Elf64_Shdr> sections(ehdr.e_shnum);
+	std::memcpy(sections.data(), buf.data() + ehdr.e_shoff,
+		sections.size() * sizeof(Elf64_Shdr));
+
+	// the mangled name of local entities of the function, e.g. lambdas
+	char mangled[128];
+	std::snprintf(mangled, sizeof(mangled), "%zu%s", std::strlen(symbol), symbol);
+	auto symlen = std::strlen(symbol);
+
+	bool found = false;
+	hot = outlined = 0u;
+	for(auto& section : sections) {
+		if(section.sh_type != SHT_SYMTAB || section.sh_link >= sections.size()) {
+			continue;
+		}
+
+		auto& strtab = sections[section.sh_link];
+		auto count = section.sh_size / sizeof(Elf64_Sym);
+		for(auto i = 0u; i < count; ++i) {
+			Elf64_Sym sym;
+			std::memcpy(&sym, buf.data() + section.sh_offset + i * sizeof(sym), sizeof(sym));
+			if(ELF64_ST_TYPE(sym.st_info) != STT_FUNC) {
+				continue;
+			}
+
+			auto name = buf.data() + strtab.sh_offset + sym.st_name;
+			if(std::strcmp(name, symbol) == 0) {
+				hot = sym.st_size;
+				found = true;
+			} else if((std::strncmp(name, symbol, symlen) == 0 && name[symlen] == '.') ||
+					std::strstr(name, mangled)) {
+				outlined += sym.st_size;
+			}
+		}
+	}
+
+	return found;
+}
+
+#else // __linux__
+
+bool symbol_size(const char*, unsigned long long&, unsigned long long&) {
+	return false;
+}
+
+#endif // __linux__
+
+} // anon namespace
+
+int main(int argc, char** argv) {
+	struct bench bench;
+	if(!bench_begin(&bench, "asserts", argc, argv)) {
+		return EXIT_FAILURE;
+	}
+
+	std::vector<unsigned> data(kernel_size);
+	for(auto i = 0u; i < kernel_size; ++i) {
+		data[i] = (i * 7u) % 1000u;
+	}
+
+	Kernel kernels[] = {
+		{"assert_loop_outlined", "asserts_outlined", asserts_outlined, &data, 0u},
+		{"assert_loop_inline", "asserts_inline", asserts_inline, &data, 0u},
+	};
+
+	for(auto& kernel : kernels) {
+		// ns_per_record is the time per loop iteration with 4 assertions
+		bench_run(&bench, kernel.name, bench_kernel, &kernel);
+		if(bench.filter && !std::strstr(kernel.name, bench.filter)) {
+			continue;
+		}
+
+		unsigned long long hot, outlined;
+		if(symbol_size(kernel.symbol, hot, outlined)) {
+			std::fprintf(bench.out, ",\n  {\"name\": \"%s_code_size\", "
+				"\"hot_bytes\": %llu, \"outlined_bytes\": %llu}",
+				kernel.name, hot, outlined);
+			std::fprintf(stderr, "%-40s %10llu bytes hot, %llu bytes outlined\n",
+				kernel.name, hot, outlined);
+		}
+	}
+
+	// keep the results alive
+	if(kernels[0].sum == 42u) {
+		std::printf("\n");
+	}
+
+	return bench_end(&bench);
+}
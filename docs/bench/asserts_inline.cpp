@@ -0,0 +1,4 @@
+// The kernel without cold-path outlining.
+#define DLG_OUTLINE_COLD 0
+#define ASSERTS_KERNEL asserts_inline
+#include "asserts_kernel.h"
@@ -0,0 +1,23 @@
+// Assertion-heavy inner loop, compiled with and without DLG_OUTLINE_COLD
+// (see asserts.cpp and asserts_inline.cpp). Define ASSERTS_KERNEL as the
+// name of the function before including this file.
+
+#include <dlg/dlg.hpp>
+
+extern "C" unsigned long long ASSERTS_KERNEL(const unsigned* data, unsigned size,
+		unsigned iterations);
+
+extern "C" unsigned long long ASSERTS_KERNEL(const unsigned* data, unsigned size,
+		unsigned iterations) {
+	unsigned long long sum = 0u;
+	for(auto it = 0u; it < iterations; ++it) {
+		for(auto i = 0u; i < size; ++i) {
+			dlg_assertm(i < size, "index {} out of range {}", i, size);
+			dlg_assert(data[i] < 1000u);
+			dlg_assertm(data[i] != 0xdeadbeefu, "poisoned value at {}", i);
+			dlg_assertl(dlg_level_warn, sum < (1ull << 62));
+			sum += data[i];
+		}
+	}
+	return sum;
+}
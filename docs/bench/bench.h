@@ -0,0 +1,102 @@
+// Minimal benchmark harness shared by the dlg benchmarks.
+// Every benchmark is run in growing batches until it took at least
+// BENCH_MIN_TIME seconds, results are written as json to stdout or
+// the file given as first argument:
+// {"suite": "...", "results": [{"name": "...", "iterations": 123,
+//   "ns_per_record": 12.3, "records_per_sec": 1234.5}, ...]}
+
+#ifndef DLG_BENCH_H_
+#define DLG_BENCH_H_
+
+#ifndef _POSIX_C_SOURCE
+	#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef BENCH_MIN_TIME
+	#define BENCH_MIN_TIME 0.2
+#endif
+
+typedef void (*bench_func)(void* data, unsigned iterations);
+
+struct bench {
+	FILE* out;
+	bool first;
+	unsigned count;
+	const char* filter; // only run benchmarks containing this
+};
+
+static inline double bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+// Usage: <bench> [output.json] [name filter]
+static inline bool bench_begin(struct bench* bench, const char* suite,
+		int argc, char** argv) {
+	bench->out = stdout;
+	bench->first = true;
+	bench->count = 0;
+	bench->filter = (argc > 2) ? argv[2] : NULL;
+	if(argc > 1 && strcmp(argv[1], "-") != 0) {
+		bench->out = fopen(argv[1], "w");
+		if(!bench->out) {
+			fprintf(stderr, "bench: could not open %s\n", argv[1]);
+			return false;
+		}
+	}
+
+	fprintf(bench->out, "{\"suite\": \"%s\", \"results\": [", suite);
+	return true;
+}
+
+static inline void bench_result(struct bench* bench, const char* name,
+		unsigned long long iterations, double secs) {
+	double ns = 1e9 * secs / (double) iterations;
+	fprintf(bench->out, "%s\n  {\"name\": \"%s\", \"iterations\": %llu, "
+		"\"ns_per_record\": %.2f, \"records_per_sec\": %.0f}",
+		bench->first ? "" : ",", name, iterations, ns, (double) iterations / secs);
+	fflush(bench->out);
+	fprintf(stderr, "%-40s %10.2f ns/record\n", name, ns);
+	bench->first = false;
+	++bench->count;
+}
+
+static inline void bench_run(struct bench* bench, const char* name,
+		bench_func func, void* data) {
+	if(bench->filter && !strstr(name, bench->filter)) {
+		return;
+	}
+
+	func(data, 16); // warm up, allocate thread buffers
+
+	unsigned iterations = 64;
+	unsigned long long total = 0;
+	double secs = 0.0;
+	while(secs < BENCH_MIN_TIME) {
+		double start = bench_now();
+		func(data, iterations);
+		secs += bench_now() - start;
+		total += iterations;
+		if(iterations < (1u << 24)) {
+			iterations *= 2;
+		}
+	}
+
+	bench_result(bench, name, total, secs);
+}
+
+static inline int bench_end(struct bench* bench) {
+	fprintf(bench->out, "\n]}\n");
+	if(bench->out != stdout) {
+		fclose(bench->out);
+	}
+	return 0;
+}
+
+#endif // header guard
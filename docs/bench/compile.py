@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+# Measures the compile-time cost of the dlg headers for a translation unit
+# that only logs: the size of the preprocessed source and the time to
+# compile it (best of several runs). Results are written as json like the
+# other benchmarks, to stdout or the file given with --output.
+# Usage: compile.py [--output file] [--runs n] <include dir> <compiler...>
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+# header variant: (name, prelude, extra compiler args)
+variants = [
+	('dlg.h', '#include <dlg/dlg.h>\n', []),
+	('dlg.hpp', '#include <dlg/dlg.hpp>\n', []),
+	('dlg.hpp_tlformat', '#include <dlg/dlg.hpp>\n',
+		['-DDLG_FORMAT_DEFAULT_REPLACE="{}"']),
+	('lite.hpp', '#include <dlg/lite.hpp>\n', []),
+]
+
+# dlg.h uses printf format strings, the other variants "{}"
+body_fmt = '''
+void log_values(int count, double ratio, const char* name) {
+	dlg_info(FMT("count {}", "count %d"), count);
+	dlg_warn(FMT("ratio {} of {}", "ratio %f of %s"), ratio, name);
+	dlg_errort(("io"), FMT("failed: {} {} {}", "failed: %d %f %s"), count, ratio, name);
+	dlg_debug(FMT("plain", "plain"));
+}
+'''
+
+def source(prelude, printf):
+	macro = '#define FMT(a, b) b\n' if printf else '#define FMT(a, b) a\n'
+	return prelude + macro + body_fmt
+
+def main():
+	parser = argparse.ArgumentParser()
+	parser.add_argument('--output', default='-')
+	parser.add_argument('--runs', type=int, default=5)
+	parser.add_argument('include')
+	parser.add_argument('compiler', nargs=argparse.REMAINDER)
+	args = parser.parse_args()
+
+	base = args.compiler + ['-std=c++20', '-I', args.include]
+	results = []
+	with tempfile.TemporaryDirectory() as tmp:
+		for name, prelude, extra in variants:
+			path = os.path.join(tmp, name.replace('.', '_') + '.cpp')
+			with open(path, 'w') as f:
+				f.write(source(prelude, name == 'dlg.h'))
+
+			pre = subprocess.run(base + extra + ['-E', '-P', path],
+				check=True, stdout=subprocess.PIPE).stdout
+
+			best = None
+			obj = os.path.join(tmp, 'out.o')
+			for _ in range(args.runs):
+				start = time.perf_counter()
+				subprocess.run(base + extra + ['-c', path, '-o', obj], check=True)
+				secs = time.perf_counter() - start
+				best = secs if best is None else min(best, secs)
+
+			results.append({
+				'name': name,
+				'preprocessed_bytes': len(pre),
+				'preprocessed_lines': pre.count(b'\n'),
+				'compile_ms': round(best * 1000, 1),
+			})
+			print('{:<20} {:>10} bytes {:>8} lines {:>8.1f} ms'.format(name,
+				len(pre), pre.count(b'\n'), best * 1000), file=sys.stderr)
+
+	out = sys.stdout if args.output == '-' else open(args.output, 'w')
+	json.dump({'suite': 'compile', 'results': results}, out, indent=1)
+	out.write('\n')
+
+if __name__ == '__main__':
+	main()
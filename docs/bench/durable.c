@@ -0,0 +1,125 @@
+// Throughput of durable logging (every record synced before the call
+// returns) by number of threads:
+// - sync_each: write and fdatasync per record under a lock, like
+//   dlg_default_output followed by an fsync
+// - group_commit: dlg_file_write with dlg_durability_sync, concurrent
+//   waiters share the syncs
+// Each thread logs until BENCH_MIN_TIME passed. The file is created in
+// the working directory (the build directory for meson), syncs on tmpfs
+// are free and would not show the difference.
+// Usage: bench_durable [output.json] [name filter] [max threads]
+
+#include "bench.h"
+#include <dlg/file.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#define BENCH_FILE "bench_durable.log"
+
+struct config {
+	struct dlg_file* file; // group_commit
+	int fd; // sync_each
+	pthread_mutex_t mutex;
+	double end;
+	unsigned long long records;
+};
+
+static const char record[] = "2026-10-18 12:00:00 error [durable.c:1] audit record\n";
+
+static void* sync_each(void* data) {
+	struct config* config = (struct config*) data;
+	unsigned long long count = 0u;
+	while(bench_now() < config->end) {
+		pthread_mutex_lock(&config->mutex);
+		if(write(config->fd, record, sizeof(record) - 1) < 0 ||
+				fdatasync(config->fd) != 0) {
+			fprintf(stderr, "bench_durable: write failed\n");
+		}
+		pthread_mutex_unlock(&config->mutex);
+		++count;
+	}
+
+	pthread_mutex_lock(&config->mutex);
+	config->records += count;
+	pthread_mutex_unlock(&config->mutex);
+	return NULL;
+}
+
+static void* group_commit(void* data) {
+	struct config* config = (struct config*) data;
+	unsigned long long count = 0u;
+	while(bench_now() < config->end) {
+		dlg_file_write(config->file, record, sizeof(record) - 1, dlg_durability_sync);
+		++count;
+	}
+
+	pthread_mutex_lock(&config->mutex);
+	config->records += count;
+	pthread_mutex_unlock(&config->mutex);
+	return NULL;
+}
+
+static void run(struct bench* bench, const char* name, void* (*func)(void*),
+		unsigned thread_count) {
+	char full[64];
+	snprintf(full, sizeof(full), "%s/threads=%u", name, thread_count);
+	if(bench->filter && !strstr(full, bench->filter)) {
+		return;
+	}
+
+	struct config config = {0};
+	unlink(BENCH_FILE);
+	if(func == group_commit) {
+		config.file = dlg_file_create(BENCH_FILE, NULL, 0u, 0u);
+	} else {
+		config.fd = open(BENCH_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	}
+
+	if(config.fd < 0 || (func == group_commit && !config.file)) {
+		fprintf(stderr, "bench_durable: could not open %s\n", BENCH_FILE);
+		return;
+	}
+
+	pthread_mutex_init(&config.mutex, NULL);
+	pthread_t threads[64];
+	double start = bench_now();
+	config.end = start + BENCH_MIN_TIME;
+	for(unsigned i = 0u; i < thread_count; ++i) {
+		pthread_create(&threads[i], NULL, func, &config);
+	}
+
+	for(unsigned i = 0u; i < thread_count; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	double secs = bench_now() - start;
+	if(config.file) {
+		fprintf(stderr, "%-40s %10.2f records/sync\n", full,
+			(double) config.records / (double) dlg_file_syncs(config.file));
+		dlg_file_destroy(config.file);
+	} else {
+		close(config.fd);
+	}
+
+	pthread_mutex_destroy(&config.mutex);
+	bench_result(bench, full, config.records, secs);
+}
+
+int main(int argc, char** argv) {
+	struct bench bench;
+	if(!bench_begin(&bench, "durable", argc, argv)) {
+		return 1;
+	}
+
+	unsigned max_threads = (argc > 3) ? (unsigned) atoi(argv[3]) : 16u;
+	max_threads = (max_threads > 64u) ? 64u : (max_threads ? max_threads : 1u);
+	for(unsigned threads = 1u; threads <= max_threads; threads *= 2u) {
+		run(&bench, "sync_each", sync_each, threads);
+		run(&bench, "group_commit", group_commit, threads);
+	}
+
+	unlink(BENCH_FILE);
+	return bench_end(&bench);
+}
@@ -0,0 +1,14 @@
+// Log calls that are filtered at compile time.
+// Kept in a separate translation unit since DLG_LOG_LEVEL applies per file.
+
+#define DLG_LOG_LEVEL dlg_level_warn
+#include <dlg/dlg.h>
+
+void bench_filtered(void* data, unsigned iterations);
+
+void bench_filtered(void* data, unsigned iterations) {
+	(void) data;
+	for(unsigned i = 0; i < iterations; ++i) {
+		dlg_info("filtered %u %s", i, "call");
+	}
+}
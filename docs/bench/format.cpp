@@ -0,0 +1,60 @@
+// Benchmarks of the formatting functions: printf vs the dlg.hpp formatters.
+
+#include "bench.h"
+#include <dlg/dlg.hpp>
+#include <cstdlib>
+
+void bench_lite(void*, unsigned iterations); // format_lite.cpp
+
+namespace {
+
+void noop_handler(const struct dlg_origin*, const char*, void*) {}
+
+void bench_printf(void*, unsigned iterations) {
+	for(auto i = 0u; i < iterations; ++i) {
+		dlg__printf_format("value %u, string %s, float %.2f", i, "some string", 1.5);
+	}
+}
+
+void bench_tlformat(void*, unsigned iterations) {
+	for(auto i = 0u; i < iterations; ++i) {
+		dlg::detail::tlformat("value {}, string {}, float {}", i, "some string", 1.5);
+	}
+}
+
+#if defined(__cpp_lib_format)
+void bench_stdtlformat(void*, unsigned iterations) {
+	for(auto i = 0u; i < iterations; ++i) {
+		dlg::stdtlformat("value {}, string {}, float {:.2f}", i, "some string", 1.5);
+	}
+}
+#endif
+
+// full log call with the default DLG_FMT_FUNC of dlg.hpp
+void bench_info(void*, unsigned iterations) {
+	for(auto i = 0u; i < iterations; ++i) {
+		dlg_info("value {}, string {}", i, "some string");
+	}
+}
+
+} // anon namespace
+
+int main(int argc, char** argv) {
+	struct bench bench;
+	if(!bench_begin(&bench, "format", argc, argv)) {
+		return EXIT_FAILURE;
+	}
+
+	bench_run(&bench, "format_printf", bench_printf, nullptr);
+	bench_run(&bench, "format_tlformat", bench_tlformat, nullptr);
+	bench_run(&bench, "format_lite", bench_lite, nullptr);
+#if defined(__cpp_lib_format)
+	bench_run(&bench, "format_stdtlformat", bench_stdtlformat, nullptr);
+#endif
+
+	dlg_set_handler(noop_handler, nullptr);
+	bench_run(&bench, "noop_handler_hpp", bench_info, nullptr);
+	dlg_set_handler(dlg_default_output, nullptr);
+
+	return bench_end(&bench);
+}
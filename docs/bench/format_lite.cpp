@@ -0,0 +1,10 @@
+// dlg/lite.hpp formatting, in its own translation unit since it
+// can't be included together with dlg.hpp. See format.cpp.
+
+#include <dlg/lite.hpp>
+
+void bench_lite(void*, unsigned iterations) {
+	for(auto i = 0u; i < iterations; ++i) {
+		dlg::lite::format("value {}, string {}, float {}", i, "some string", 1.5);
+	}
+}
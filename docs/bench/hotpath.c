@@ -0,0 +1,185 @@
+// Benchmarks of the c logging hot path: filtering, the printf formatter,
+// tags and the different output handlers.
+
+#include "bench.h"
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#ifndef HOTPATH_SUITE
+	#define HOTPATH_SUITE "hotpath" // see hotpath_single.c
+#endif
+
+void bench_filtered(void* data, unsigned iterations);
+
+static void noop_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) origin;
+	(void) string;
+	(void) data;
+}
+
+// Handler-side runtime filtering, the usual way to implement a runtime level.
+static void level_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	if(origin->level < dlg_level_warn) {
+		return;
+	}
+	dlg_default_output(origin, string, data);
+}
+
+static void bench_info(void* data, unsigned iterations) {
+	(void) data;
+	for(unsigned i = 0; i < iterations; ++i) {
+		dlg_info("value %u, string %s", i, "some string");
+	}
+}
+
+static void bench_info_plain(void* data, unsigned iterations) {
+	(void) data;
+	for(unsigned i = 0; i < iterations; ++i) {
+		dlg_info("plain message without arguments");
+	}
+}
+
+static void bench_assert(void* data, unsigned iterations) {
+	unsigned* count = (unsigned*) data;
+	for(unsigned i = 0; i < iterations; ++i) {
+		dlg_assertm(i != *count, "assertion %u", i);
+	}
+}
+
+static void bench_printf_format(void* data, unsigned iterations) {
+	(void) data;
+	for(unsigned i = 0; i < iterations; ++i) {
+		dlg__printf_format("value %u, string %s", i, "some string");
+	}
+}
+
+struct tags_data {
+	unsigned depth;
+	const char* tags[16];
+};
+
+static void bench_tags(void* data, unsigned iterations) {
+	struct tags_data* tags = (struct tags_data*) data;
+	for(unsigned t = 0; t < tags->depth; ++t) {
+		dlg_add_tag(tags->tags[t], (t % 2) ? __func__ : NULL);
+	}
+
+	for(unsigned i = 0; i < iterations; ++i) {
+		dlg_infot(("local"), "value %u", i);
+	}
+
+	for(unsigned t = 0; t < tags->depth; ++t) {
+		dlg_remove_tag(tags->tags[t], (t % 2) ? __func__ : NULL);
+	}
+}
+
+struct outputf_data {
+	FILE* stream;
+	const char* format;
+};
+
+static void outputf_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	struct outputf_data* outputf = (struct outputf_data*) data;
+	dlg_generic_outputf_stream(outputf->stream, outputf->format, origin, string,
+		dlg_default_output_styles, false);
+}
+
+static void* drain_pipe(void* data) {
+	int fd = *(int*) data;
+	char buf[4096];
+	while(read(fd, buf, sizeof(buf)) > 0);
+	return NULL;
+}
+
+int main(int argc, char** argv) {
+	struct bench bench;
+	if(!bench_begin(&bench, HOTPATH_SUITE, argc, argv)) {
+		return EXIT_FAILURE;
+	}
+
+	FILE* devnull = fopen("/dev/null", "w");
+	unsigned never = ~0u;
+
+	// filtering
+	bench_run(&bench, "filtered_compile_time", bench_filtered, NULL);
+	dlg_set_handler(level_handler, devnull);
+	bench_run(&bench, "filtered_runtime_handler", bench_info, NULL);
+	dlg_set_filter("*>=warn");
+	bench_run(&bench, "filtered_runtime_filter", bench_info, NULL);
+	dlg_set_filter(NULL);
+	bench_run(&bench, "assert_not_failed", bench_assert, &never);
+
+	// formatting and dispatch only
+	bench_run(&bench, "format_printf", bench_printf_format, NULL);
+	dlg_set_handler(noop_handler, NULL);
+	bench_run(&bench, "noop_handler_printf", bench_info, NULL);
+	bench_run(&bench, "noop_handler_plain", bench_info_plain, NULL);
+
+	// tag scopes
+	struct tags_data tags = {0, {
+		"t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+		"t8", "t9", "t10", "t11", "t12", "t13", "t14", "t15"}};
+	const unsigned depths[] = {0, 1, 4, 16};
+	for(unsigned d = 0; d < sizeof(depths) / sizeof(depths[0]); ++d) {
+		char name[64];
+		snprintf(name, sizeof(name), "tags_depth_%u", depths[d]);
+		tags.depth = depths[d];
+		bench_run(&bench, name, bench_tags, &tags);
+	}
+
+	// default handler to different targets
+	dlg_set_handler(dlg_default_output, devnull);
+	bench_run(&bench, "default_output_devnull", bench_info, NULL);
+
+	FILE* file = tmpfile();
+	if(file) {
+		dlg_set_handler(dlg_default_output, file);
+		bench_run(&bench, "default_output_file", bench_info, NULL);
+		dlg_set_batch_handler(dlg_default_batch_output, file, NULL);
+		bench_run(&bench, "default_batch_output_file", bench_info, NULL);
+		dlg_flush();
+	}
+
+	int fds[2];
+	pthread_t drainer;
+	FILE* pipe_stream = NULL;
+	if(pipe(fds) == 0 && (pipe_stream = fdopen(fds[1], "w"))) {
+		pthread_create(&drainer, NULL, drain_pipe, &fds[0]);
+		dlg_set_handler(dlg_default_output, pipe_stream);
+		bench_run(&bench, "default_output_pipe", bench_info, NULL);
+		dlg_set_batch_handler(dlg_default_batch_output, pipe_stream, NULL);
+		bench_run(&bench, "default_batch_output_pipe", bench_info, NULL);
+		dlg_flush();
+	}
+
+	dlg_set_handler(dlg_json_output, devnull);
+	bench_run(&bench, "json_output_devnull", bench_info, NULL);
+
+	// dlg_generic_outputf with common patterns
+	const char* patterns[][2] = {
+		{"outputf_message", "%c\n"},
+		{"outputf_styled", "%s%c%r\n"},
+		{"outputf_file_line", "[%o] %c\n"},
+		{"outputf_full", "[%o %h:%m {%t} %f] %s%c\n"},
+	};
+	for(unsigned p = 0; p < sizeof(patterns) / sizeof(patterns[0]); ++p) {
+		struct outputf_data outputf = {devnull, patterns[p][1]};
+		dlg_set_handler(outputf_handler, &outputf);
+		bench_run(&bench, patterns[p][0], bench_info, NULL);
+	}
+
+	dlg_set_handler(dlg_default_output, NULL);
+	if(pipe_stream) {
+		fclose(pipe_stream);
+		pthread_join(drainer, NULL);
+		close(fds[0]);
+	}
+	if(file) {
+		fclose(file);
+	}
+	fclose(devnull);
+	return bench_end(&bench);
+}
@@ -0,0 +1,8 @@
+// The hotpath benchmark with the implementation of dlg in the same
+// translation unit, allowing the compiler to inline it. See dlg_impl.h.
+
+#define DLG_IMPLEMENTATION
+#include "dlg_impl.h"
+
+#define HOTPATH_SUITE "hotpath_single"
+#include "hotpath.c"
@@ -0,0 +1,231 @@
+// Multi-threaded scalability and tail latency of the output handlers.
+// Runs 1..N producer threads (doubling, N defaults to the number of
+// hardware threads) against every handler configuration and records
+// per-call latency histograms and the aggregate throughput.
+// Usage: bench_scaling [output.json] [config filter] [max threads]
+// The relation between the configurations shows where locking
+// (flockfile) and flushing stall scaling:
+// - noop: formatting and dispatch only, no shared state
+// - default_devnull: dlg_default_output (lock + fflush) to /dev/null
+// - default_file: dlg_default_output to a file
+// - locked_file_noflush: locked dlg_generic_output_stream, no fflush
+// - json_file: dlg_json_output to a file
+// - percpu_devnull, percpu_file (linux): dlg_default_output behind the
+//   per-cpu buffers of dlg/percpu.h, the collector thread writes. Dropped
+//   records (shards full) count as logged, they are reported separately.
+
+#include "bench.h"
+#include <dlg/dlg.hpp>
+#ifdef __linux__
+	#include <dlg/percpu.h>
+#endif
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Log-linear latency histogram with 16 sub-buckets per power of two,
+// i.e. values are recorded with a relative error of at most 1/16.
+struct Histogram {
+	static constexpr unsigned sub_bits = 4;
+	static constexpr unsigned sub_count = 1u << sub_bits;
+	static constexpr unsigned bucket_count = 48 * sub_count;
+
+	std::uint64_t counts[bucket_count] {};
+	std::uint64_t total {};
+	std::uint64_t max {};
+
+	static unsigned index(std::uint64_t ns) {
+		if(ns < sub_count) {
+			return unsigned(ns);
+		}
+
+		unsigned msb = 63 - unsigned(__builtin_clzll(ns));
+		unsigned shift = msb - sub_bits;
+		unsigned sub = unsigned(ns >> shift) & (sub_count - 1);
+		unsigned ret = (shift + 1) * sub_count + sub;
+		return ret < bucket_count ? ret : bucket_count - 1;
+	}
+
+	// upper bound of the values in the given bucket
+	static std::uint64_t value(unsigned index) {
+		if(index < sub_count) {
+			return index;
+		}
+
+		unsigned shift = index / sub_count - 1;
+		std::uint64_t sub = index % sub_count;
+		return ((sub_count | sub) << shift) + (std::uint64_t(1) << shift) - 1;
+	}
+
+	void add(std::uint64_t ns) {
+		++counts[index(ns)];
+		++total;
+		max = ns > max ? ns : max;
+	}
+
+	void merge(const Histogram& other) {
+		for(auto i = 0u; i < bucket_count; ++i) {
+			counts[i] += other.counts[i];
+		}
+		total += other.total;
+		max = other.max > max ? other.max : max;
+	}
+
+	std::uint64_t percentile(double p) const {
+		auto target = std::uint64_t(p * double(total));
+		std::uint64_t sum = 0;
+		for(auto i = 0u; i < bucket_count; ++i) {
+			sum += counts[i];
+			if(sum > target) {
+				auto v = value(i);
+				return v < max ? v : max;
+			}
+		}
+		return max;
+	}
+};
+
+void noop_handler(const struct dlg_origin*, const char*, void*) {}
+
+void locked_noflush_handler(const struct dlg_origin* origin, const char* str, void* data) {
+	dlg_generic_output_stream(static_cast<FILE*>(data),
+		dlg_output_file_line | dlg_output_newline | dlg_output_threadsafe,
+		origin, str, dlg_default_output_styles);
+}
+
+struct Config {
+	const char* name;
+	dlg_handler handler;
+	bool file; // otherwise /dev/null
+	bool percpu; // handler is called by the collector of a dlg_percpu
+};
+
+void producer(std::atomic<bool>& start, std::atomic<bool>& stop, Histogram& hist) {
+	while(!start.load(std::memory_order_acquire));
+
+	for(auto i = 0u; !stop.load(std::memory_order_relaxed); ++i) {
+		auto before = Clock::now();
+		dlg_info("value {}, string {}", i, "some string");
+		auto after = Clock::now();
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before);
+		hist.add(std::uint64_t(ns.count()));
+	}
+}
+
+} // anon namespace
+
+int main(int argc, char** argv) {
+	struct bench bench;
+	if(!bench_begin(&bench, "scaling", argc, argv)) {
+		return EXIT_FAILURE;
+	}
+
+	unsigned max_threads = std::thread::hardware_concurrency();
+	if(argc > 3) {
+		max_threads = unsigned(std::atoi(argv[3]));
+	}
+	max_threads = max_threads ? max_threads : 1;
+
+	std::vector<unsigned> thread_counts;
+	for(auto t = 1u; t < max_threads; t *= 2) {
+		thread_counts.push_back(t);
+	}
+	thread_counts.push_back(max_threads);
+
+	const Config configs[] = {
+		{"noop", noop_handler, false, false},
+		{"default_devnull", dlg_default_output, false, false},
+		{"default_file", dlg_default_output, true, false},
+		{"locked_file_noflush", locked_noflush_handler, true, false},
+		{"json_file", dlg_json_output, true, false},
+#ifdef __linux__
+		{"percpu_devnull", dlg_default_output, false, true},
+		{"percpu_file", dlg_default_output, true, true},
+#endif
+	};
+
+	FILE* devnull = std::fopen("/dev/null", "w");
+	for(auto& config : configs) {
+		if(bench.filter && !std::strstr(config.name, bench.filter)) {
+			continue;
+		}
+
+		for(auto threads : thread_counts) {
+			FILE* stream = config.file ? std::tmpfile() : devnull;
+			dlg_set_handler(config.handler, stream);
+#ifdef __linux__
+			struct dlg_percpu* percpu = nullptr;
+			if(config.percpu) {
+				percpu = dlg_percpu_create(config.handler, stream, 0, 0, 0);
+				dlg_set_handler(dlg_percpu_output, percpu);
+			}
+#endif
+
+			std::vector<Histogram> hists(threads);
+			std::vector<std::thread> producers;
+			std::atomic<bool> start {false};
+			std::atomic<bool> stop {false};
+			for(auto t = 0u; t < threads; ++t) {
+				producers.emplace_back(producer, std::ref(start), std::ref(stop),
+					std::ref(hists[t]));
+			}
+
+			auto begin = Clock::now();
+			start.store(true, std::memory_order_release);
+			std::this_thread::sleep_for(std::chrono::duration<double>(BENCH_MIN_TIME));
+			stop.store(true);
+			for(auto& producer : producers) {
+				producer.join();
+			}
+			auto secs = std::chrono::duration<double>(Clock::now() - begin).count();
+
+			dlg_set_handler(dlg_default_output, nullptr);
+#ifdef __linux__
+			if(percpu) {
+				std::fprintf(stderr, "%s: %llu records dropped\n", config.name,
+					dlg_percpu_dropped(percpu));
+				dlg_percpu_destroy(percpu);
+			}
+#endif
+			if(stream != devnull) {
+				std::fclose(stream);
+			}
+
+			Histogram total;
+			for(auto& hist : hists) {
+				total.merge(hist);
+			}
+
+			auto rate = double(total.total) / secs;
+			std::fprintf(bench.out, "%s\n  {\"name\": \"%s\", \"threads\": %u, "
+				"\"records\": %llu, \"records_per_sec\": %.0f, \"p50_ns\": %llu, "
+				"\"p99_ns\": %llu, \"p999_ns\": %llu, \"max_ns\": %llu}",
+				bench.first ? "" : ",", config.name, threads,
+				(unsigned long long) total.total, rate,
+				(unsigned long long) total.percentile(0.5),
+				(unsigned long long) total.percentile(0.99),
+				(unsigned long long) total.percentile(0.999),
+				(unsigned long long) total.max);
+			std::fflush(bench.out);
+			std::fprintf(stderr, "%-22s %3u threads %12.0f records/s  "
+				"p50 %6llu ns  p99 %8llu ns  p99.9 %8llu ns  max %9llu ns\n",
+				config.name, threads, rate,
+				(unsigned long long) total.percentile(0.5),
+				(unsigned long long) total.percentile(0.99),
+				(unsigned long long) total.percentile(0.999),
+				(unsigned long long) total.max);
+			bench.first = false;
+		}
+	}
+
+	std::fclose(devnull);
+	return bench_end(&bench);
+}
@@ -0,0 +1,150 @@
+#define DLG_DEFAULT_TAGS "batch"
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <string.h>
+#include <stdio.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+unsigned gbatches = 0;
+unsigned grecords = 0;
+unsigned glast_count = 0;
+char glast[256];
+char gtags[256]; // tags of the last record
+
+void batch_handler(const struct dlg_record* records, unsigned count, void* data) {
+	EXPECT(data == &gbatches);
+	++gbatches;
+	grecords += count;
+	glast_count = count;
+	for(unsigned i = 0u; i < count; ++i) {
+		EXPECT(records[i].origin->tags[0] && !strcmp(records[i].origin->tags[0], "batch"));
+		EXPECT(records[i].origin->line > 0);
+		if(records[i].string) {
+			EXPECT(strlen(records[i].string) == records[i].length);
+			snprintf(glast, sizeof(glast), "%s", records[i].string);
+		}
+
+		gtags[0] = '\0';
+		for(const char** tag = records[i].origin->tags; *tag; ++tag) {
+			strcat(gtags, *tag);
+			strcat(gtags, " ");
+		}
+	}
+}
+
+void single_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) origin;
+	++*(unsigned*) data;
+	snprintf(glast, sizeof(glast), "%s", string);
+}
+
+void log_output(void) {
+	for(unsigned i = 0u; i < 5; ++i) {
+		dlg_infot(("tag"), "output %u", i);
+	}
+	dlg_warn("last");
+}
+
+// reads the whole file into buf
+size_t read_file(FILE* file, char* buf, size_t size) {
+	rewind(file);
+	size_t len = fread(buf, 1, size - 1, file);
+	buf[len] = '\0';
+	return len;
+}
+
+int main() {
+	struct dlg_batch_limits limits = {4, 1024, 0, dlg_level_error};
+	dlg_set_batch_handler(batch_handler, &gbatches, &limits);
+
+	void* data;
+	EXPECT(dlg_get_batch_handler(&data) == batch_handler);
+	EXPECT(data == &gbatches);
+
+	// count limit
+	for(unsigned i = 0u; i < 10; ++i) {
+		dlg_infot(("tag"), "record %u", i);
+	}
+	EXPECT(gbatches == 2);
+	EXPECT(grecords == 8);
+	EXPECT(!strcmp(glast, "record 7"));
+
+	dlg_flush();
+	EXPECT(gbatches == 3);
+	EXPECT(glast_count == 2);
+	EXPECT(!strcmp(glast, "record 9"));
+
+	dlg_flush(); // nothing queued
+	EXPECT(gbatches == 3);
+
+	// flush level
+	dlg_info("queued");
+	dlg_error("error");
+	EXPECT(gbatches == 4);
+	EXPECT(glast_count == 2);
+	EXPECT(!strcmp(glast, "error"));
+
+	// assertions without message
+	dlg_assertl(dlg_level_warn, 1 == 2);
+	dlg_flush();
+	EXPECT(gbatches == 5);
+	EXPECT(glast_count == 1);
+
+	// byte limit
+	char long_string[600];
+	memset(long_string, 'a', sizeof(long_string) - 1);
+	long_string[sizeof(long_string) - 1] = '\0';
+	dlg_info("%s", long_string);
+	EXPECT(gbatches == 5);
+	dlg_info("%s", long_string);
+	EXPECT(gbatches == 6);
+	EXPECT(glast_count == 2);
+
+	// tags are copied, they don't have to outlive the call
+	char tag[16] = "runtime";
+	dlg_add_tag(tag, NULL);
+	dlg_info("tagged");
+	dlg_remove_tag(tag, NULL);
+	strcpy(tag, "changed");
+	dlg_flush();
+	EXPECT(!strcmp(glast, "tagged"));
+	EXPECT(!strcmp(gtags, "batch runtime "));
+
+	// queued records are passed on when switching to a single handler
+	dlg_info("queued");
+	dlg_set_handler(single_handler, &grecords);
+	EXPECT(gbatches == 8);
+	EXPECT(dlg_get_batch_handler(&data) == NULL);
+
+	// dlg_default_batch_output writes the same as dlg_default_output
+	FILE* single = tmpfile();
+	FILE* batched = tmpfile();
+	EXPECT(single && batched);
+	if(single && batched) {
+		dlg_set_handler(dlg_default_output, single);
+		log_output();
+
+		dlg_set_batch_handler(dlg_default_batch_output, batched, NULL);
+		log_output();
+		EXPECT(ftell(batched) == 0);
+		dlg_flush();
+
+		char a[1024], b[1024];
+		size_t alen = read_file(single, a, sizeof(a));
+		size_t blen = read_file(batched, b, sizeof(b));
+		EXPECT(alen > 0 && alen == blen);
+		EXPECT(!memcmp(a, b, alen));
+
+		dlg_set_handler(dlg_default_output, NULL);
+		fclose(single);
+		fclose(batched);
+	}
+
+	return gerror;
+}
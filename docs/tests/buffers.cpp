@@ -0,0 +1,99 @@
+// Thread buffer cap, truncation and shrinking, see dlg_set_buffer_limits.
+#include <dlg/dlg.hpp>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+std::size_t glast_len = 0;
+bool glast_truncated = false;
+
+void handler(const struct dlg_origin*, const char* str, void*) {
+	glast_len = std::strlen(str);
+	auto mlen = std::strlen(DLG_TRUNCATED_MARKER);
+	glast_truncated = glast_len >= mlen &&
+		!std::strcmp(str + glast_len - mlen, DLG_TRUNCATED_MARKER);
+}
+
+std::size_t buffer_size() {
+	std::size_t* size;
+	dlg_thread_buffer(&size);
+	return *size;
+}
+
+int main() {
+	dlg_set_handler(handler, nullptr);
+	std::string big(10000, 'a');
+
+	struct dlg_buffer_limits limits;
+	dlg_get_buffer_limits(&limits);
+	EXPECT(limits.max_size == 0);
+	EXPECT(limits.shrink_after > 0);
+
+	limits.max_size = 1024;
+	limits.shrink_size = 256;
+	limits.shrink_after = 4;
+	dlg_set_buffer_limits(&limits);
+
+	struct dlg_stats before, after;
+	dlg_get_stats(&before);
+
+	// printf formatter
+	auto str = dlg__printf_format("%s", big.c_str());
+	EXPECT(std::strlen(str) == 1023);
+	EXPECT(std::strstr(str, DLG_TRUNCATED_MARKER) == str + 1023 - std::strlen(DLG_TRUNCATED_MARKER));
+	EXPECT(buffer_size() == 1024);
+
+	// ostream formatter
+	dlg_info("{}", big);
+	EXPECT(glast_truncated);
+	EXPECT(glast_len == 1023);
+
+	dlg_info("{}{}", "short", 42);
+	EXPECT(!glast_truncated);
+	EXPECT(glast_len == 7);
+
+	dlg_get_stats(&after);
+	EXPECT(after.truncated - before.truncated == 2);
+	EXPECT(after.buffer_bytes >= 1024);
+	EXPECT(after.buffer_bytes_max >= 1024);
+
+	// shrinking: the short record above was the first below the high-water mark
+	dlg_info("{}", "short");
+	dlg_info("{}", "short");
+	EXPECT(buffer_size() == 1024);
+	dlg_info("{}", "short");
+	EXPECT(buffer_size() == 256);
+
+	// a large record resets the count
+	dlg_info("{}", std::string(300, 'b'));
+	EXPECT(!glast_truncated);
+	EXPECT(glast_len == 300);
+	dlg_info("short");
+	dlg_info("short");
+	dlg_info("short");
+	EXPECT(buffer_size() > 256);
+	dlg_info("short");
+	EXPECT(buffer_size() == 256);
+
+	// no cap
+	limits.max_size = 0;
+	limits.shrink_after = 0;
+	dlg_set_buffer_limits(&limits);
+	dlg_info("{}", big);
+	EXPECT(!glast_truncated);
+	EXPECT(glast_len == big.size());
+	for(auto i = 0u; i < 10u; ++i) {
+		dlg_info("short");
+	}
+	EXPECT(buffer_size() > big.size());
+
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
@@ -0,0 +1,178 @@
+// Explicit log contexts: tags, fields, moving them between threads and coroutines.
+#include <dlg/dlg.hpp>
+#include <coroutine>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+struct Record {
+	std::string tags; // space separated
+	const struct dlg_context* context;
+};
+
+std::mutex gmutex;
+std::vector<Record> grecords;
+
+void handler(const struct dlg_origin_ex* ex, const char*, void*) {
+	Record record {{}, ex->context};
+	for(auto tag = ex->origin->tags; *tag; ++tag) {
+		record.tags += (tag == ex->origin->tags) ? "" : " ";
+		record.tags += *tag;
+	}
+
+	std::lock_guard lock(gmutex);
+	grecords.push_back(record);
+}
+
+Record last() {
+	std::lock_guard lock(gmutex);
+	return grecords.empty() ? Record {"<none>", nullptr} : grecords.back();
+}
+
+// Resumes the coroutine in a new thread.
+struct ResumeInThread {
+	std::thread* thread;
+	const struct dlg_context** after; // current context of the thread when done
+
+	bool await_ready() { return false; }
+	void await_suspend(std::coroutine_handle<> handle) {
+		// the awaiter lives in the coroutine frame, which the new thread
+		// may already have destroyed when the assignment happens
+		auto after = this->after;
+		auto thread = this->thread;
+		*thread = std::thread([handle, after]{
+			handle.resume();
+			*after = dlg_context_current();
+		});
+	}
+	void await_resume() {}
+};
+
+struct Task {
+	struct promise_type {
+		Task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+Task request(dlg::Context context, std::thread* thread,
+		const struct dlg_context** after) {
+	dlg::ContextGuard guard(context);
+	dlg_info("before");
+	EXPECT(last().tags == "request");
+
+	// ready awaiters don't suspend
+	co_await guard.await(std::suspend_never{});
+	EXPECT(dlg_context_current() == &context);
+
+	co_await guard.await(ResumeInThread{thread, after});
+	EXPECT(dlg_context_current() == &context);
+	dlg_info("after");
+	EXPECT(last().tags == "request");
+	EXPECT(last().context == &context);
+}
+
+int main() {
+	dlg_set_handler_ex(handler, nullptr);
+
+	// install, restore
+	const char* tags[] = {"parent", nullptr};
+	const char* fields[] = {"a", "1", nullptr};
+	struct dlg_context parent = {nullptr, tags, fields};
+	EXPECT(dlg_context_current() == nullptr);
+	EXPECT(dlg_context_install(&parent) == nullptr);
+	EXPECT(dlg_context_current() == &parent);
+
+	dlg_add_tag("added", nullptr);
+	dlg_infot(("call"), "tagged");
+	EXPECT(last().tags == "added parent call");
+	EXPECT(last().context == &parent);
+	dlg_remove_tag("added", nullptr);
+
+	// parent tags first, the context is not copied
+	dlg::Context child({"child"}, {{"b", "2"}}, &parent);
+	{
+		dlg::ContextGuard guard(child);
+		EXPECT(dlg_context_current() == &child);
+		dlg_info("child");
+		EXPECT(last().tags == "parent child");
+		EXPECT(last().context == &child);
+
+		guard.suspend();
+		EXPECT(dlg_context_current() == &parent);
+		guard.resume();
+		EXPECT(dlg_context_current() == &child);
+	}
+	EXPECT(dlg_context_current() == &parent);
+	EXPECT(dlg_context_install(nullptr) == &parent);
+	dlg_info("none");
+	EXPECT(last().tags == "");
+	EXPECT(last().context == nullptr);
+
+	// other threads have their own current context
+	std::thread([&]{
+		EXPECT(dlg_context_current() == nullptr);
+		dlg_context_install(&child);
+		dlg_info("thread");
+		EXPECT(last().tags == "parent child");
+	}).join();
+	EXPECT(dlg_context_current() == nullptr);
+
+	// moved contexts keep valid (short) strings
+	dlg::Context moved({"x"}, {{"k", "v"}});
+	moved.add_tag("y");
+	dlg::Context target = std::move(moved);
+	EXPECT(!std::strcmp(target.tags[0], "x") && !std::strcmp(target.tags[1], "y"));
+	EXPECT(!target.tags[2]);
+	EXPECT(!std::strcmp(target.fields[0], "k") && !std::strcmp(target.fields[1], "v"));
+	EXPECT(!target.fields[2]);
+
+	// json output contains the fields, the ones of the parent first
+	std::FILE* file = std::tmpfile();
+	EXPECT(file);
+	if(file) {
+		dlg_set_handler(dlg_json_output, file);
+		auto prev = dlg_context_install(&child);
+		dlg_info("json");
+		dlg_context_install(prev);
+		dlg_info("plain");
+
+		char buf[1024] {};
+		std::rewind(file);
+		auto size = std::fread(buf, 1, sizeof(buf) - 1, file);
+		std::fclose(file);
+		EXPECT(size > 0);
+		EXPECT(std::strstr(buf, "\"tags\":[\"parent\",\"child\"],\"fields\":{\"a\":\"1\",\"b\":\"2\"},"));
+		auto second = std::strchr(buf, '\n');
+		EXPECT(second && !std::strstr(second, "\"fields\""));
+		dlg_set_handler_ex(handler, nullptr);
+	}
+
+	// coroutine resumed in another thread: the context follows it and
+	// is removed from the suspending thread
+	std::thread thread;
+	const struct dlg_context* after = &parent;
+	dlg_context_install(&parent);
+	request(dlg::Context({"request"}), &thread, &after);
+	EXPECT(dlg_context_current() == &parent);
+	thread.join();
+	EXPECT(after == nullptr);
+	EXPECT(last().tags == "request");
+
+	dlg_context_install(nullptr);
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
@@ -263,6 +263,43 @@ int main(void) {
 
 	dlg_styled_fprintf(stdout, mstyle, u8"ầŝƒđĵšҝďƒĵqשׂęрốґμĝĺ (<%s> in dingus-evlish)\n", "it's some kind of evlish");
 
+	// stream output is rendered into a buffer first, must be the same
+	// (without time, it might change in between)
+	const char* stags[] = {"a", "b", NULL};
+	struct dlg_origin sorigin = {"file.c", 42, "func", dlg_level_warn, stags, "1 == 2"};
+	for(unsigned f = 0u; f < 64u; ++f) {
+		unsigned features = (f & ~(unsigned) dlg_output_time) | dlg_output_threadsafe;
+		FILE* file = tmpfile();
+		dlg_generic_output_stream(file, features, &sorigin, u8"mëssage %d", dlg_default_output_styles);
+		dlg_generic_outputf_stream(file, "%s[%o %f] %c %t%r\n", &sorigin, "x",
+			dlg_default_output_styles, f % 2);
+
+		char expected[512];
+		size_t size = sizeof(expected);
+		dlg_generic_output_buf(expected, &size, features, &sorigin, u8"mëssage %d",
+			dlg_default_output_styles);
+		size_t len = strlen(expected);
+		size = sizeof(expected) - len;
+		dlg_generic_outputf_buf(expected + len, &size, "%s[%o %f] %c %t%r\n",
+			&sorigin, "x", dlg_default_output_styles);
+
+		char written[512] = {0};
+		rewind(file);
+		size_t count = fread(written, 1, sizeof(written) - 1, file);
+		fclose(file);
+		EXPECT(count == strlen(expected) && !strcmp(written, expected));
+	}
+
+	// buffers that are too small cut the output off
+	struct dlg_origin plain = {"file.c", 42, "func", dlg_level_warn, stags, NULL};
+	char small[8];
+	size_t size = sizeof(small);
+	dlg_generic_outputf_buf(small, &size, "%c", &plain, "cut off message", NULL);
+	EXPECT(size == sizeof(small) - 1 && !strcmp(small, "cut off"));
+	size = 0u;
+	dlg_generic_outputf_buf(NULL, &size, "%c", &plain, "cut off message", NULL);
+	EXPECT(size == strlen("cut off message"));
+
 	// return count of total errors
 	return gerror;
 }
@@ -15,6 +15,20 @@ unsigned int gerror = 0;
 	++gerror; \
 }
 
+// constexpr functions can't have the static variable of the runtime filter
+#pragma push_macro("DLG_RUNTIME_FILTER")
+#undef DLG_RUNTIME_FILTER
+#define DLG_RUNTIME_FILTER 0
+constexpr int twice(int x) {
+	if(x < 0) {
+		dlg_warn("negative: {}", x);
+	}
+	return 2 * x;
+}
+#pragma pop_macro("DLG_RUNTIME_FILTER")
+
+static_assert(twice(2) == 4);
+
 int main() {
 	// utility functions
 	EXPECT(dlg::rformat("$", "\\$\\") == "$");
@@ -25,6 +39,7 @@ int main() {
 	EXPECT(dlg::format("{{}}", 2) == "{2}");
 	EXPECT(dlg::format("\\{}\\") == "{}");
 	EXPECT(dlg::format("\\{{}}\\", 2) == "\\{2}\\");
+	EXPECT(twice(-1) == -2);
 
 	std::string a;
 	for(auto i = 0; i < 1000; ++i) {
@@ -0,0 +1,156 @@
+// File sink with durability policy and group commit.
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlg/dlg.h>
+#include <dlg/file.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+#define THREADS 4
+#define RECORDS 100
+
+struct dlg_file* gfile;
+
+// Reads the whole file into buf, returns the size.
+size_t read_file(const char* path, char* buf, size_t size) {
+	FILE* f = fopen(path, "r");
+	EXPECT(f);
+	if(!f) {
+		buf[0] = '\0';
+		return 0u;
+	}
+
+	size_t ret = fread(buf, 1, size - 1, f);
+	buf[ret] = '\0';
+	fclose(f);
+	return ret;
+}
+
+void* produce(void* data) {
+	int thread = (int) (size_t) data;
+	char buf[64];
+	for(int i = 0; i < RECORDS; ++i) {
+		int len = snprintf(buf, sizeof(buf), "thread %d record %d\n", thread, i);
+		EXPECT(dlg_file_write(gfile, buf, (size_t) len, dlg_durability_sync));
+	}
+	return NULL;
+}
+
+int main(void) {
+	const char* path = "dlg_file_test.log";
+	char buf[4096];
+
+	// default policy: info is lazy, warn written, error synced
+	unlink(path);
+	struct dlg_file* file = dlg_file_create(path, NULL, 0u, 0u);
+	EXPECT(file);
+	if(!file) {
+		return gerror;
+	}
+
+	dlg_set_handler(dlg_file_output, file);
+	dlg_info("lazy");
+	EXPECT(read_file(path, buf, sizeof(buf)) == 0u);
+	dlg_warn("written");
+	read_file(path, buf, sizeof(buf));
+	EXPECT(strstr(buf, "lazy") && strstr(buf, "written"));
+	EXPECT(strstr(buf, "lazy") < strstr(buf, "written"));
+	EXPECT(dlg_file_syncs(file) == 0u);
+
+	dlg_error("synced");
+	EXPECT(dlg_file_syncs(file) == 1u);
+	EXPECT(strstr(read_file(path, buf, sizeof(buf)) ? buf : "", "synced"));
+
+	// nothing new to sync
+	EXPECT(dlg_file_sync(file));
+	EXPECT(dlg_file_syncs(file) == 1u);
+
+	// records larger than the render buffer
+	char big[3000];
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	dlg_warn("%s", big);
+	read_file(path, buf, sizeof(buf));
+	const char* rendered = strstr(buf, big);
+	EXPECT(rendered && rendered[sizeof(big) - 1] == '\n');
+
+	// destroy writes the buffered records
+	dlg_debug("on destroy");
+	dlg_set_handler(dlg_default_output, NULL);
+	dlg_file_destroy(file);
+	EXPECT(strstr(read_file(path, buf, sizeof(buf)) ? buf : "", "on destroy"));
+
+	// custom policy, lazy records larger than the buffer are written
+	struct dlg_file_policy policy = {{
+		dlg_durability_lazy, dlg_durability_lazy, dlg_durability_lazy,
+		dlg_durability_lazy, dlg_durability_write, dlg_durability_sync}};
+	unlink(path);
+	file = dlg_file_create(path, &policy, 16u, dlg_file_json);
+	EXPECT(file);
+	if(!file) {
+		return gerror;
+	}
+
+	dlg_set_handler(dlg_file_output, file);
+	dlg_warn("json record");
+	read_file(path, buf, sizeof(buf));
+	EXPECT(strstr(buf, "\"msg\":\"json record\""));
+	EXPECT(strstr(buf, "\"level\":\"warn\""));
+	dlg_set_handler(dlg_default_output, NULL);
+
+	// group commit: every record is durable when the write returns,
+	// concurrent writers may share syncs
+	gfile = file;
+	EXPECT(dlg_file_write(file, "x\n", 2u, dlg_durability_lazy));
+	pthread_t threads[THREADS];
+	for(int i = 0; i < THREADS; ++i) {
+		pthread_create(&threads[i], NULL, produce, (void*) (size_t) i);
+	}
+
+	for(int i = 0; i < THREADS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	unsigned long long syncs = dlg_file_syncs(file);
+	printf("%d synced records, %llu syncs\n", THREADS * RECORDS, syncs);
+	EXPECT(syncs >= 1u && syncs <= THREADS * RECORDS);
+	EXPECT(dlg_file_errors(file) == 0u);
+	dlg_file_destroy(file);
+
+	FILE* f = fopen(path, "r");
+	EXPECT(f);
+	if(f) {
+		int last[THREADS];
+		for(int i = 0; i < THREADS; ++i) {
+			last[i] = -1;
+		}
+
+		char line[128];
+		unsigned lines = 0u;
+		while(fgets(line, sizeof(line), f)) {
+			int thread, num;
+			if(sscanf(line, "thread %d record %d", &thread, &num) == 2 &&
+					thread >= 0 && thread < THREADS && num == last[thread] + 1) {
+				last[thread] = num;
+				++lines;
+			}
+		}
+
+		fclose(f);
+		EXPECT(lines == THREADS * RECORDS);
+	}
+
+	unlink(path);
+	EXPECT(!dlg_file_create("/nonexistent/dir/file.log", NULL, 0u, 0u));
+	return gerror;
+}
@@ -0,0 +1,69 @@
+// Stripping of DLG_BASE_PATH from __FILE__ in c, once per callsite.
+#undef DLG_FILE_PREFIX_MAPPED
+#undef DLG_BASE_PATH
+#define DLG_BASE_PATH "docs/"
+#define DLG_RUNTIME_FILTER 0
+#include <dlg/dlg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+const char* gfile = NULL;
+
+void handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) string;
+	(void) data;
+	gfile = origin->file;
+}
+
+void log_twice(const char** first, const char** second) {
+	for(int i = 0; i < 2; ++i) {
+		dlg_info("file");
+		*(i ? second : first) = gfile;
+	}
+}
+
+// needs no static variable, must compile with -Werror
+#pragma push_macro("DLG_FILE_CACHE")
+#undef DLG_FILE_CACHE
+#define DLG_FILE_CACHE 0
+inline void log_inline(void) {
+	dlg_info("file");
+}
+#pragma pop_macro("DLG_FILE_CACHE")
+
+static void log_uncached(void) {
+	#pragma push_macro("DLG_FILE_CACHE")
+	#undef DLG_FILE_CACHE
+	#define DLG_FILE_CACHE 0
+	dlg_info("file");
+	#pragma pop_macro("DLG_FILE_CACHE")
+}
+
+int main(void) {
+	dlg_set_handler(handler, NULL);
+
+	const char* expected = dlg__strip_root_path(__FILE__, DLG_BASE_PATH);
+	printf("__FILE__: %s, stripped: %s\n", __FILE__, expected);
+
+	// the stripped path is cached per callsite
+	const char* first = NULL;
+	const char* second = NULL;
+	log_twice(&first, &second);
+	EXPECT(first && !strcmp(first, expected));
+	EXPECT(first == second);
+
+	log_uncached();
+	EXPECT(gfile && !strcmp(gfile, expected));
+
+	dlg_assertm(false, "file");
+	EXPECT(gfile && !strcmp(gfile, expected));
+
+	dlg_set_handler(dlg_default_output, NULL);
+	return gerror;
+}
@@ -0,0 +1,41 @@
+// Compile-time stripping of DLG_BASE_PATH from __FILE__ in c++.
+#undef DLG_FILE_PREFIX_MAPPED
+#undef DLG_BASE_PATH
+#define DLG_BASE_PATH "docs/"
+#include <dlg/dlg.hpp>
+#include <cstdio>
+#include <cstring>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+const char* gfile = nullptr;
+
+// same results as dlg__strip_root_path
+static_assert(dlg__strip_offset("/base/src/a.c", "/base/") == 6, "");
+static_assert(dlg__strip_offset("/base/src/a.c", "") == 0, "");
+static_assert(dlg__strip_offset("/other/src/a.c", "/base/") == 0, "");
+static_assert(dlg__strip_offset("/base/", "/base/") == 0, "");
+static_assert(dlg__strip_offset("../../src/a.c", "/base/") == 6, "");
+static_assert(dlg__strip_offset("./a.c", "") == 2, "");
+static_assert(dlg__strip_offset("..", "") == 0, "");
+
+int main() {
+	dlg_set_handler([](const struct dlg_origin* origin, const char*, void*) {
+		gfile = origin->file;
+	}, nullptr);
+
+	const char* expected = dlg__strip_root_path(__FILE__, DLG_BASE_PATH);
+	std::printf("__FILE__: %s, stripped: %s\n", __FILE__, expected);
+
+	dlg_info("file");
+	EXPECT(gfile && !std::strcmp(gfile, expected));
+	dlg_assertm(false, "file");
+	EXPECT(gfile && !std::strcmp(gfile, expected));
+
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
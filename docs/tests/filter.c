@@ -0,0 +1,198 @@
+#ifdef __linux__
+	#define _POSIX_C_SOURCE 200809L
+	#include <unistd.h>
+	#include <stdlib.h>
+#endif
+
+#define DLG_DEFAULT_TAGS "filter"
+#include <dlg/dlg.h>
+#include <stdio.h>
+#include <time.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+unsigned int gfired = 0;
+int gevaluated = 0;
+
+void counting_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) origin;
+	(void) string;
+	(void) data;
+	++gfired;
+}
+
+int arg(void) {
+	return ++gevaluated;
+}
+
+// logs from multiple callsites, returns the number of records
+unsigned log_all(void) {
+	gfired = 0u;
+	gevaluated = 0;
+	dlg_trace("trace %d", arg());
+	dlg_debug("debug %d", arg());
+	dlg_info("info %d", arg());
+	dlg_warn("warn %d", arg());
+	dlg_debugt(("net.tcp"), "net debug %d", arg());
+	dlg_tracet(("net.udp", "db"), "net/db trace %d", arg());
+	EXPECT((int) gfired == gevaluated);
+	return gfired;
+}
+
+void render(void) {
+	dlg_error("render error %d", arg());
+}
+
+// callsites without the runtime filter (and its static variable), this
+// must compile with -Werror
+#pragma push_macro("DLG_RUNTIME_FILTER")
+#undef DLG_RUNTIME_FILTER
+#define DLG_RUNTIME_FILTER 0
+inline void log_inline(void) {
+	dlg_info("inline");
+}
+
+void log_unfiltered(void) {
+	dlg_info("unfiltered %d", arg());
+}
+#pragma pop_macro("DLG_RUNTIME_FILTER")
+
+int main(void) {
+#ifdef __linux__
+	// initial filter from the environment, applied on first use
+	setenv("DLG_FILTER", "*>=info", 1);
+#endif
+
+	dlg_set_handler(counting_handler, NULL);
+	unsigned generation = dlg_filter_generation();
+#ifdef __linux__
+	EXPECT(log_all() == 2u);
+	EXPECT(dlg_filter_generation() == generation + 1);
+	generation = dlg_filter_generation();
+#endif
+
+	// no filter
+	EXPECT(dlg_set_filter(NULL));
+	EXPECT(dlg_filter_generation() == generation + 1);
+	EXPECT(log_all() == 6u);
+
+	// first matching rule wins, cached decisions are invalidated
+	EXPECT(dlg_set_filter("net.*>=debug, db >= trace, *>=warn"));
+	EXPECT(log_all() == 2u);
+	EXPECT(log_all() == 2u);
+
+	EXPECT(dlg_set_filter("db>=off,net.*>=debug"));
+	EXPECT(log_all() == 5u);
+
+	EXPECT(dlg_set_filter("tag:filter>=debug"));
+	EXPECT(log_all() == 4u);
+
+	// file and function globs
+	EXPECT(dlg_set_filter("file:*/tests/filter.?>=warn"));
+	EXPECT(log_all() == 1u);
+	EXPECT(dlg_set_filter("file:*/other/*>=off, func:log_*>=info\n"));
+	EXPECT(log_all() == 2u);
+
+	gfired = 0u;
+	EXPECT(dlg_set_filter("func:rend*>=off # comment, *>=fatal\n*>=trace"));
+	render();
+	EXPECT(gfired == 0u);
+	EXPECT(log_all() == 6u);
+
+	// level without selector
+	EXPECT(dlg_set_filter("warn"));
+	EXPECT(log_all() == 1u);
+
+	gfired = 0u;
+	log_unfiltered();
+	EXPECT(gfired == 1u);
+
+	// invalid expressions keep the current filter
+	generation = dlg_filter_generation();
+	EXPECT(!dlg_set_filter("*>=loud"));
+	EXPECT(!dlg_set_filter(">=warn"));
+	EXPECT(dlg_filter_generation() == generation);
+	EXPECT(log_all() == 1u);
+
+	// files
+	const char* path = "dlg_filter_test";
+	FILE* file = fopen(path, "w");
+	EXPECT(file);
+	if(file) {
+		fputs("# test filter\nnet.*>=trace\n*>=off\n", file);
+		fclose(file);
+		EXPECT(dlg_load_filter(path));
+		EXPECT(log_all() == 2u);
+	}
+	EXPECT(!dlg_load_filter("/nonexistent/dlg/filter"));
+
+#ifdef __linux__
+	// reload on change
+	generation = dlg_filter_generation();
+	EXPECT(dlg_watch_filter(path));
+	EXPECT(dlg_filter_generation() == generation + 1);
+	EXPECT(log_all() == 2u);
+
+	generation = dlg_filter_generation();
+	const char* tmp_path = "dlg_filter_test.tmp";
+	file = fopen(tmp_path, "w");
+	EXPECT(file);
+	if(file) {
+		fputs("*>=debug", file);
+		fclose(file);
+		rename(tmp_path, path);
+	}
+
+	for(unsigned i = 0u; i < 200 && dlg_filter_generation() == generation; ++i) {
+		struct timespec ts = {0, 10 * 1000 * 1000};
+		nanosleep(&ts, NULL);
+	}
+	EXPECT(dlg_filter_generation() != generation);
+	EXPECT(log_all() == 4u);
+	EXPECT(dlg_watch_filter(NULL));
+
+	// file in another directory
+	char dir[] = "/tmp/dlg_filter_test_directory_XXXXXX";
+	EXPECT(mkdtemp(dir));
+	char dir_path[128];
+	char dir_tmp_path[160];
+	snprintf(dir_path, sizeof(dir_path), "%s/some_longer_filter_name", dir);
+	snprintf(dir_tmp_path, sizeof(dir_tmp_path), "%s.tmp", dir_path);
+	file = fopen(dir_path, "w");
+	EXPECT(file);
+	if(file) {
+		fputs("*>=off", file);
+		fclose(file);
+		EXPECT(dlg_watch_filter(dir_path));
+		EXPECT(log_all() == 0u);
+
+		generation = dlg_filter_generation();
+		file = fopen(dir_tmp_path, "w");
+		EXPECT(file);
+		if(file) {
+			fputs("*>=warn", file);
+			fclose(file);
+			rename(dir_tmp_path, dir_path);
+		}
+
+		for(unsigned i = 0u; i < 200 && dlg_filter_generation() == generation; ++i) {
+			struct timespec ts = {0, 10 * 1000 * 1000};
+			nanosleep(&ts, NULL);
+		}
+		EXPECT(dlg_filter_generation() != generation);
+		EXPECT(log_all() == 1u);
+		EXPECT(dlg_watch_filter(NULL));
+		remove(dir_path);
+	}
+	rmdir(dir);
+#endif
+
+	remove(path);
+	dlg_set_filter(NULL);
+	dlg_set_handler(dlg_default_output, NULL);
+	return gerror;
+}
@@ -0,0 +1,124 @@
+// Extended handler: length, thread id, sequence numbers and format strings.
+#include <dlg/dlg.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+struct Record {
+	unsigned long long thread_id;
+	unsigned long long sequence;
+	const char* format;
+	std::size_t length;
+	unsigned value;
+};
+
+std::mutex gmutex;
+std::vector<Record> grecords;
+
+void handler(const struct dlg_origin_ex* ex, const char* string, void* data) {
+	EXPECT(data == &grecords);
+	EXPECT(ex->size == sizeof(struct dlg_origin_ex));
+	EXPECT(ex->origin && ex->origin->level == dlg_level_info);
+	EXPECT(string && std::strlen(string) == ex->length);
+
+	unsigned value = 0u;
+	auto space = std::strrchr(string, ' ');
+	if(space) {
+		std::sscanf(space + 1, "%u", &value);
+	}
+
+	std::lock_guard lock(gmutex);
+	grecords.push_back({ex->thread_id, ex->sequence, ex->format, ex->length, value});
+}
+
+unsigned gplain = 0u;
+void plain_handler(const struct dlg_origin*, const char*, void*) {
+	++gplain;
+}
+
+constexpr const char* format = "value {}";
+constexpr auto per_thread = 100u;
+
+void produce() {
+	for(auto i = 0u; i < per_thread; ++i) {
+		dlg_info(format, i);
+	}
+}
+
+int main() {
+	void* data;
+	EXPECT(dlg_get_handler_ex(&data) == nullptr);
+
+	dlg_set_handler_ex(handler, &grecords);
+	EXPECT(dlg_get_handler_ex(&data) == handler);
+	EXPECT(data == &grecords);
+
+	// single thread
+	produce();
+	dlg_info("no arguments");
+	EXPECT(grecords.size() == per_thread + 1);
+	EXPECT(grecords.back().format && !std::strcmp(grecords.back().format, "no arguments"));
+	EXPECT(grecords.back().length == std::strlen("no arguments"));
+	grecords.pop_back();
+
+	// formatting outside of a log call leaves nothing behind
+	dlg__printf_format("%s", "a longer string formatted before the call");
+	dlg::detail::set_format("stale");
+	dlg_info("short");
+	EXPECT(grecords.back().length == std::strlen("short"));
+	EXPECT(grecords.back().format && !std::strcmp(grecords.back().format, "short"));
+	grecords.pop_back();
+
+	// multiple threads
+	std::vector<std::thread> threads;
+	for(auto t = 0u; t < 4; ++t) {
+		threads.emplace_back(produce);
+	}
+	for(auto& thread : threads) {
+		thread.join();
+	}
+
+	EXPECT(grecords.size() == 5 * per_thread);
+
+	// sequence numbers are unique and increase per thread, the values
+	// logged by each thread can be restored in order
+	std::vector<unsigned long long> ids;
+	for(auto i = 0u; i < grecords.size(); ++i) {
+		auto& rec = grecords[i];
+		EXPECT(rec.format == format);
+		EXPECT(rec.length == std::strlen("value ") + (rec.value < 10 ? 1 : 2));
+		for(auto j = 0u; j < i; ++j) {
+			EXPECT(grecords[j].sequence != rec.sequence);
+			if(grecords[j].thread_id == rec.thread_id) {
+				EXPECT(grecords[j].sequence < rec.sequence);
+				EXPECT(grecords[j].value < rec.value);
+			}
+		}
+
+		if(std::find(ids.begin(), ids.end(), rec.thread_id) == ids.end()) {
+			ids.push_back(rec.thread_id);
+		}
+	}
+
+	EXPECT(ids.size() == 5);
+
+	// back to the plain handler
+	dlg_set_handler(plain_handler, nullptr);
+	EXPECT(dlg_get_handler_ex(&data) == nullptr);
+	dlg_info("plain");
+	EXPECT(gplain == 1);
+	EXPECT(grecords.size() == 5 * per_thread);
+
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
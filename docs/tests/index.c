@@ -0,0 +1,150 @@
+// Sidecar index of json lines logs, written by the io_uring sink.
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <dlg/index.h>
+#include <dlg/uring.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+#define RECORDS 5000
+
+bool parse_time(const char* str, int64_t* time) {
+	return dlg_index_parse_time(str, strlen(str), time);
+}
+
+int main() {
+	// time
+	int64_t time;
+	EXPECT(parse_time("1970-01-01T00:00:00.000001Z", &time) && time == 1);
+	EXPECT(parse_time("2000-03-01", &time) && time == 951868800ll * 1000000);
+	EXPECT(parse_time("2026-10-18T10:05", &time) && time == 1792317900ll * 1000000);
+	EXPECT(parse_time("2026-10-18T10:05:01.5Z", &time) &&
+		time == 1792317901ll * 1000000 + 500000);
+	EXPECT(!parse_time("2026-13-01", &time));
+	EXPECT(!parse_time("2026-10-18 10:05", &time));
+	EXPECT(!parse_time("2026", &time));
+
+	// parse records as rendered by the json output
+	const char* tags[] = {"db", "net", NULL};
+	struct dlg_origin origin = {"file.c", 12, "func", dlg_level_warn, tags, NULL};
+	char line[512];
+	size_t size = sizeof(line);
+	dlg_generic_output_json_buf(line, &size, &origin, "msg with \"tags\":[\"x\"]");
+
+	struct dlg_index_record record;
+	EXPECT(dlg_index_parse(line, size, &record));
+	EXPECT(record.level == dlg_level_warn);
+	EXPECT(record.time > 1700000000ll * 1000000);
+	EXPECT(dlg_index_has_tag(&record, "db"));
+	EXPECT(dlg_index_has_tag(&record, "net"));
+	EXPECT(!dlg_index_has_tag(&record, "x"));
+	EXPECT(!dlg_index_has_tag(&record, "d"));
+	EXPECT(!dlg_index_parse("not json", 8, &record));
+
+	// tags are compared and hashed escaped, as they are in the log
+	const char* special = "a\"b\\c\n\xff";
+	const char* special_tags[] = {special, NULL};
+	origin.tags = special_tags;
+	size = sizeof(line);
+	dlg_generic_output_json_buf(line, &size, &origin, NULL);
+	EXPECT(dlg_index_parse(line, size, &record));
+
+	char escaped[64];
+	size_t escaped_size;
+	dlg_json_escape_buf(NULL, &escaped_size, special, strlen(special));
+	EXPECT(escaped_size == 15);
+	escaped_size = sizeof(escaped);
+	dlg_json_escape_buf(escaped, &escaped_size, special, strlen(special));
+	EXPECT(!strcmp(escaped, "a\\\"b\\\\c\\n\\ufffd"));
+	EXPECT(dlg_index_has_tag(&record, escaped));
+	EXPECT(!dlg_index_has_tag(&record, special));
+	origin.tags = tags;
+
+	// written with the log
+	char path[64];
+	snprintf(path, sizeof(path), "dlg-index-test-%d.log", (int) getpid());
+	char idx_path[80];
+	snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+	unlink(path);
+	unlink(idx_path);
+
+	// enough buffers to never drop
+	struct dlg_uring* uring = dlg_uring_create(path, 32, 64 * 1024,
+		dlg_uring_json | dlg_uring_index);
+	EXPECT(uring);
+	if(!uring) {
+		return gerror;
+	}
+
+	dlg_set_handler(dlg_uring_output, uring);
+	for(unsigned i = 0u; i < RECORDS; ++i) {
+		if(i == RECORDS / 2) {
+			dlg_errort(("db"), "record %u", i);
+		} else {
+			dlg_infot(("net"), "record %u", i);
+		}
+	}
+
+	dlg_set_handler(dlg_default_output, NULL);
+	EXPECT(dlg_uring_dropped(uring) == 0);
+	dlg_uring_destroy(uring);
+
+	FILE* f = fopen(idx_path, "rb");
+	EXPECT(f);
+	if(!f) {
+		return gerror;
+	}
+
+	struct dlg_index_header header;
+	EXPECT(fread(&header, sizeof(header), 1, f) == 1);
+	EXPECT(header.magic == DLG_INDEX_MAGIC);
+	EXPECT(header.version == DLG_INDEX_VERSION);
+
+	// blocks cover the whole file, the error is only in one of them
+	struct dlg_index_block block;
+	unsigned long long end = 0u;
+	unsigned records = 0u;
+	unsigned blocks = 0u;
+	unsigned error_blocks = 0u;
+	bool sorted = true;
+	while(fread(&block, sizeof(block), 1, f) == 1) {
+		EXPECT(block.offset == end);
+		EXPECT(block.levels & (1u << dlg_level_info));
+		EXPECT(!(block.levels & DLG_INDEX_UNKNOWN));
+		EXPECT(block.tags & dlg_index_tag_bit("net", 3));
+		sorted &= block.time_min <= block.time_max;
+		error_blocks += (block.levels & (1u << dlg_level_error)) != 0;
+		end = block.offset + block.size;
+		records += block.records;
+		++blocks;
+	}
+	fclose(f);
+
+	EXPECT(sorted);
+	EXPECT(records == RECORDS);
+	EXPECT(blocks > 4);
+	EXPECT(error_blocks == 1);
+
+	f = fopen(path, "rb");
+	EXPECT(f);
+	if(f) {
+		fseek(f, 0, SEEK_END);
+		EXPECT((unsigned long long) ftell(f) == end);
+		fclose(f);
+	}
+
+	unlink(path);
+	unlink(idx_path);
+	return gerror;
+}
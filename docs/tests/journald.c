@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+
+#include <dlg/dlg.h>
+#include <dlg/journald.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+int gsocket;
+char gbuf[1024 * 1024];
+
+// Receives one record from the stand-in socket into gbuf, reading
+// it from the passed memfd if there is one. Returns the size.
+size_t receive(void) {
+	union {
+		struct cmsghdr header;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+
+	struct iovec iov = {gbuf, sizeof(gbuf)};
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	ssize_t size = recvmsg(gsocket, &msg, MSG_DONTWAIT);
+	if(size < 0) {
+		return 0;
+	}
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if(cmsg && cmsg->cmsg_type == SCM_RIGHTS) {
+		EXPECT(size == 0);
+		int fd;
+		memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+		struct stat st;
+		fstat(fd, &st);
+		size = pread(fd, gbuf, sizeof(gbuf), 0);
+		EXPECT(size == st.st_size);
+		close(fd);
+	}
+
+	return (size_t) size;
+}
+
+// Returns the value of the nth field with the given name in the
+// received record (in the static value buffer) or NULL.
+const char* field(size_t size, const char* name, unsigned nth) {
+	static char value[1024 * 1024];
+	size_t name_len = strlen(name);
+	const char* it = gbuf;
+	const char* end = gbuf + size;
+	while(it < end) {
+		const char* nl = memchr(it, '\n', end - it);
+		const char* eq = memchr(it, '=', end - it);
+		const char* val;
+		size_t len;
+		size_t flen;
+		if(eq && eq < nl) { // name=value
+			flen = eq - it;
+			val = eq + 1;
+			len = nl - val;
+		} else { // binary format
+			flen = nl - it;
+			uint64_t le = 0;
+			for(unsigned i = 0; i < 8; ++i) {
+				le |= ((uint64_t) (unsigned char) nl[1 + i]) << (8 * i);
+			}
+			val = nl + 9;
+			len = le;
+			nl = val + len;
+		}
+
+		if(flen == name_len && !memcmp(it, name, name_len) && nth-- == 0) {
+			memcpy(value, val, len);
+			value[len] = '\0';
+			return value;
+		}
+
+		it = nl + 1;
+	}
+
+	return NULL;
+}
+
+#define EXPECT_FIELD(size, name, nth, val) do { \
+	const char* f_ = field(size, name, nth); \
+	if(!f_ || strcmp(f_, val)) { \
+		printf("$$$ field %s[%d]: '%s', expected '%s' [%d]\n", \
+			name, nth, f_ ? f_ : "<none>", val, __LINE__); \
+		++gerror; \
+	} \
+} while(0)
+
+int main(void) {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/dlg-journald-test-%d", (int) getpid());
+	unlink(path);
+
+	gsocket = socket(AF_UNIX, SOCK_DGRAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if(bind(gsocket, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		printf("$$$ could not bind stand-in socket, skipping\n");
+		return 0;
+	}
+
+	struct dlg_journald* journald = dlg_journald_create(path, "dlg-test");
+	EXPECT(journald);
+	dlg_set_handler(dlg_journald_output, journald);
+
+	// simple record
+	dlg_warnt(("net", "db"), "hello %d", 42);
+	size_t size = receive();
+	EXPECT(size > 0);
+	EXPECT_FIELD(size, "MESSAGE", 0, "hello 42");
+	EXPECT_FIELD(size, "PRIORITY", 0, "4");
+	EXPECT_FIELD(size, "DLG_LEVEL", 0, "warn");
+	EXPECT_FIELD(size, "CODE_FILE", 0, "docs/tests/journald.c");
+	EXPECT_FIELD(size, "CODE_LINE", 0, "129");
+	EXPECT_FIELD(size, "CODE_FUNC", 0, "main");
+	EXPECT_FIELD(size, "SYSLOG_IDENTIFIER", 0, "dlg-test");
+	EXPECT_FIELD(size, "DLG_TAG", 0, "net");
+	EXPECT_FIELD(size, "DLG_TAG", 1, "db");
+	EXPECT(!field(size, "DLG_TAG", 2));
+	EXPECT(!field(size, "DLG_EXPR", 0));
+
+	// multiline message and assertion
+	dlg_assertlm(dlg_level_error, 1 == 2, "line 1\nline 2");
+	size = receive();
+	EXPECT_FIELD(size, "MESSAGE", 0, "assertion '1 == 2' failed: 'line 1\nline 2'");
+	EXPECT_FIELD(size, "PRIORITY", 0, "3");
+	EXPECT_FIELD(size, "DLG_EXPR", 0, "1 == 2");
+
+	dlg_assertl(dlg_level_fatal, false);
+	size = receive();
+	EXPECT_FIELD(size, "MESSAGE", 0, "assertion 'false' failed");
+	EXPECT_FIELD(size, "PRIORITY", 0, "2");
+
+	// oversized record, sent via memfd
+	size_t big_size = 512 * 1024;
+	char* big = malloc(big_size + 1);
+	memset(big, 'x', big_size);
+	big[big_size] = '\0';
+	big[1000] = '\n';
+	dlg_info("%s", big);
+	size = receive();
+	EXPECT(size > big_size);
+	const char* msg = field(size, "MESSAGE", 0);
+	EXPECT(msg && strcmp(msg, big) == 0);
+	EXPECT_FIELD(size, "PRIORITY", 0, "6");
+	free(big);
+
+	// nothing left
+	EXPECT(receive() == 0);
+
+	dlg_set_handler(dlg_default_output, NULL);
+	dlg_journald_destroy(journald);
+	close(gsocket);
+	unlink(path);
+
+	return gerror;
+}
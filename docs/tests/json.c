@@ -0,0 +1,121 @@
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <string.h>
+#include <stdio.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+char gbuf[4096];
+const char* gexpected;
+
+// Checks the rendered record, skipping the (variable) time field
+void check_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) data;
+	size_t size = sizeof(gbuf);
+	dlg_generic_output_json_buf(gbuf, &size, origin, string);
+	EXPECT(size == strlen(gbuf));
+
+	size_t needed;
+	dlg_generic_output_json_buf(NULL, &needed, origin, string);
+	EXPECT(needed == size);
+
+	const char* prefix = "{\"time\":\"";
+	EXPECT(strncmp(gbuf, prefix, strlen(prefix)) == 0);
+
+	// 2026-01-02T10:00:00.000000Z
+	const char* time = gbuf + strlen(prefix);
+	EXPECT(strlen(time) > 28 && time[4] == '-' && time[10] == 'T' &&
+		time[19] == '.' && time[26] == 'Z' && time[27] == '"');
+
+	const char* rest = time + 28;
+	if(strcmp(rest, gexpected) != 0) {
+		printf("$$$ json mismatch:\n  got:      %s  expected: %s", rest, gexpected);
+		++gerror;
+	}
+}
+
+int main(void) {
+	dlg_set_handler(check_handler, NULL);
+
+	gexpected = ",\"level\":\"info\",\"file\":\"docs/tests/json.c\",\"line\":46,"
+		"\"func\":\"main\",\"tags\":[],\"msg\":\"hello 42\"}\n";
+	dlg_info("hello %d", 42);
+
+	gexpected = ",\"level\":\"warn\",\"file\":\"docs/tests/json.c\",\"line\":50,"
+		"\"func\":\"main\",\"tags\":[\"a\",\"b\\\"c\"],\"msg\":\"tagged\"}\n";
+	dlg_warnt(("a", "b\"c"), "tagged");
+
+	gexpected = ",\"level\":\"error\",\"file\":\"docs/tests/json.c\",\"line\":54,"
+		"\"func\":\"main\",\"tags\":[],\"expr\":\"1 == \\\"2\\\"[0]\"}\n";
+	dlg_assertl(dlg_level_error, 1 == "2"[0]);
+
+	// escapes
+	gexpected = ",\"level\":\"info\",\"file\":\"docs/tests/json.c\",\"line\":60,"
+		"\"func\":\"main\",\"tags\":[],\"msg\":\"q\\\" b\\\\ n\\n t\\t r\\r "
+		"\\u0001\\u001f\\b\\f\"}\n";
+	dlg_info("%s", "q\" b\\ n\n t\t r\r \x01\x1f\b\f");
+
+	// utf-8: valid sequences are kept, invalid ones replaced
+	gexpected = ",\"level\":\"info\",\"file\":\"docs/tests/json.c\",\"line\":66,"
+		"\"func\":\"main\",\"tags\":[],\"msg\":\"\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80 "
+		"\\ufffd\\ufffd\\ufffd\\ufffd \\ufffdx\"}\n";
+	dlg_info("%s", "\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80 \xff\xc0\xaf\xed \xe2x");
+
+	// long strings, special characters at the simd block boundaries
+	char msg[200];
+	char exp[1024];
+	for(unsigned i = 0; i < 70; ++i) {
+		memset(msg, 'a', sizeof(msg));
+		msg[i] = '"';
+		msg[i + 64] = '\n';
+		msg[150] = '\0';
+
+		char* it = exp;
+		it += sprintf(it, ",\"level\":\"info\",\"file\":\"docs/tests/json.c\","
+			"\"line\":%d,\"func\":\"main\",\"tags\":[],\"msg\":\"", __LINE__ + 9);
+		for(unsigned j = 0; j < 150; ++j) {
+			if(msg[j] == '"') it += sprintf(it, "\\\"");
+			else if(msg[j] == '\n') it += sprintf(it, "\\n");
+			else *it++ = msg[j];
+		}
+		sprintf(it, "\"}\n");
+
+		gexpected = exp;
+		dlg_info("%s", msg);
+	}
+
+	// truncated buffer output
+	struct dlg_origin origin = {0};
+	const char* tags[] = {NULL};
+	origin.file = "f";
+	origin.func = "g";
+	origin.tags = tags;
+	size_t size = 10;
+	dlg_generic_output_json_buf(gbuf, &size, &origin, "x");
+	EXPECT(size == 9);
+	EXPECT(strcmp(gbuf, "{\"time\":\"") == 0);
+
+	// stream handler
+	FILE* file = tmpfile();
+	EXPECT(file);
+	if(file) {
+		dlg_set_handler(dlg_json_output, file);
+		dlg_info("to file");
+		dlg_info("line 2");
+		rewind(file);
+
+		unsigned lines = 0;
+		while(fgets(gbuf, sizeof(gbuf), file)) {
+			EXPECT(gbuf[0] == '{' && gbuf[strlen(gbuf) - 2] == '}');
+			++lines;
+		}
+		EXPECT(lines == 2);
+		fclose(file);
+	}
+
+	return gerror;
+}
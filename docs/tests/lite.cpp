@@ -0,0 +1,100 @@
+// Lightweight C++ front end: type-erased arguments formatted by dlg_format_args.
+#include <dlg/lite.hpp>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+struct Point {
+	int x, y;
+};
+
+std::ostream& operator<<(std::ostream& os, const Point& p) {
+	return os << "(" << p.x << ", " << p.y << ")";
+}
+
+enum Color { red, green };
+
+std::string glast;
+const char* gformat;
+void handler(const struct dlg_origin_ex* ex, const char* string, void*) {
+	glast = string;
+	gformat = ex->format;
+}
+
+bool equal(const char* a, const char* b) {
+	bool ok = !std::strcmp(a, b);
+	if(!ok) {
+		std::printf("'%s' != '%s'\n", a, b);
+	}
+	return ok;
+}
+
+int main() {
+	using dlg::lite::format;
+
+	// builtin types
+	EXPECT(equal(format("plain"), "plain"));
+	EXPECT(equal(format("{} {} {} {}", 1, -2l, 3u, 18446744073709551615ull),
+		"1 -2 3 18446744073709551615"));
+	EXPECT(equal(format("{} {} {}", 1.5, 0.1f, 1e20), "1.5 0.1 1e+20"));
+	EXPECT(equal(format("{}{}{}", 'a', true, false), "a10"));
+	EXPECT(equal(format("{} {}", red, green), "0 1"));
+	EXPECT(equal(format("{}", (void*) nullptr), "0"));
+	EXPECT(equal(format("{}", (const char*) nullptr), "(null)"));
+
+	// strings
+	char buf[] = "buf";
+	std::string str = "string";
+	std::string_view view = std::string_view("view-cut").substr(0, 4);
+	EXPECT(equal(format("{} {} {} {}", "lit", buf, str, view), "lit buf string view"));
+	EXPECT(equal(format(str), "string"));
+	EXPECT(equal(format(42), "42"));
+
+	// custom types, via <sstream>
+	EXPECT(equal(format("point {}", Point {1, 2}), "point (1, 2)"));
+
+	// escaping, wrong number of arguments
+	EXPECT(equal(format("\\{}\\ {}", 1), "{} 1"));
+	EXPECT(equal(format("{} {}", 1), "1 {}"));
+	EXPECT(equal(format("{}", 1, 2), "1"));
+
+	// truncated at the cap
+	std::string big(10000, 'x');
+	struct dlg_buffer_limits prev;
+	dlg_get_buffer_limits(&prev);
+	struct dlg_buffer_limits limits = {128, 128, 0};
+	dlg_set_buffer_limits(&limits);
+	std::string out = format("{} {}", big, 1);
+	EXPECT(out.size() < 128);
+	EXPECT(out.size() >= std::strlen(DLG_TRUNCATED_MARKER));
+	EXPECT(out.substr(out.size() - std::strlen(DLG_TRUNCATED_MARKER)) == DLG_TRUNCATED_MARKER);
+	dlg_set_buffer_limits(&prev);
+
+	// grows the thread buffer
+	EXPECT(format("{}{}", big, big) == big + big);
+
+	// used by the macros
+	dlg_set_handler_ex(handler, nullptr);
+	dlg_info("value {} of {}", 3, str);
+	EXPECT(glast == "value 3 of string");
+	EXPECT(gformat && equal(gformat, "value {} of {}"));
+	dlg_warnt(("tag"), Point {3, 4});
+	EXPECT(glast == "(3, 4)");
+
+	std::vector<int> values {1, 2};
+	dlg_info("size {}", values.size());
+	EXPECT(glast == "size 2");
+	dlg_set_handler(dlg_default_output, nullptr);
+
+	return gerror;
+}
@@ -0,0 +1,62 @@
+// Calls of this file belong to the module 'quiet' (floor: warn),
+// the module 'chatty' has the floor trace and 'other' none.
+#define DLG_LOG_LEVEL dlg_level_info
+#define DLG_ASSERT_LEVEL dlg_level_info
+#define DLG_MODULE quiet
+#define DLG_MODULE_LEVEL_quiet DLG_MODULE_FLOOR(dlg_level_warn)
+#define DLG_MODULE_LEVEL_chatty DLG_MODULE_FLOOR(dlg_level_trace)
+#include <dlg/dlg.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+unsigned int gfired = 0;
+
+void custom_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) origin;
+	(void) string;
+	(void) data;
+	++gfired;
+}
+
+// must never be evaluated for filtered calls
+int side_effect(int* count) {
+	return ++*count;
+}
+
+int main(void) {
+	dlg_set_handler(custom_handler, NULL);
+	int evaluated = 0;
+
+	// compile-time lookup
+	_Static_assert(DLG_MODULE_LEVEL(quiet, dlg_level_fatal) == dlg_level_warn, "");
+	_Static_assert(DLG_MODULE_LEVEL(chatty, dlg_level_fatal) == dlg_level_trace, "");
+	_Static_assert(DLG_MODULE_LEVEL(other, dlg_level_fatal) == dlg_level_fatal, "");
+	_Static_assert(DLG_MODULE_LEVEL(DLG_MODULE, dlg_level_fatal) == dlg_level_warn, "");
+
+	// file module
+	dlg_info("filtered %d", side_effect(&evaluated));
+	dlg_infot(("tag"), "filtered %d", side_effect(&evaluated));
+	dlg_assertl(dlg_level_info, side_effect(&evaluated) == 0);
+	EXPECT(gfired == 0u && evaluated == 0);
+
+	dlg_warn("not filtered %d", side_effect(&evaluated));
+	dlg_assertl(dlg_level_warn, side_effect(&evaluated) == 0);
+	EXPECT(gfired == 2u && evaluated == 2);
+
+	// explicit modules
+	gfired = 0u;
+	evaluated = 0;
+	dlg_logm(chatty, dlg_level_trace, "not filtered %d", side_effect(&evaluated));
+	dlg_logtm(chatty, dlg_level_debug, ("tag"), "not filtered");
+	dlg_logm(other, dlg_level_debug, "filtered %d", side_effect(&evaluated));
+	dlg_logm(other, dlg_level_info, "not filtered"); // DLG_LOG_LEVEL
+	dlg_logtm(quiet, dlg_level_info, ("tag"), "filtered %d", side_effect(&evaluated));
+	EXPECT(gfired == 3u && evaluated == 1);
+
+	dlg_set_handler(dlg_default_output, NULL);
+	return gerror;
+}
@@ -0,0 +1,54 @@
+#define DLG_LOG_LEVEL dlg_level_info
+#define DLG_MODULE_LEVEL_test_net DLG_MODULE_FLOOR(dlg_level_warn)
+#include <dlg/dlg.hpp>
+#include <cstdio>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+unsigned int gfired = 0;
+
+dlg_declare_module(test_net);
+dlg_declare_module(test_storage);
+struct plain {};
+struct custom {};
+
+template<>
+struct dlg::module_level<custom> : std::integral_constant<dlg_level, dlg_level_trace> {};
+
+static_assert(dlg::module_level<test_net>::value == dlg_level_warn, "");
+static_assert(dlg::module_level<test_storage>::value == dlg_level_info, "");
+static_assert(dlg::module_level<plain>::value == dlg_level_info, "");
+static_assert(dlg::module_level<custom>::value == dlg_level_trace, "");
+static_assert(!dlg::module_enabled<test_net>(dlg_level_info), "");
+static_assert(dlg::module_enabled<custom>(dlg_level_debug), "");
+
+// logs for the module it is instantiated with
+template<typename Module>
+void connect(int& evaluated) {
+	dlg_log_module(Module, dlg_level_debug, "connecting {}", ++evaluated);
+	dlg_logt_module(Module, dlg_level_warn, ("conn"), "connection failed");
+}
+
+int main() {
+	dlg_set_handler([](const struct dlg_origin*, const char*, void*) {
+		++gfired;
+	}, nullptr);
+
+	int evaluated = 0;
+	connect<test_net>(evaluated);
+	EXPECT(gfired == 1u && evaluated == 0);
+	connect<custom>(evaluated);
+	EXPECT(gfired == 3u && evaluated == 1);
+
+	// the dlg.h macros use the same table
+	dlg_logm(test_net, dlg_level_info, "filtered {}", ++evaluated);
+	dlg_logm(test_net, dlg_level_error, "not filtered {}", ++evaluated);
+	EXPECT(gfired == 4u && evaluated == 2);
+
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
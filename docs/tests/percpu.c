@@ -0,0 +1,176 @@
+// Per-cpu sharded buffers drained by the collector thread.
+#define _GNU_SOURCE
+
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <dlg/percpu.h>
+#include <pthread.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+#define THREADS 4
+#define RECORDS 500
+
+// only touched by the handler, which is never called concurrently
+unsigned gcount;
+int glast[THREADS];
+bool gordered = true;
+char gtags[256];
+char glevel;
+char gstring[1024]; // copy of the last string
+char gthread[64]; // last record rendered with %n
+char gjson[1024]; // last record rendered as json
+bool gcollector; // called in the collector thread
+
+pthread_t gmain;
+
+void handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) data;
+	++gcount;
+	gcollector = !pthread_equal(pthread_self(), gmain);
+	glevel = (char) origin->level;
+	snprintf(gstring, sizeof(gstring), "%s", string ? string : "(null)");
+
+	size_t size = sizeof(gthread);
+	dlg_generic_outputf_buf(gthread, &size, "%n", origin, string, NULL);
+	size = sizeof(gjson);
+	dlg_generic_output_json_buf(gjson, &size, origin, string);
+
+	gtags[0] = '\0';
+	for(const char** tag = origin->tags; *tag; ++tag) {
+		strcat(gtags, *tag);
+		strcat(gtags, " ");
+	}
+
+	int thread, num;
+	if(string && sscanf(string, "thread %d record %d", &thread, &num) == 2 &&
+			thread >= 0 && thread < THREADS) {
+		gordered &= (num > glast[thread]);
+		glast[thread] = num;
+	}
+}
+
+void* produce(void* data) {
+	int thread = (int) (size_t) data;
+	char name[16];
+	snprintf(name, sizeof(name), "worker-%d", thread);
+	dlg_set_thread_name(name);
+	for(int i = 0; i < RECORDS; ++i) {
+		dlg_infot(("worker"), "thread %d record %d", thread, i);
+	}
+	return NULL;
+}
+
+int main(void) {
+	gmain = pthread_self();
+
+	// long interval, only our flush calls drain
+	struct dlg_percpu* percpu = dlg_percpu_create(handler, NULL, 4096, 0, 100000);
+	EXPECT(percpu);
+	if(!percpu) {
+		return gerror;
+	}
+
+	EXPECT(dlg_percpu_shards(percpu) >= 1u);
+	dlg_set_handler(dlg_percpu_output, percpu);
+
+	// origin is passed through, tags and context are copied
+	dlg_set_thread_name("main");
+	char tag[16] = "added";
+	const char* fields[] = {"request", "7", NULL};
+	struct dlg_context context = {NULL, NULL, fields};
+	dlg_context_install(&context);
+	dlg_add_tag(tag, NULL);
+	dlg_warnt(("a", "b"), "message %d", 42);
+	dlg_remove_tag(tag, NULL);
+	dlg_context_install(NULL);
+	strcpy(tag, "changed");
+	fields[1] = "8";
+	EXPECT(gcount == 0u);
+	dlg_percpu_flush(percpu);
+	EXPECT(gcount == 1u);
+	EXPECT(!gcollector);
+	EXPECT(glevel == dlg_level_warn);
+	EXPECT(!strcmp(gtags, "added a b "));
+	EXPECT(!strcmp(gthread, "main"));
+	EXPECT(strstr(gjson, "\"fields\":{\"request\":\"7\"}"));
+	EXPECT(!strcmp(gstring, "message 42"));
+
+	// cut off messages
+	char big[1024];
+	memset(big, 'x', sizeof(big) - 1);
+	big[sizeof(big) - 1] = '\0';
+	dlg_info("%s", big);
+	dlg_percpu_flush(percpu);
+	EXPECT(gcount == 2u);
+	size_t len = strlen(gstring);
+	EXPECT(len > 0u && len < sizeof(big) - 1);
+	EXPECT(gstring[0] == 'x');
+
+	// all records arrive, in order per thread
+	for(int i = 0; i < THREADS; ++i) {
+		glast[i] = -1;
+	}
+
+	gcount = 0u;
+	pthread_t threads[THREADS];
+	for(int i = 0; i < THREADS; ++i) {
+		pthread_create(&threads[i], NULL, produce, (void*) (size_t) i);
+	}
+
+	for(int i = 0; i < THREADS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	dlg_percpu_flush(percpu);
+	EXPECT(dlg_percpu_dropped(percpu) == 0u);
+	EXPECT(gcount == THREADS * RECORDS);
+	EXPECT(gordered);
+	EXPECT(!strcmp(gtags, "worker "));
+	EXPECT(!strncmp(gthread, "worker-", 7));
+	EXPECT(!strstr(gjson, "\"fields\""));
+	for(int i = 0; i < THREADS; ++i) {
+		EXPECT(glast[i] == RECORDS - 1);
+	}
+
+	// errors wake the collector
+	gcount = 0u;
+	dlg_error("error");
+	for(int i = 0; i < 1000 && !__atomic_load_n(&gcount, __ATOMIC_SEQ_CST); ++i) {
+		struct timespec ts = {0, 1000000l};
+		nanosleep(&ts, NULL);
+	}
+	EXPECT(__atomic_load_n(&gcount, __ATOMIC_SEQ_CST) == 1u);
+	EXPECT(gcollector);
+	EXPECT(!strcmp(gthread, "main"));
+
+	// destroy hands over the rest
+	dlg_info("last");
+	dlg_set_handler(dlg_default_output, NULL);
+	dlg_percpu_destroy(percpu);
+	EXPECT(gcount == 2u);
+	EXPECT(!strcmp(gstring, "last"));
+
+	// full shards drop records
+	percpu = dlg_percpu_create(handler, NULL, 4, 0, 100000);
+	EXPECT(percpu);
+	if(percpu) {
+		dlg_set_handler(dlg_percpu_output, percpu);
+		for(int i = 0; i < 100000 && !dlg_percpu_dropped(percpu); ++i) {
+			dlg_info("record %d", i);
+		}
+		dlg_set_handler(dlg_default_output, NULL);
+		EXPECT(dlg_percpu_dropped(percpu) > 0u);
+		dlg_percpu_destroy(percpu);
+	}
+
+	return gerror;
+}
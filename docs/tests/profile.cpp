@@ -0,0 +1,100 @@
+// Uses the c api (and therefore dlg__printf_format) from multiple threads.
+#include <dlg/dlg.h>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+void noop_handler(const struct dlg_origin*, const char*, void*) {}
+
+void often(unsigned count) {
+	for(auto i = 0u; i < count; ++i) {
+		dlg_info("often %u", i);
+	}
+}
+
+void rare() {
+	dlg_warn("rare");
+}
+
+// reads the report into buf, returns the number of lines
+unsigned report(char* buf, std::size_t size, unsigned top) {
+	FILE* file = std::tmpfile();
+	dlg_profile_report(file, top);
+	auto len = std::size_t(std::ftell(file));
+	EXPECT(len < size);
+	std::rewind(file);
+	len = std::fread(buf, 1, size - 1, file);
+	buf[len] = '\0';
+	std::fclose(file);
+
+	unsigned lines = 0u;
+	for(auto c = buf; *c; ++c) {
+		lines += (*c == '\n');
+	}
+	return lines;
+}
+
+int main() {
+	dlg_set_handler(noop_handler, nullptr);
+	rare(); // not profiled
+
+	dlg_set_profiling(true);
+	often(100);
+	rare();
+
+	// records of exited threads are kept
+	std::thread t1([]{ often(100); });
+	t1.join();
+
+	// running thread
+	bool done = false;
+	bool logged = false;
+	std::thread t2([&]{
+		often(50);
+		rare();
+		logged = true;
+		while(!done) {
+			std::this_thread::yield();
+		}
+	});
+
+	while(!logged) {
+		std::this_thread::yield();
+	}
+
+	dlg_set_profiling(false);
+	often(10); // not profiled
+
+	char buf[4096];
+	auto lines = report(buf, sizeof(buf), 0);
+	EXPECT(lines == 4); // header, column names, 2 callsites
+	EXPECT(std::strstr(buf, "dlg profile: 2 callsites, 252 records\n") == buf);
+
+	// "often" has the most hits and is (very likely) more expensive
+	auto often_line = std::strstr(buf, "often");
+	auto rare_line = std::strstr(buf, "rare");
+	EXPECT(often_line && rare_line);
+	if(often_line && rare_line) {
+		EXPECT(often_line < rare_line);
+		EXPECT(std::strstr(buf, "       250 ") && std::strstr(buf, "         2 "));
+	}
+
+	// bytes: "often 0".."often 9" (7 bytes), "often 10".."often 99" (8 bytes),
+	// i.e. 2 * (70 + 720) + (70 + 320)
+	EXPECT(std::strstr(buf, " 250         1970 "));
+
+	lines = report(buf, sizeof(buf), 1);
+	EXPECT(lines == 3);
+	EXPECT(!std::strstr(buf, "rare"));
+
+	done = true;
+	t2.join();
+	return gerror;
+}
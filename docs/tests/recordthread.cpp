@@ -0,0 +1,93 @@
+// Rendering records in another thread than the one that logged them.
+#include <dlg/dlg.hpp>
+#include <dlg/output.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+// What a forwarding handler would queue, only one record here.
+struct Record {
+	struct dlg_origin origin;
+	std::string string;
+	struct dlg_record_thread thread;
+};
+
+Record grecord;
+const char* const gfull = "%i|%n|%c";
+const char* const gname = "%n|%c";
+
+void handler(const struct dlg_origin* origin, const char* string, void*) {
+	static const char* no_tags[] = {nullptr};
+	grecord.origin = *origin;
+	grecord.origin.tags = no_tags; // only valid during the call
+	grecord.string = string ? string : "";
+	dlg_get_record_thread(&grecord.thread);
+}
+
+std::string render(const char* format) {
+	char buf[512];
+	size_t size = sizeof(buf);
+	dlg_generic_outputf_buf(buf, &size, format, &grecord.origin,
+		grecord.string.c_str(), dlg_default_output_styles);
+	return buf;
+}
+
+std::string render_json() {
+	char buf[512];
+	size_t size = sizeof(buf);
+	dlg_generic_output_json_buf(buf, &size, &grecord.origin, grecord.string.c_str());
+	return buf;
+}
+
+int main() {
+	dlg_set_handler(handler, nullptr);
+
+	// handlers called by dlg run in the logging thread
+	dlg::Context context({}, {{"request", "7"}});
+	std::string id;
+	std::thread([&]{
+		dlg_set_thread_name("logger");
+		dlg::ContextGuard guard(context);
+		dlg_info("message");
+		id = std::to_string(grecord.thread.id);
+		EXPECT(render(gfull) == id + "|logger|message");
+		EXPECT(!std::strcmp(grecord.thread.name, "logger"));
+	}).join();
+
+	EXPECT(grecord.thread.context == &context);
+
+	// without a record thread, the rendering thread is assumed
+	dlg_set_thread_name("collector");
+	EXPECT(render(gname) == "collector|message");
+	EXPECT(render_json().find("\"fields\"") == std::string::npos);
+
+	// with one, the logging thread (and its context) is rendered
+	struct dlg_record_thread thread = grecord.thread;
+	thread.name = "logger"; // the logging thread has exited
+	dlg_set_record_thread(&thread);
+	EXPECT(render(gfull) == id + "|logger|message");
+	EXPECT(render_json().find("\"fields\":{\"request\":\"7\"}") != std::string::npos);
+
+	struct dlg_record_thread current;
+	dlg_get_record_thread(&current);
+	EXPECT(current.id == thread.id && current.context == &context);
+
+	// records logged meanwhile are our own
+	dlg_info("own");
+	EXPECT(!std::strcmp(grecord.thread.name, "collector"));
+	EXPECT(grecord.thread.context == nullptr);
+
+	dlg_set_record_thread(nullptr);
+	EXPECT(render(gname) == "collector|own");
+
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
@@ -0,0 +1,232 @@
+// Shared memory ring with multiple producer processes.
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlg/dlg.h>
+#include <dlg/shm.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+#define CHILDREN 4
+#define RECORDS 500
+
+struct collected {
+	unsigned count;
+	unsigned pids[CHILDREN];
+	int last[CHILDREN]; // last record number per child
+	bool ordered;
+	char last_record[600];
+};
+
+void collect(const char* record, size_t size, unsigned pid, void* data) {
+	struct collected* col = (struct collected*) data;
+	++col->count;
+	snprintf(col->last_record, sizeof(col->last_record), "%.*s", (int) size, record);
+
+	int child, num;
+	const char* msg = strstr(record, "] ");
+	if(!msg || sscanf(msg, "] child %d record %d", &child, &num) != 2) {
+		return;
+	}
+
+	if(child < 0 || child >= CHILDREN) {
+		col->ordered = false;
+		return;
+	}
+
+	if(col->pids[child] && col->pids[child] != pid) {
+		col->ordered = false;
+	}
+	col->pids[child] = pid;
+	if(num != col->last[child] + 1) {
+		col->ordered = false;
+	}
+	col->last[child] = num;
+}
+
+void sleep_ms(long ms) {
+	struct timespec ts = {0, ms * 1000000l};
+	nanosleep(&ts, NULL);
+}
+
+// Odd children open the ring by name, even ones log through the
+// handle inherited from the parent (pre-forked workers).
+void produce(const char* name, struct dlg_shm* inherited, int child) {
+	struct dlg_shm* shm = (child % 2) ? dlg_shm_open(name, 0, 0) : inherited;
+	if(!shm) {
+		_exit(1);
+	}
+
+	dlg_set_handler(dlg_shm_output, shm);
+	for(int i = 0; i < RECORDS; ++i) {
+		dlg_info("child %d record %d", child, i);
+	}
+
+	dlg_set_handler(dlg_default_output, NULL);
+	if(shm != inherited) {
+		dlg_shm_close(shm);
+	}
+	_exit(0);
+}
+
+int main() {
+	char name[64];
+	snprintf(name, sizeof(name), "/dlg-test-%d", (int) getpid());
+
+	// multiple processes
+	struct dlg_shm* shm = dlg_shm_open(name, 4096, 0);
+	EXPECT(shm);
+	if(!shm) {
+		return gerror;
+	}
+
+	pid_t pids[CHILDREN];
+	for(int i = 0; i < CHILDREN; ++i) {
+		pids[i] = fork();
+		if(pids[i] == 0) {
+			produce(name, shm, i);
+		}
+	}
+
+	struct collected col;
+	memset(&col, 0, sizeof(col));
+	col.ordered = true;
+	for(int i = 0; i < CHILDREN; ++i) {
+		col.last[i] = -1;
+	}
+
+	for(unsigned i = 0u; i < 500u && col.count < CHILDREN * RECORDS; ++i) {
+		dlg_shm_read(shm, collect, &col);
+		dlg_shm_wait(shm, 10);
+	}
+
+	for(int i = 0; i < CHILDREN; ++i) {
+		int status;
+		EXPECT(waitpid(pids[i], &status, 0) == pids[i]);
+		EXPECT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+
+	// the children may have been slower than the loop above
+	dlg_shm_read(shm, collect, &col);
+
+	EXPECT(col.count == CHILDREN * RECORDS);
+	EXPECT(col.ordered);
+	for(int i = 0; i < CHILDREN; ++i) {
+		EXPECT(col.pids[i] == (unsigned) pids[i]);
+		EXPECT(col.last[i] == RECORDS - 1);
+	}
+	EXPECT(dlg_shm_dropped(shm) == 0);
+	EXPECT(strstr(col.last_record, "shm.c:") && col.last_record[strlen(col.last_record) - 1] == '\n');
+
+	// a crashed producer: slot reserved but never committed
+	int fd = shm_open(name, O_RDWR, 0);
+	EXPECT(fd >= 0);
+	struct dlg_shm_header* header = (struct dlg_shm_header*) mmap(NULL,
+		sizeof(*header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	EXPECT(header != MAP_FAILED);
+	if(header != MAP_FAILED) {
+		EXPECT(header->magic == DLG_SHM_MAGIC);
+		__atomic_fetch_add(&header->write, 1u, __ATOMIC_SEQ_CST);
+		munmap(header, sizeof(*header));
+	}
+
+	EXPECT(dlg_shm_write(shm, "after", 5));
+	col.count = 0;
+	dlg_shm_set_abandon_timeout(shm, 20);
+	EXPECT(dlg_shm_read(shm, collect, &col) == 0); // timeout starts
+	sleep_ms(30);
+	EXPECT(dlg_shm_read(shm, collect, &col) == 1);
+	EXPECT(!strcmp(col.last_record, "after"));
+	EXPECT(dlg_shm_abandoned(shm) == 1);
+
+	dlg_shm_close(shm);
+	EXPECT(dlg_shm_unlink(name));
+
+	// full ring and truncation
+	shm = dlg_shm_open(name, 8, 64);
+	EXPECT(shm);
+	if(shm) {
+		char long_record[200];
+		memset(long_record, 'a', sizeof(long_record));
+		for(unsigned i = 0u; i < 10; ++i) {
+			EXPECT(dlg_shm_write(shm, long_record, sizeof(long_record)) == (i < 8));
+		}
+		EXPECT(dlg_shm_dropped(shm) == 2);
+
+		col.count = 0;
+		EXPECT(dlg_shm_read(shm, collect, &col) == 8);
+		EXPECT(strlen(col.last_record) == 64 - sizeof(struct dlg_shm_slot) - 1);
+
+		// wraps around
+		EXPECT(dlg_shm_write(shm, "wrapped", 7));
+		EXPECT(dlg_shm_read(shm, collect, &col) == 1);
+		EXPECT(!strcmp(col.last_record, "wrapped"));
+
+		// a stalled producer: the slot isn't reused until it gives it up
+		size_t size = sizeof(struct dlg_shm_header) + 8 * 64;
+		fd = shm_open(name, O_RDWR, 0);
+		EXPECT(fd >= 0);
+		header = (struct dlg_shm_header*) mmap(NULL, size,
+			PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		EXPECT(header != MAP_FAILED);
+		if(header != MAP_FAILED) {
+			uint64_t pos = __atomic_fetch_add(&header->write, 1u, __ATOMIC_SEQ_CST);
+			struct dlg_shm_slot* slot = (struct dlg_shm_slot*) ((char*) (header + 1) +
+				(pos % 8) * 64);
+
+			dlg_shm_set_abandon_timeout(shm, 20);
+			EXPECT(dlg_shm_write(shm, "after", 5));
+			EXPECT(dlg_shm_read(shm, collect, &col) == 0);
+			sleep_ms(30);
+			EXPECT(dlg_shm_read(shm, collect, &col) == 1);
+			EXPECT(dlg_shm_abandoned(shm) == 1);
+			EXPECT(slot->seq == (pos | DLG_SHM_ABANDONED));
+
+			// a full round passes over it, the late write changes nothing
+			for(unsigned i = 0u; i < 7; ++i) {
+				EXPECT(dlg_shm_write(shm, "round", 5));
+			}
+			EXPECT(!dlg_shm_write(shm, "full", 4));
+			memcpy(slot + 1, "stale", 6);
+			slot->size = 5;
+			EXPECT(dlg_shm_read(shm, collect, &col) == 7);
+			EXPECT(!strcmp(col.last_record, "round"));
+
+			// given up (as the commit does), freed when the reader passes it
+			__atomic_fetch_or(&slot->seq, DLG_SHM_RELEASED, __ATOMIC_RELEASE);
+			for(unsigned r = 0u; r < 2; ++r) {
+				for(unsigned i = 0u; i < 7; ++i) {
+					EXPECT(dlg_shm_write(shm, "round", 5));
+				}
+				EXPECT(dlg_shm_read(shm, collect, &col) == 7);
+			}
+			EXPECT(!(slot->seq & DLG_SHM_ABANDONED));
+			for(unsigned i = 0u; i < 8; ++i) {
+				EXPECT(dlg_shm_write(shm, "reused", 6));
+			}
+			EXPECT(dlg_shm_read(shm, collect, &col) == 8);
+			EXPECT(!strcmp(col.last_record, "reused"));
+			EXPECT(dlg_shm_dropped(shm) == 3);
+			munmap(header, size);
+		}
+
+		dlg_shm_close(shm);
+		dlg_shm_unlink(name);
+	}
+
+	return gerror;
+}
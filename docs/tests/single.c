@@ -0,0 +1,55 @@
+// Single header version of dlg, see dlg_impl.h.
+#define DLG_IMPLEMENTATION
+#include "dlg_impl.h"
+#include <string.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+unsigned int gcount = 0;
+char glast[64];
+
+void handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) origin;
+	(void) data;
+	++gcount;
+	snprintf(glast, sizeof(glast), "%s", string);
+}
+
+void log_values(void) {
+	dlg_debug("debug %d", 1);
+	dlg_warnt(("net"), "warn %d", 2);
+}
+
+int main(void) {
+	dlg_set_handler(handler, NULL);
+	log_values();
+	EXPECT(gcount == 2);
+	EXPECT(!strcmp(glast, "warn 2"));
+
+	// the filter generation is read inline
+	unsigned gen = dlg__filter_gen;
+	EXPECT(dlg_set_filter("* >= warn"));
+	EXPECT(dlg__filter_gen != gen);
+	EXPECT(dlg_filter_generation() == dlg__filter_gen);
+	log_values();
+	EXPECT(gcount == 3);
+
+	EXPECT(dlg_set_filter(NULL));
+	log_values();
+	EXPECT(gcount == 5);
+
+	// output.h is part of it as well
+	char buf[128];
+	size_t size = sizeof(buf);
+	const char* tags[] = {NULL};
+	struct dlg_origin origin = {"file.c", 1, "func", dlg_level_info, tags, NULL};
+	dlg_generic_outputf_buf(buf, &size, "%c", &origin, "msg", NULL);
+	EXPECT(!strcmp(buf, "msg"));
+
+	dlg_set_handler(dlg_default_output, NULL);
+	return gerror;
+}
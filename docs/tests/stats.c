@@ -0,0 +1,117 @@
+#define DLG_STATS_FILTERED
+#define DLG_LOG_LEVEL dlg_level_info
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <string.h>
+#include <stdio.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+void noop_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	(void) origin;
+	(void) string;
+	(void) data;
+}
+
+// only checks the thread level
+#pragma push_macro("DLG_RUNTIME_FILTER")
+#undef DLG_RUNTIME_FILTER
+#define DLG_RUNTIME_FILTER 0
+void log_unfiltered(void) {
+	dlg_warn("filtered by the thread level");
+}
+#pragma pop_macro("DLG_RUNTIME_FILTER")
+
+int main() {
+	struct dlg_stats before, after;
+	dlg_get_stats(&before);
+
+	// counting
+	dlg_set_handler(noop_handler, NULL);
+	dlg_info("info %d", 1);
+	dlg_warn("warn");
+	dlg_warn("warn %s", "2");
+	dlg_debug("filtered");
+	dlg_trace("filtered");
+	dlg_assertl(dlg_level_warn, 1 == 2);
+	dlg_assertl(dlg_level_warn, 1 == 1); // not counted, passed
+
+	dlg_get_stats(&after);
+	EXPECT(after.records[dlg_level_info] - before.records[dlg_level_info] == 1);
+	EXPECT(after.records[dlg_level_warn] - before.records[dlg_level_warn] == 3);
+	EXPECT(after.records[dlg_level_debug] == before.records[dlg_level_debug]);
+	EXPECT(after.filtered - before.filtered == 2);
+	EXPECT(after.bytes_formatted - before.bytes_formatted ==
+		strlen("info 1") + strlen("warn") + strlen("warn 2"));
+	EXPECT(after.threads >= 1);
+	EXPECT(after.handler_ns == before.handler_ns);
+
+	// buffer reallocation
+	char long_string[512];
+	memset(long_string, 'a', sizeof(long_string) - 1);
+	long_string[sizeof(long_string) - 1] = '\0';
+	dlg_get_stats(&before);
+	dlg_info("%s", long_string);
+	dlg_info("%s", long_string);
+	dlg_get_stats(&after);
+	EXPECT(after.buffer_reallocs - before.buffer_reallocs == 1);
+
+	// output bytes and timing
+	FILE* file = tmpfile();
+	EXPECT(file);
+	if(file) {
+		dlg_set_stats_timing(true);
+		dlg_set_handler(dlg_default_output, file);
+		dlg_get_stats(&before);
+		dlg_info("output");
+		dlg_set_handler(dlg_json_output, file);
+		dlg_warn("json");
+		dlg_get_stats(&after);
+		dlg_set_stats_timing(false);
+		dlg_set_handler(noop_handler, NULL);
+
+		EXPECT((long) (after.bytes_output - before.bytes_output) == ftell(file));
+		EXPECT(after.handler_ns > before.handler_ns);
+		EXPECT(after.lock_ns > before.lock_ns);
+		EXPECT(after.lock_ns - before.lock_ns <= after.handler_ns - before.handler_ns);
+
+		// prometheus format
+		rewind(file);
+		dlg_write_stats(file);
+		long size = ftell(file);
+		EXPECT(size > 0 && size < 4096);
+
+		char buf[4096] = {0};
+		rewind(file);
+		EXPECT(fread(buf, 1, sizeof(buf) - 1, file) == (size_t) size);
+		EXPECT(strstr(buf, "# TYPE dlg_records_total counter\n"));
+		EXPECT(strstr(buf, "\ndlg_records_total{level=\"warn\"} "));
+		EXPECT(strstr(buf, "\ndlg_filtered_total 2\n"));
+		EXPECT(strstr(buf, "\ndlg_handler_seconds_total 0.0"));
+		fclose(file);
+	}
+
+	// calls filtered at runtime
+	dlg_get_stats(&before);
+	EXPECT(dlg_set_filter("*>=warn"));
+	dlg_info("filtered");
+	dlg_info("filtered");
+	dlg_warn("passed");
+	EXPECT(dlg_set_filter(NULL));
+	int level = dlg_set_thread_level(dlg_level_error);
+	dlg_warn("filtered");
+	log_unfiltered();
+	dlg_set_thread_level(level);
+	dlg_get_stats(&after);
+	EXPECT(after.filtered - before.filtered == 4);
+	EXPECT(after.records[dlg_level_warn] - before.records[dlg_level_warn] == 1);
+
+	EXPECT(dlg_dump_stats(NULL, 0));
+	dlg_set_handler(dlg_default_output, NULL);
+	return gerror;
+}
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE
+
+#include <dlg/dlg.h>
+#include <dlg/syslog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+char gbuf[DLG_SYSLOG_MAX_RECORD + 1];
+
+// Receives a single datagram (non-blocking) into gbuf.
+// Returns its size or -1 if there is none.
+int receive(int fd) {
+	ssize_t size = recv(fd, gbuf, sizeof(gbuf) - 1, MSG_DONTWAIT);
+	if(size >= 0) {
+		gbuf[size] = '\0';
+	}
+	return (int) size;
+}
+
+unsigned receive_all(int fd) {
+	unsigned count = 0;
+	while(receive(fd) >= 0) {
+		++count;
+	}
+	return count;
+}
+
+double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void test_udp(void) {
+	int listener = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t addr_len = sizeof(addr);
+	if(bind(listener, (struct sockaddr*) &addr, addr_len) != 0 ||
+			getsockname(listener, (struct sockaddr*) &addr, &addr_len) != 0) {
+		printf("$$$ could not bind udp listener, skipping\n");
+		return;
+	}
+
+	int rcvbuf = 8 * 1024 * 1024;
+	setsockopt(listener, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	char address[64];
+	snprintf(address, sizeof(address), "127.0.0.1:%d", ntohs(addr.sin_port));
+	struct dlg_syslog* syslog = dlg_syslog_create(address, "dlg-test", 1, 64);
+	EXPECT(syslog);
+	if(!syslog) {
+		return;
+	}
+
+	dlg_set_handler(dlg_syslog_output, syslog);
+
+	// batching: nothing is sent until the batch is full
+	for(unsigned i = 0; i < 63; ++i) {
+		dlg_info("record %u", i);
+	}
+	EXPECT(receive(listener) < 0);
+
+	dlg_infot(("a", "b\"]"), "record %u", 63);
+
+	// framing
+	EXPECT(receive(listener) > 0);
+	const char* prefix = "<14>1 ";
+	EXPECT(strncmp(gbuf, prefix, strlen(prefix)) == 0);
+	char expected[512];
+	snprintf(expected, sizeof(expected), " dlg-test %ld - [dlg@32473 "
+		"file=\"docs/tests/syslog.c\" line=\"74\" func=\"test_udp\"] record 0",
+		(long) getpid());
+	EXPECT(strstr(gbuf, expected) != NULL);
+	EXPECT(gbuf[10] == '-' && gbuf[16] == 'T' && gbuf[32] == 'Z');
+
+	EXPECT(receive_all(listener) == 63);
+	EXPECT(strstr(gbuf, "tags=\"a,b\\\"\\]\"] record 63") != NULL);
+
+	// errors are sent immediately
+	dlg_assertlm(dlg_level_error, 1 == 2, "%s", "failed");
+	EXPECT(receive(listener) > 0);
+	EXPECT(strncmp(gbuf, "<11>1 ", 6) == 0);
+	EXPECT(strstr(gbuf, " expr=\"1 == 2\"] assertion '1 == 2' failed: 'failed'") != NULL);
+
+	// explicit flush
+	dlg_warn("flushed");
+	EXPECT(receive(listener) < 0);
+	dlg_syslog_flush(syslog);
+	EXPECT(receive(listener) > 0);
+	EXPECT(strncmp(gbuf, "<12>1 ", 6) == 0);
+
+	// throughput, not checked
+	unsigned count = 64 * 1024;
+	double start = now();
+	for(unsigned i = 0; i < count; ++i) {
+		dlg_info("throughput record %u", i);
+	}
+	double secs = now() - start;
+	printf("syslog udp: %.0f records/s (%.1f ns/record)\n",
+		count / secs, 1e9 * secs / count);
+
+	EXPECT(dlg_syslog_dropped(syslog) == 0);
+	dlg_set_handler(dlg_default_output, NULL);
+	dlg_syslog_destroy(syslog);
+	close(listener);
+}
+
+void test_unix(void) {
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/dlg-syslog-test-%d", (int) getpid());
+	unlink(path);
+
+	int listener = socket(AF_UNIX, SOCK_DGRAM, 0);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if(bind(listener, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		printf("$$$ could not bind unix listener, skipping\n");
+		return;
+	}
+
+	struct dlg_syslog* syslog = dlg_syslog_create(path, NULL, 16, 4);
+	EXPECT(syslog);
+	if(!syslog) {
+		return;
+	}
+
+	dlg_set_handler(dlg_syslog_output, syslog);
+
+	// the listener doesn't read, so the socket will block at some
+	// point and records get queued and then dropped.
+	unsigned count = 1000;
+	for(unsigned i = 0; i < count; ++i) {
+		dlg_debug("record %u", i);
+	}
+
+	unsigned long dropped = dlg_syslog_dropped(syslog);
+	EXPECT(dropped > 0);
+
+	unsigned received = receive_all(listener);
+	EXPECT(received > 0);
+	EXPECT(strncmp(gbuf, "<135>1 ", 7) == 0);
+	char expected[64];
+	snprintf(expected, sizeof(expected), " - %ld - [dlg@32473 ", (long) getpid());
+	EXPECT(strstr(gbuf, expected) != NULL);
+
+	// the queued records are sent now
+	for(unsigned i = 0; i < 10; ++i) {
+		dlg_syslog_flush(syslog);
+		received += receive_all(listener);
+	}
+	EXPECT(received + dropped == count);
+	EXPECT(dlg_syslog_dropped(syslog) == dropped);
+
+	dlg_set_handler(dlg_default_output, NULL);
+	dlg_syslog_destroy(syslog);
+	close(listener);
+	unlink(path);
+}
+
+int main(void) {
+	test_udp();
+	test_unix();
+	return gerror;
+}
@@ -0,0 +1,82 @@
+// Level overrides per thread, see dlg_set_thread_level.
+#include <dlg/dlg.hpp>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+#define EXPECT(a) if(!(a)) { \
+	std::printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+std::atomic<unsigned> gcount {};
+
+void handler(const struct dlg_origin*, const char*, void*) {
+	++gcount;
+}
+
+// logs one record per level, returns how many were logged
+unsigned log_all() {
+	auto before = gcount.load();
+	dlg_trace("trace");
+	dlg_debug("debug");
+	dlg_info("info");
+	dlg_warn("warn");
+	dlg_error("error");
+	dlg_fatal("fatal");
+	return gcount.load() - before;
+}
+
+int main() {
+	dlg_set_handler(handler, nullptr);
+	EXPECT(dlg_get_thread_level() == -1);
+	EXPECT(log_all() == 6u);
+
+	EXPECT(dlg_set_filter("* >= warn"));
+	EXPECT(log_all() == 3u);
+
+	// overrides the filter, in both directions
+	EXPECT(dlg_set_thread_level(dlg_level_debug) == -1);
+	EXPECT(log_all() == 5u);
+	EXPECT(dlg_set_thread_level(dlg_level_error) == dlg_level_debug);
+	EXPECT(log_all() == 2u);
+	EXPECT(dlg_set_thread_level(dlg_level_fatal + 1) == dlg_level_error);
+	EXPECT(log_all() == 0u);
+	EXPECT(dlg_set_thread_level(100) == dlg_level_fatal + 1);
+	EXPECT(dlg_get_thread_level() == dlg_level_fatal + 1);
+	EXPECT(dlg_set_thread_level(-1) == dlg_level_fatal + 1);
+	EXPECT(log_all() == 3u);
+
+	// scoped, only for this thread
+	{
+		dlg_scoped_level(dlg_level_trace);
+		EXPECT(log_all() == 6u);
+
+		unsigned other = 0u;
+		std::thread([&]{ other = log_all(); }).join();
+		EXPECT(other == 3u);
+
+		{
+			dlg::ScopedLevel inner(dlg_level_fatal);
+			EXPECT(log_all() == 1u);
+		}
+
+		EXPECT(dlg_get_thread_level() == dlg_level_trace);
+	}
+
+	EXPECT(dlg_get_thread_level() == -1);
+	EXPECT(log_all() == 3u);
+
+	// other threads have their own override
+	unsigned other = 0u;
+	std::thread([&]{
+		dlg_scoped_level(dlg_level_info);
+		other = log_all();
+	}).join();
+	EXPECT(other == 4u);
+
+	dlg_set_filter(nullptr);
+	dlg_set_handler(dlg_default_output, nullptr);
+	return gerror;
+}
@@ -0,0 +1,64 @@
+#include <dlg/dlg.h>
+#include <dlg/output.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+char gbuf[256];
+
+void outputf_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	size_t size = sizeof(gbuf);
+	dlg_generic_outputf_buf(gbuf, &size, (const char*) data, origin, string,
+		dlg_default_output_styles);
+}
+
+void output_handler(const struct dlg_origin* origin, const char* string, void* data) {
+	size_t size = sizeof(gbuf);
+	dlg_generic_output_buf(gbuf, &size, *(unsigned*) data, origin, string,
+		dlg_default_output_styles);
+}
+
+int main() {
+	// default: os name or id, never empty
+	const char* name = dlg_get_thread_name();
+	EXPECT(name && *name);
+
+	dlg_set_handler(outputf_handler, "%i|%n|%c");
+	dlg_info("message");
+
+	char* end;
+	unsigned long long id = strtoull(gbuf, &end, 10);
+	EXPECT(id != 0 && *end == '|');
+	EXPECT(!strcmp(end + 1 + strlen(name), "|message"));
+
+	dlg_set_thread_name("worker-1");
+	EXPECT(!strcmp(dlg_get_thread_name(), "worker-1"));
+	dlg_info("renamed");
+	EXPECT(!strcmp(end, "|worker-1|renamed"));
+
+	// cut off after 31 bytes
+	dlg_set_thread_name("0123456789012345678901234567890123456789");
+	EXPECT(strlen(dlg_get_thread_name()) == 31);
+
+	// feature flags
+	dlg_set_thread_name("main");
+	unsigned features = dlg_output_thread_name;
+	dlg_set_handler(output_handler, &features);
+	dlg_info("flags");
+	EXPECT(!strcmp(gbuf, "[main] flags"));
+
+	features = dlg_output_thread_id | dlg_output_thread_name | dlg_output_newline;
+	dlg_info("flags");
+	char expected[64];
+	snprintf(expected, sizeof(expected), "[%llu main] flags\n", id);
+	EXPECT(!strcmp(gbuf, expected));
+
+	dlg_set_handler(dlg_default_output, NULL);
+	return gerror;
+}
@@ -0,0 +1,151 @@
+// io_uring file sink and its writer thread fallback.
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlg/dlg.h>
+#include <dlg/uring.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define EXPECT(a) if(!(a)) { \
+	printf("$$$ Expect '" #a "' failed [%d]\n", __LINE__); \
+	++gerror; \
+}
+
+unsigned int gerror = 0;
+
+#define THREADS 4
+#define RECORDS 2000
+
+struct dlg_uring* guring;
+
+void* produce(void* data) {
+	int thread = (int) (size_t) data;
+	char buf[64];
+	for(int i = 0; i < RECORDS; ++i) {
+		int len = snprintf(buf, sizeof(buf), "thread %d record %d\n", thread, i);
+		// retry dropped records, the test checks completeness
+		while(!dlg_uring_write(guring, buf, (size_t) len)) {
+			dlg_uring_flush(guring);
+		}
+	}
+	return NULL;
+}
+
+// Checks that every thread wrote all its records, in order.
+void check_file(const char* path) {
+	FILE* f = fopen(path, "r");
+	EXPECT(f);
+	if(!f) {
+		return;
+	}
+
+	int last[THREADS];
+	for(int i = 0; i < THREADS; ++i) {
+		last[i] = -1;
+	}
+
+	bool ordered = true;
+	char line[128];
+	unsigned lines = 0u;
+	while(fgets(line, sizeof(line), f)) {
+		int thread, num;
+		++lines;
+		if(sscanf(line, "thread %d record %d", &thread, &num) != 2 ||
+				thread < 0 || thread >= THREADS || num != last[thread] + 1) {
+			ordered = false;
+			continue;
+		}
+		last[thread] = num;
+	}
+
+	fclose(f);
+	EXPECT(ordered);
+	EXPECT(lines == THREADS * RECORDS);
+	for(int i = 0; i < THREADS; ++i) {
+		EXPECT(last[i] == RECORDS - 1);
+	}
+}
+
+void run(const char* path, unsigned flags) {
+	unlink(path);
+	guring = dlg_uring_create(path, 4, 4096, flags);
+	EXPECT(guring);
+	if(!guring) {
+		return;
+	}
+
+	printf("flags %u: %s\n", flags, dlg_uring_async(guring) ?
+		"io_uring" : "writer threads");
+	if(flags & dlg_uring_threads) {
+		EXPECT(!dlg_uring_async(guring));
+	}
+
+	pthread_t threads[THREADS];
+	for(int i = 0; i < THREADS; ++i) {
+		pthread_create(&threads[i], NULL, produce, (void*) (size_t) i);
+	}
+	for(int i = 0; i < THREADS; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+
+	EXPECT(dlg_uring_errors(guring) == 0);
+	dlg_uring_destroy(guring);
+	check_file(path);
+}
+
+int main() {
+	char path[64];
+	snprintf(path, sizeof(path), "dlg-uring-test-%d.log", (int) getpid());
+
+	run(path, 0);
+	run(path, dlg_uring_sync);
+	run(path, dlg_uring_threads);
+	run(path, dlg_uring_threads | dlg_uring_sync);
+
+	// output handler, appends to the existing file
+	struct dlg_uring* uring = dlg_uring_create(path, 2, 128, 0);
+	EXPECT(uring);
+	if(uring) {
+		dlg_set_handler(dlg_uring_output, uring);
+		dlg_info("first");
+		dlg_error("second");
+
+		// cut off at the buffer size
+		char long_msg[300];
+		memset(long_msg, 'a', sizeof(long_msg) - 1);
+		long_msg[sizeof(long_msg) - 1] = '\0';
+		dlg_warn("%s", long_msg);
+
+		// drop when all buffers are in flight (never waits for them)
+		unsigned long long dropped = 0u;
+		for(unsigned i = 0u; i < 100u && !dropped; ++i) {
+			dlg_uring_write(uring, long_msg, 128);
+			dropped = dlg_uring_dropped(uring);
+		}
+
+		dlg_set_handler(dlg_default_output, NULL);
+		EXPECT(dlg_uring_errors(uring) == 0);
+		dlg_uring_destroy(uring);
+
+		FILE* f = fopen(path, "r");
+		EXPECT(f);
+		if(f) {
+			char* content = (char*) calloc(1, 1024 * 1024);
+			size_t size = fread(content, 1, 1024 * 1024 - 1, f);
+			fclose(f);
+			EXPECT(size > THREADS * RECORDS * 10);
+			EXPECT(strstr(content, "uring.c:"));
+			char* first = strstr(content, "first\n");
+			char* second = strstr(content, "second\n");
+			EXPECT(first && second && first < second);
+			EXPECT(strstr(content, "aaa"));
+			free(content);
+		}
+	}
+
+	unlink(path);
+	return gerror;
+}
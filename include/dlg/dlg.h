@@ -37,14 +37,72 @@
 	#endif
 #endif
 
+// Per-module compile-time level floors. A module is an identifier (e.g. net),
+// its floor is set by defining DLG_MODULE_LEVEL_<module> as DLG_MODULE_FLOOR(level),
+// usually from the build system (meson: -Dlevel_overrides=net:warn,storage:debug).
+//   #define DLG_MODULE_LEVEL_net DLG_MODULE_FLOOR(dlg_level_warn)
+// The floor replaces DLG_LOG_LEVEL and DLG_ASSERT_LEVEL for all calls of the module,
+// i.e. the calls in files defining DLG_MODULE before including dlg.h and
+// the calls made via dlg_logm/dlg_logtm. Calls below it are eliminated completely.
+// #define DLG_MODULE net
+#define DLG_MODULE_FLOOR(level) ~, level
+
+// Evaluates to the floor of the given module or to fallback if it has none.
+#define DLG_MODULE_LEVEL(module, fallback) DLG__MODULE_LEVEL(module, fallback)
+#define DLG__MODULE_LEVEL(module, fallback) \
+	DLG__SECOND_((DLG_MODULE_LEVEL_##module, fallback, ~))
+#define DLG__SECOND_(args) DLG__SECOND args
+#define DLG__SECOND(a, b, ...) b
+
+#ifdef DLG_MODULE
+	#define DLG__LOG_FLOOR DLG_MODULE_LEVEL(DLG_MODULE, DLG_LOG_LEVEL)
+	#define DLG__ASSERT_FLOOR DLG_MODULE_LEVEL(DLG_MODULE, DLG_ASSERT_LEVEL)
+#else
+	#define DLG__LOG_FLOOR DLG_LOG_LEVEL
+	#define DLG__ASSERT_FLOOR DLG_ASSERT_LEVEL
+#endif
+
+// Whether log calls check the runtime filter (see dlg_set_filter) before
+// formatting. The result is cached per callsite, so the check is cheap,
+// but it requires a static variable per callsite. Those are not allowed in
+// non-static inline functions (c) and constexpr functions (c++ before 23).
+// Define as 0 to disable it. It is checked where the log macros are used,
+// so it can also be defined as 0 just around such functions (see
+// DLG_FILE_CACHE). Must be 0 or 1.
+#ifndef DLG_RUNTIME_FILTER
+	#define DLG_RUNTIME_FILTER 1
+#endif
+
+// Define this macro to also count log calls and assertions filtered by
+// DLG_LOG_LEVEL or DLG_ASSERT_LEVEL in dlg_stats.filtered (calls filtered by
+// the runtime filter or thread level are always counted). Filtered calls are
+// then no longer completely eliminated but call into dlg to increment the counter.
+// #define DLG_STATS_FILTERED
+
 // the assert level of dlg_assert
 #ifndef DLG_DEFAULT_ASSERT
 	#define DLG_DEFAULT_ASSERT dlg_level_error
 #endif
 
+// Define this macro when __FILE__ is already relative to the project root,
+// e.g. when compiling with -fmacro-prefix-map=/some/path/= (the meson build
+// does this when the compiler supports it). DLG_FILE is then just __FILE__.
+// #define DLG_FILE_PREFIX_MAPPED
+
 // evaluated to the 'file' member in dlg_origin
+// Set it to __FILE_NAME__ (clang, gcc 12) to only log the name of the file.
+// By default, DLG_BASE_PATH is stripped from __FILE__: at compile time in
+// c++, at runtime in c (once per callsite, see DLG__FILE).
 #ifndef DLG_FILE
-	#define DLG_FILE dlg__strip_root_path(__FILE__, DLG_BASE_PATH)
+	#if defined(DLG_FILE_PREFIX_MAPPED)
+		#define DLG_FILE __FILE__
+	#elif defined(__cplusplus)
+		#define DLG_FILE (__FILE__ + \
+			::dlg__constant< ::dlg__strip_offset(__FILE__, DLG_BASE_PATH)>::value)
+	#else
+		#define DLG_FILE dlg__strip_root_path(__FILE__, DLG_BASE_PATH)
+		#define DLG__FILE_CACHED
+	#endif
 
 	// the base path stripped from __FILE__. If you don't override DLG_FILE set this to
 	// the project root to make 'main.c' from '/some/path/main.c'
@@ -103,12 +161,197 @@
 	#define DLG_CREATE_TAGS(...) (const char* const[]) {DLG_DEFAULT_TAGS_TERM, __VA_ARGS__, NULL}
 #endif
 
+#ifdef __cplusplus
+	// Compile-time version of dlg__strip_root_path for DLG_FILE, returns the
+	// offset of the stripped path in file. Recursive to stay c++11.
+	constexpr bool dlg__path_same(char a, char b) {
+		return a == b
+	#ifdef _MSC_VER
+			|| (a == '/' && b == '\\') || (a == '\\' && b == '/')
+	#endif
+			;
+	}
+
+	constexpr size_t dlg__skip_relative(const char* file, size_t i) {
+		return (file[i] == '.' || file[i] == '/' || file[i] == '\\') ?
+			dlg__skip_relative(file, i + 1) : i;
+	}
+
+	constexpr size_t dlg__skip_base(const char* file, const char* base, size_t i) {
+		return (base[i] != '\0' && dlg__path_same(file[i], base[i])) ?
+			dlg__skip_base(file, base, i + 1) :
+			(file[i] == '\0' || base[i] != '\0') ? 0 : i;
+	}
+
+	constexpr size_t dlg__strip_offset(const char* file, const char* base) {
+		return (file[0] == '.') ?
+			(file[dlg__skip_relative(file, 1)] == '\0' ? 0 : dlg__skip_relative(file, 1)) :
+			dlg__skip_base(file, base, 0);
+	}
+
+	// Forces compile-time evaluation.
+	template<size_t N> struct dlg__constant {
+		static constexpr size_t value = N;
+	};
+#endif
+
+// Whether the stripped path (see DLG_FILE) is cached per callsite in c.
+// This needs a static variable per callsite, which is not allowed in
+// non-static inline functions. It is checked where the log macros are
+// used, so it can be defined as 0 just around such functions:
+//   #pragma push_macro("DLG_FILE_CACHE")
+//   #undef DLG_FILE_CACHE
+//   #define DLG_FILE_CACHE 0
+//   inline void f(void) { dlg_info("computes DLG_FILE on every call"); }
+//   #pragma pop_macro("DLG_FILE_CACHE")
+// Must be 0 or 1.
+#ifndef DLG_FILE_CACHE
+	#if defined(__GNUC__) || defined(__clang__)
+		#define DLG_FILE_CACHE 1
+	#else
+		#define DLG_FILE_CACHE 0
+	#endif
+#endif
+
+// DLG_FILE of the callsite. In c, the stripped path is cached in a static
+// variable declared by DLG__FILE_CACHE at the start of the outlined code.
+// Racing threads store the same pointer.
+#ifdef DLG__FILE_CACHED
+	#define DLG__FILE_CACHE DLG__FILE_CACHE_(DLG_FILE_CACHE)
+	#define DLG__FILE DLG__FILE_(DLG_FILE_CACHE)
+#else
+	#define DLG__FILE_CACHE
+	#define DLG__FILE DLG_FILE
+#endif
+
+#define DLG__FILE_CACHE_(cache) DLG__FILE_CACHE__(cache)
+#define DLG__FILE_CACHE__(cache) DLG__FILE_CACHE_##cache
+#define DLG__FILE_CACHE_0
+#define DLG__FILE_CACHE_1 static const char* dlg__file_ = NULL;
+
+#define DLG__FILE_(cache) DLG__FILE__(cache)
+#define DLG__FILE__(cache) DLG__FILE_##cache
+#define DLG__FILE_0 DLG_FILE
+#define DLG__FILE_1 (__atomic_load_n(&dlg__file_, __ATOMIC_RELAXED) ? \
+	__atomic_load_n(&dlg__file_, __ATOMIC_RELAXED) : \
+	dlg__cache_file(&dlg__file_, DLG_FILE))
+
 #ifdef __GNUC__
 	#define DLG_PRINTF_ATTRIB(a, b) __attribute__ ((format (printf, a, b)))
 #else
 	#define DLG_PRINTF_ATTRIB(a, b)
 #endif
 
+#ifdef DLG_STATS_FILTERED
+	#define DLG__LEVEL_CHECK(level, min) dlg__check_level(level, min)
+#else
+	#define DLG__LEVEL_CHECK(level, min) ((level) >= (min))
+#endif
+
+// Whether the code of failed assertions and log calls (argument setup,
+// formatting and the dlg__do_log call) is moved out of the calling function,
+// keeping just the condition and a predicted-not-taken branch inline.
+// In c++ (gcc and clang) the code is put into a cold, noinline lambda,
+// otherwise the branch is only marked as unlikely and dlg__do_log as cold
+// (which makes gcc move the code into the .cold part of the function).
+#ifndef DLG_OUTLINE_COLD
+	#define DLG_OUTLINE_COLD 1
+#endif
+
+#if DLG_OUTLINE_COLD && (defined(__GNUC__) || defined(__clang__))
+	#define DLG__UNLIKELY(x) __builtin_expect(!!(x), 0)
+	#define DLG__COLD __attribute__((cold))
+#else
+	#define DLG__UNLIKELY(x) (x)
+	#define DLG__COLD
+#endif
+
+// Executes the given statements, which use dlg__func_ instead of __func__.
+#if DLG_OUTLINE_COLD && defined(__cplusplus) && (defined(__GNUC__) || defined(__clang__))
+	#define DLG__OUTLINE(...) \
+		[&](const char* dlg__func_) __attribute__((cold, noinline)) { \
+			__VA_ARGS__; \
+		}(__func__)
+#else
+	#define DLG__OUTLINE(...) do { \
+			const char* dlg__func_ = __func__; \
+			__VA_ARGS__; \
+		} while(0)
+#endif
+
+// The level override of the calling thread (see dlg_set_thread_level).
+// A thread-local variable where the library can export it, so that
+// threads without override only pay a single load.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32) && !defined(__CYGWIN__)
+	#define DLG__THREAD_LEVEL_VAR
+	#define DLG__THREAD_LEVEL() dlg__thread_level
+#else
+	#define DLG__THREAD_LEVEL() dlg_get_thread_level()
+#endif
+
+// Counts a call filtered at runtime in dlg_stats.filtered. Where possible,
+// increments a counter of the thread via a thread-local pointer, which is
+// only set up by the first call into the library.
+#ifdef DLG__THREAD_LEVEL_VAR
+	#define DLG__COUNT_FILTERED() (dlg__thread_filtered ? \
+		(void) __atomic_store_n(dlg__thread_filtered, \
+			__atomic_load_n(dlg__thread_filtered, __ATOMIC_RELAXED) + 1u, __ATOMIC_RELAXED) : \
+		dlg__count_filtered())
+#else
+	#define DLG__COUNT_FILTERED() dlg__count_filtered()
+#endif
+
+// Dispatches on DLG_RUNTIME_FILTER where the log macro is used.
+#define DLG__LOG(floor, level, tags, ...) \
+	DLG__LOG_(DLG_RUNTIME_FILTER, floor, level, tags, __VA_ARGS__)
+#define DLG__LOG_(filter, ...) DLG__LOG__(filter, __VA_ARGS__)
+#define DLG__LOG__(filter, ...) DLG__LOG_##filter(__VA_ARGS__)
+
+// Checks the level override of the thread or the cached runtime filter
+// decision for the callsite before formatting, the callsite tags are only
+// needed when the cache is outdated.
+#define DLG__LOG_1(floor, level, tags, ...) do { \
+		if(DLG__LEVEL_CHECK(level, floor)) { \
+			static unsigned dlg__filter_cache_ = 0u; \
+			int dlg__filter_min_ = DLG__THREAD_LEVEL(); \
+			if(dlg__filter_min_ < 0) { \
+				dlg__filter_min_ = dlg__filter_get(&dlg__filter_cache_); \
+			} \
+			if(DLG__UNLIKELY(dlg__filter_min_ < 0 || (int) (level) >= dlg__filter_min_)) { \
+				DLG__OUTLINE(DLG__FILE_CACHE \
+					if(dlg__filter_min_ < 0) { \
+						dlg__filter_min_ = dlg__filter_update(&dlg__filter_cache_, \
+							DLG_CREATE_TAGS tags, DLG__FILE, dlg__func_); \
+					} \
+					if((int) (level) >= dlg__filter_min_) { \
+						dlg__do_log(level, DLG_CREATE_TAGS tags, DLG__FILE, __LINE__, \
+							dlg__func_, DLG_FMT_FUNC(__VA_ARGS__), NULL); \
+					} else { \
+						dlg__count_filtered(); \
+					}); \
+			} else { \
+				DLG__COUNT_FILTERED(); \
+			} \
+		} \
+	} while(0)
+
+#define DLG__LOG_0(floor, level, tags, ...) do { \
+		if(DLG__LEVEL_CHECK(level, floor)) { \
+			if(DLG__UNLIKELY((int) (level) >= DLG__THREAD_LEVEL())) { \
+				DLG__OUTLINE(DLG__FILE_CACHE \
+					dlg__do_log(level, DLG_CREATE_TAGS tags, DLG__FILE, __LINE__, \
+						dlg__func_, DLG_FMT_FUNC(__VA_ARGS__), NULL)); \
+			} else { \
+				DLG__COUNT_FILTERED(); \
+			} \
+		} \
+	} while(0)
+
+// Logs the failed assertion out of line
+#define DLG__ASSERT_FAILED(level, tags, expr, msg) \
+	DLG__OUTLINE(DLG__FILE_CACHE dlg__do_log(level, tags, DLG__FILE, __LINE__, dlg__func_, \
+		msg, DLG_FAILED_ASSERTION_TEXT(expr)))
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -138,18 +381,48 @@ struct dlg_origin {
 // Type of the output handler, see dlg_set_handler.
 typedef void(*dlg_handler)(const struct dlg_origin* origin, const char* string, void* data);
 
+// Extended record information passed to a dlg_handler_ex.
+// Fields are only ever appended. 'size' is the size of the struct the
+// record was created with, check it before accessing fields added later
+// than the ones your handler was compiled against.
+struct dlg_origin_ex {
+	size_t size; // sizeof(struct dlg_origin_ex)
+	const struct dlg_origin* origin;
+	size_t length; // of the string, without null terminator (0 if there is none)
+	unsigned long long thread_id; // os thread id of the logging thread
+	// Unique per process and increasing in logging order: when record a was
+	// logged before record b started (e.g. in the same thread), a has the
+	// lower sequence number. Allows to merge output of multiple threads.
+	unsigned long long sequence;
+	// The format string of the call, NULL if the formatter didn't provide it.
+	// dlg__printf_format and the dlg.hpp formatters do.
+	const char* format;
+	// The context installed when the record was logged, NULL if there was
+	// none or the record was queued for a batch (see dlg_context_install).
+	const struct dlg_context* context;
+};
+
+// Type of the extended handler, see dlg_set_handler_ex.
+typedef void(*dlg_handler_ex)(const struct dlg_origin_ex* origin, const char* string, void* data);
+
 #ifndef DLG_DISABLE
 	// Tagged/Untagged logging with variable level
 	// Tags must always be in the format `("tag1", "tag2")` (including brackets)
 	// Example usages:
 	//   dlg_log(dlg_level_warning, "test 1")
 	//   dlg_logt(("tag1, "tag2"), dlg_level_debug, "test %d", 2)
-	#define dlg_log(level, ...) if(level >= DLG_LOG_LEVEL) \
-		dlg__do_log(level, DLG_CREATE_TAGS(NULL), DLG_FILE, __LINE__, __func__,  \
-		DLG_FMT_FUNC(__VA_ARGS__), NULL)
-	#define dlg_logt(level, tags, ...) if(level >= DLG_LOG_LEVEL) \
-		dlg__do_log(level, DLG_CREATE_TAGS tags, DLG_FILE, __LINE__, __func__, \
-		DLG_FMT_FUNC(__VA_ARGS__), NULL)
+	#define dlg_log(level, ...) DLG__LOG(DLG__LOG_FLOOR, level, (NULL), __VA_ARGS__)
+	#define dlg_logt(level, tags, ...) DLG__LOG(DLG__LOG_FLOOR, level, tags, __VA_ARGS__)
+
+	// Logging for the given module, using its floor (see DLG_MODULE) instead
+	// of the one of the current file.
+	// Example usages:
+	//   dlg_logm(net, dlg_level_debug, "received %d bytes", count)
+	//   dlg_logtm(net, dlg_level_info, ("tcp"), "connected")
+	#define dlg_logm(module, level, ...) DLG__LOG( \
+		DLG_MODULE_LEVEL(module, DLG_LOG_LEVEL), level, (NULL), __VA_ARGS__)
+	#define dlg_logtm(module, level, tags, ...) DLG__LOG( \
+		DLG_MODULE_LEVEL(module, DLG_LOG_LEVEL), level, tags, __VA_ARGS__)
 
 	// Dynamic level assert macros in various versions for additional arguments
 	// Example usages:
@@ -157,37 +430,62 @@ typedef void(*dlg_handler)(const struct dlg_origin* origin, const char* string,
 	//   dlg_assertlt(("tag1, "tag2"), dlg_level_trace, data != nullptr);
 	//   dlg_asserttlm(("tag1), dlg_level_warning, data != nullptr, "Data must not be null");
 	//   dlg_assertlm(dlg_level_error, data != nullptr, "Data must not be null");
-	#define dlg_assertl(level, expr) if(level >= DLG_ASSERT_LEVEL && !(expr)) \
-		dlg__do_log(level, DLG_CREATE_TAGS(NULL), DLG_FILE, __LINE__, __func__, NULL, \
-			DLG_FAILED_ASSERTION_TEXT(#expr))
-	#define dlg_assertlt(level, tags, expr) if(level >= DLG_ASSERT_LEVEL && !(expr)) \
-		dlg__do_log(level, DLG_CREATE_TAGS tags, DLG_FILE, __LINE__, __func__, NULL, \
-			DLG_FAILED_ASSERTION_TEXT(#expr))
-	#define dlg_assertlm(level, expr, ...) if(level >= DLG_ASSERT_LEVEL && !(expr)) \
-		dlg__do_log(level, DLG_CREATE_TAGS(NULL), DLG_FILE, __LINE__, __func__,  \
-			DLG_FMT_FUNC(__VA_ARGS__), DLG_FAILED_ASSERTION_TEXT(#expr))
-	#define dlg_assertltm(level, tags, expr, ...) if(level >= DLG_ASSERT_LEVEL && !(expr)) \
-		dlg__do_log(level, DLG_CREATE_TAGS tags, DLG_FILE, __LINE__,  \
-			__func__, DLG_FMT_FUNC(__VA_ARGS__), DLG_FAILED_ASSERTION_TEXT(#expr))
-
-	#define dlg__assert_or(level, tags, expr, code, msg) if(!(expr)) {\
-			if(level >= DLG_ASSERT_LEVEL) \
-				dlg__do_log(level, tags, DLG_FILE, __LINE__, __func__, msg, \
-					DLG_FAILED_ASSERTION_TEXT(#expr)); \
+	#define dlg_assertl(level, expr) \
+		if(DLG__LEVEL_CHECK(level, DLG__ASSERT_FLOOR) && DLG__UNLIKELY(!(expr))) \
+		DLG__ASSERT_FAILED(level, DLG_CREATE_TAGS(NULL), #expr, NULL)
+	#define dlg_assertlt(level, tags, expr) \
+		if(DLG__LEVEL_CHECK(level, DLG__ASSERT_FLOOR) && DLG__UNLIKELY(!(expr))) \
+		DLG__ASSERT_FAILED(level, DLG_CREATE_TAGS tags, #expr, NULL)
+	#define dlg_assertlm(level, expr, ...) \
+		if(DLG__LEVEL_CHECK(level, DLG__ASSERT_FLOOR) && DLG__UNLIKELY(!(expr))) \
+		DLG__ASSERT_FAILED(level, DLG_CREATE_TAGS(NULL), #expr, DLG_FMT_FUNC(__VA_ARGS__))
+	#define dlg_assertltm(level, tags, expr, ...) \
+		if(DLG__LEVEL_CHECK(level, DLG__ASSERT_FLOOR) && DLG__UNLIKELY(!(expr))) \
+		DLG__ASSERT_FAILED(level, DLG_CREATE_TAGS tags, #expr, DLG_FMT_FUNC(__VA_ARGS__))
+
+	#define dlg__assert_or(level, tags, expr, code, msg) if(DLG__UNLIKELY(!(expr))) {\
+			if(DLG__LEVEL_CHECK(level, DLG__ASSERT_FLOOR)) \
+				DLG__ASSERT_FAILED(level, tags, #expr, msg); \
 			code; \
 		} (void) NULL
 
 	// - Private interface: not part of the abi/api but needed in macros -
 	// Formats the given format string and arguments as printf would, uses the thread buffer.
 	DLG_API const char* dlg__printf_format(const char* format, ...) DLG_PRINTF_ATTRIB(1, 2);
+	// Remembers the format string of the current call for dlg_origin_ex.
+	DLG_API void dlg__set_format(const char* format);
 	DLG_API void dlg__do_log(enum dlg_level lvl, const char* const*, const char*, int,
-		const char*, const char*, const char*);
+		const char*, const char*, const char*) DLG__COLD;
 	DLG_API const char* dlg__strip_root_path(const char* file, const char* base);
+	DLG_API const char* dlg__cache_file(const char** cache, const char* file);
+	DLG_API bool dlg__check_level(enum dlg_level level, enum dlg_level min);
+	DLG_API void dlg__count_filtered(void); // see DLG__COUNT_FILTERED
+	// Returns the runtime filter level cached for a callsite, -1 if the cache
+	// is outdated. Inline so that filtered calls don't call into the library.
+	DLG_API extern unsigned dlg__filter_gen; // generation of the current filter
+	static inline int dlg__filter_get(unsigned* cache) {
+	#if defined(__GNUC__) || defined(__clang__)
+		unsigned state = __atomic_load_n(cache, __ATOMIC_RELAXED);
+		unsigned gen = __atomic_load_n(&dlg__filter_gen, __ATOMIC_RELAXED);
+	#else
+		unsigned state = *(volatile const unsigned*) cache;
+		unsigned gen = *(volatile const unsigned*) &dlg__filter_gen;
+	#endif
+		return ((state >> 3) != gen) ? -1 : (int) (state & 7u);
+	}
+	DLG_API int dlg__filter_update(unsigned* cache, const char* const* tags,
+		const char* file, const char* func) DLG__COLD;
+	#ifdef DLG__THREAD_LEVEL_VAR
+		DLG_API extern __thread int dlg__thread_level; // see dlg_set_thread_level
+		DLG_API extern __thread unsigned long long* dlg__thread_filtered;
+	#endif
 
 #else // DLG_DISABLE
 
 	#define dlg_log(level, ...)
 	#define dlg_logt(level, tags, ...)
+	#define dlg_logm(module, level, ...)
+	#define dlg_logtm(module, level, tags, ...)
 
 	#define dlg_assertl(level, expr) // assert without tags/message
 	#define dlg_assertlt(level, tags, expr) // assert with tags
@@ -224,6 +522,66 @@ DLG_API void dlg_default_output(const struct dlg_origin*, const char* string, vo
 // See `dlg_set_handler`.
 DLG_API dlg_handler dlg_get_handler(void** data);
 
+// Sets a handler that receives the extended record information, replacing
+// the handler set with dlg_set_handler (and vice versa; handlers set with
+// dlg_set_handler are called through an adapter that passes them the
+// plain dlg_origin). Like dlg_set_handler, this is not threadsafe.
+// The sequence number is only generated while an extended handler is set.
+DLG_API void dlg_set_handler_ex(dlg_handler_ex handler, void* data);
+
+// Returns the current extended handler or NULL if dlg_set_handler is used.
+DLG_API dlg_handler_ex dlg_get_handler_ex(void** data);
+
+// A record as passed to a batch handler.
+struct dlg_record {
+	const struct dlg_origin* origin;
+	const char* string; // may be NULL, like for dlg_handler
+	size_t length; // of string, without null terminator
+};
+
+// Type of the batch handler, see dlg_set_batch_handler.
+// Receives records of one thread in the order they were logged.
+// The records are only valid during the call.
+typedef void(*dlg_batch_handler)(const struct dlg_record* records,
+	unsigned count, void* data);
+
+// When the records queued for a batch handler are handed over.
+struct dlg_batch_limits {
+	unsigned max_records; // at most this many records per batch (at least 1)
+	size_t max_bytes; // flush once the queued strings reach this size
+	// flush once the oldest queued record is older than this,
+	// 0 for no limit. Only checked when a thread logs.
+	unsigned max_latency_ms;
+	enum dlg_level flush_level; // records of this level or above flush immediately
+};
+
+// Sets a handler that receives records in batches, replacing the handler
+// set with dlg_set_handler (and vice versa). Records are copied into a
+// per-thread queue and handed over when one of the limits is reached, when
+// the thread calls dlg_flush or when it exits. Records that are still
+// queued when the handler changes are handed to the new handler.
+// The message and the tags are copied, file, func and expr of the origin
+// are not: they must stay valid until the record was handed over, which
+// string literals (as used by the dlg macros) always do.
+// Passing NULL as limits uses the defaults: 64 records, 64KB,
+// 100ms, dlg_level_error. Like dlg_set_handler, not threadsafe.
+DLG_API void dlg_set_batch_handler(dlg_batch_handler handler, void* data,
+	const struct dlg_batch_limits* limits);
+
+// Returns the current batch handler or NULL if dlg_set_handler is used.
+DLG_API dlg_batch_handler dlg_get_batch_handler(void** data);
+
+// Hands the records queued by the calling thread to the handler.
+// Call this in every logging thread before the stream of the batch handler
+// is closed. Has no effect if no batch handler is set.
+DLG_API void dlg_flush(void);
+
+// Batch version of dlg_default_output. Renders all records into one buffer
+// and writes it with a single fwrite, then flushes the stream.
+// data is the FILE* to write to, stdout if NULL.
+DLG_API void dlg_default_batch_output(const struct dlg_record* records,
+	unsigned count, void* data);
+
 // Adds the given tag associated with the given function to the thread specific list.
 // If func is not NULL the tag will only applied to calls from the same function.
 // Remove the tag again calling dlg_remove_tag (with exactly the same pointers!).
@@ -237,12 +595,241 @@ DLG_API void dlg_add_tag(const char* tag, const char* func);
 // undefined which. Returns whether a tag was found (and removed).
 DLG_API bool dlg_remove_tag(const char* tag, const char* func);
 
+// Explicit log context, e.g. of a request. Unlike the tags of dlg_add_tag it
+// is not bound to a thread: it is owned by the caller and installed as the
+// current context of whatever thread is running the work (one pointer swap),
+// so it can follow tasks of thread pools or coroutines across threads.
+// Its tags (and the ones of its parents) are added to every record logged
+// while it is installed, after the ones from dlg_add_tag. Neither the
+// context nor the strings are copied, they must stay valid while installed.
+struct dlg_context {
+	const struct dlg_context* parent; // may be NULL
+	const char* const* tags; // null-terminated, may be NULL
+	// null-terminated list of key, value pairs, may be NULL.
+	// Available to handlers via dlg_origin_ex, added to json output.
+	const char* const* fields;
+};
+
+// Installs the given context (may be NULL) as current context of the calling
+// thread and returns the previously installed one, so the caller can restore it.
+DLG_API const struct dlg_context* dlg_context_install(const struct dlg_context*);
+
+// Returns the context installed in the calling thread, NULL if there is none.
+DLG_API const struct dlg_context* dlg_context_current(void);
+
+// Sets the name of the calling thread as used by the %n output conversion
+// (dlg_output_thread_name). Only changes what dlg outputs, not the name
+// known to the os. Names longer than 31 bytes are cut off.
+// By default the os name is used (queried once per thread, only
+// supported on linux) or the thread id if there is none.
+DLG_API void dlg_set_thread_name(const char* name);
+
+// Returns the name of the calling thread, see dlg_set_thread_name.
+// Valid until the thread exits or changes its name.
+DLG_API const char* dlg_get_thread_name(void);
+
+// The thread a record was logged in, for handlers that hand records to
+// other threads (e.g. a collector) before rendering them.
+struct dlg_record_thread {
+	unsigned long long id; // os thread id, see dlg_origin_ex
+	const char* name; // see dlg_get_thread_name
+	const struct dlg_context* context; // installed while logging, may be NULL
+};
+
+// Makes the output functions called in the calling thread render the
+// given record thread (for %i, %n and the json fields) instead of the
+// calling thread, until called with NULL. Handlers called by dlg itself
+// always run in the logging thread, so this is only needed for records
+// rendered elsewhere. Not copied, must stay valid while set.
+DLG_API void dlg_set_record_thread(const struct dlg_record_thread*);
+
+// Fills in the thread of the record currently handled by the calling
+// thread: the one set with dlg_set_record_thread if any, the calling
+// thread otherwise. Call it in the handler to capture the logging thread.
+// The name is valid until that thread exits or changes its name.
+DLG_API void dlg_get_record_thread(struct dlg_record_thread*);
+
 // Returns the thread-specific buffer and its size for dlg.
 // The buffer should only be used by formatting functions.
 // The buffer can be reallocated and the size changed, just make sure
 // to update both values correctly.
 DLG_API char** dlg_thread_buffer(size_t** size);
 
+// Written at the end of messages cut off at the thread buffer cap.
+#define DLG_TRUNCATED_MARKER "...[truncated]"
+
+// Limits for the thread buffers used for formatting and for rendering
+// records in the output functions, see dlg_set_buffer_limits.
+struct dlg_buffer_limits {
+	// Maximum size of the formatting buffer of a thread, 0 for no limit.
+	// Longer messages are cut off and end with DLG_TRUNCATED_MARKER.
+	// Values smaller than 64 are raised to 64.
+	size_t max_size;
+	// High-water mark. Buffers that have grown beyond it are shrunk back to it
+	// after 'shrink_after' consecutive records that needed less space.
+	size_t shrink_size;
+	unsigned shrink_after; // 0 disables shrinking
+};
+
+// Sets the thread buffer limits, they apply to all threads. By default there
+// is no cap and buffers larger than 16KB shrink back after 128 records.
+DLG_API void dlg_set_buffer_limits(const struct dlg_buffer_limits* limits);
+DLG_API void dlg_get_buffer_limits(struct dlg_buffer_limits* limits);
+
+// Grows the thread buffer (see dlg_thread_buffer) to at least the given size,
+// or as far as the cap allows. Returns false if it could not grow at all.
+// Formatting functions should use this instead of reallocating the buffer
+// themselves and call dlg_thread_buffer_truncate if it wasn't large enough.
+DLG_API bool dlg_thread_buffer_grow(size_t size);
+
+// Writes DLG_TRUNCATED_MARKER (null-terminated) to the end of the
+// thread buffer and counts the truncation.
+DLG_API void dlg_thread_buffer_truncate(void);
+
+// Type of a dlg_arg, determines the member of dlg_arg.value that is used.
+enum dlg_arg_type {
+	dlg_arg_int, // i
+	dlg_arg_uint, // u
+	dlg_arg_double, // d, printed like %g
+	dlg_arg_char, // c
+	dlg_arg_bool, // b, printed as 1 or 0
+	dlg_arg_string, // str, does not have to be null-terminated
+	dlg_arg_pointer, // ptr
+	dlg_arg_custom, // custom, printed by calling custom.print
+};
+
+// Output of dlg_format_args, see dlg_arg_sink_append.
+struct dlg_arg_sink;
+
+// Type-erased formatting argument, see dlg_format_args.
+struct dlg_arg {
+	enum dlg_arg_type type;
+	union {
+		long long i;
+		unsigned long long u;
+		double d;
+		char c;
+		bool b;
+		const void* ptr;
+		struct {
+			const char* data;
+			size_t size;
+		} str;
+		struct {
+			const void* obj;
+			void (*print)(const void* obj, struct dlg_arg_sink* sink);
+		} custom;
+	} value;
+};
+
+// Formats the arguments into the thread buffer (see dlg_thread_buffer) and
+// returns it. Every occurrence of replace in format is replaced by the next
+// argument, like dlg::gformat does (a replace string wrapped in backslashes
+// is printed without them instead). Other than dlg::gformat, this never
+// fails: placeholders without argument are printed as they are and
+// superfluous arguments are ignored. replace must not be empty.
+// Used by dlg/lite.hpp, which does the conversion to dlg_arg.
+DLG_API const char* dlg_format_args(const char* replace, const char* format,
+	const struct dlg_arg* args, unsigned count);
+
+// Appends the given string to the output of dlg_format_args.
+// To be used by the print functions of custom arguments.
+DLG_API void dlg_arg_sink_append(struct dlg_arg_sink* sink, const char* str, size_t size);
+
+// Snapshot of the internal dlg counters, see dlg_get_stats.
+// The counters are kept per thread and summed up (including the
+// counters of exited threads) when a snapshot is taken.
+struct dlg_stats {
+	unsigned long long records[6]; // records passed to the handler, per level
+	unsigned long long filtered; // calls filtered at runtime, see DLG_STATS_FILTERED
+	unsigned long long bytes_formatted; // bytes formatted by dlg__printf_format
+	unsigned long long bytes_output; // bytes written by the dlg stream output functions
+	unsigned long long buffer_reallocs; // thread buffer reallocations when formatting
+	unsigned long long handler_ns; // time spent in the handler, see dlg_set_stats_timing
+	unsigned long long lock_ns; // time the stream lock was held by dlg_generic_output_stream
+	unsigned long long threads; // number of threads that used dlg
+	unsigned long long truncated; // messages cut off at the thread buffer cap
+	unsigned long long buffer_bytes; // memory currently held by the buffers of all threads
+	unsigned long long buffer_bytes_max; // largest amount held by a single thread
+};
+
+// Returns a snapshot of the current counters. Threadsafe.
+DLG_API void dlg_get_stats(struct dlg_stats* stats);
+
+// Enables or disables measuring the time spent in the handler and the
+// time the stream lock is held. Disabled by default since it costs
+// additional clock reads per record.
+DLG_API void dlg_set_stats_timing(bool enable);
+
+// Writes the current counters in the prometheus text exposition format.
+DLG_API void dlg_write_stats(FILE* stream);
+
+// Starts a background thread that periodically (every interval_ms
+// milliseconds) writes the counters in the prometheus format to the given
+// file (writing a temporary file first and then renaming it, e.g. for the
+// textfile collector of the node exporter). Only one dump can be active,
+// calling it again replaces the previous one. Pass NULL as path to stop it.
+// Returns false on error or if not supported (currently unix only).
+DLG_API bool dlg_dump_stats(const char* path, unsigned interval_ms);
+
+// Enables or disables the per-callsite profiler. While enabled, every
+// record passed to the handler is counted per callsite (file, line, func)
+// together with the message size, the time spent formatting it (only
+// measured for dlg__printf_format, i.e. the default c formatter) and the
+// time spent in the handler. The tables are kept per thread.
+DLG_API void dlg_set_profiling(bool enable);
+
+// Writes the profiled callsites, sorted by total cost (format and handler
+// time), then by hits. Only the first 'top' entries are written, pass 0
+// to write all of them. Uses stderr if stream is NULL. Threadsafe.
+DLG_API void dlg_profile_report(FILE* stream, unsigned top);
+
+// Calls dlg_profile_report with the given parameters when the process exits.
+DLG_API void dlg_profile_report_at_exit(FILE* stream, unsigned top);
+
+// Sets the runtime filter. Log calls are checked against it before their
+// message is formatted. The filter is a list of comma (or newline) separated
+// rules '<selector> >= <level>', the first rule matching a callsite decides
+// its minimum level. Selectors are glob patterns ('*', '?') matched against
+// the tags of the callsite (optionally with a 'tag:' prefix; DLG_DEFAULT_TAGS and
+// the tags of the call, not the ones from dlg_add_tag) or, with a 'file:' or 'func:' prefix,
+// against its file or function. '*' matches all callsites, 'off' as level
+// disables the matched calls. Calls not matched by any rule are not filtered.
+// '#' starts a comment that lasts until the end of the line. Example:
+//   net.*>=debug, file:src/db/*>=trace, func:render*>=off, *>=warn
+// The decision is cached per callsite until the filter changes.
+// The initial filter is read from the DLG_FILTER environment variable or,
+// if that is not set, loaded and watched from the file given in DLG_FILTER_FILE.
+// Returns false (keeping the current filter) if the expression is invalid.
+// Passing NULL or an empty string removes the filter. Threadsafe.
+// Assertions are not affected by the filter.
+DLG_API bool dlg_set_filter(const char* expr);
+
+// Reads the filter from the given file, see dlg_set_filter.
+DLG_API bool dlg_load_filter(const char* path);
+
+// Loads the filter from the given file and reloads it on every change,
+// watched by a background thread (using inotify, linux only; elsewhere the
+// filter is just loaded once). Only one file can be watched,
+// pass NULL to stop watching. Returns whether the file could be loaded.
+DLG_API bool dlg_watch_filter(const char* path);
+
+// Returns the filter generation, incremented with every filter change.
+DLG_API unsigned dlg_filter_generation(void);
+
+// Overrides the runtime filter for log calls of the calling thread: calls
+// with at least the given level are logged, all others are not. Allows to
+// e.g. raise the verbosity while one request is handled while all other
+// threads stay at the filter level. The compile-time floors (DLG_LOG_LEVEL,
+// DLG_MODULE) still apply. dlg_level_fatal + 1 disables all calls of the
+// thread, -1 removes the override. Returns the previous override (-1 if
+// there was none). Without override, log calls only load the thread-local
+// value before checking the runtime filter. See also dlg::ScopedLevel.
+DLG_API int dlg_set_thread_level(int level);
+
+// Returns the level override of the calling thread, -1 if there is none.
+DLG_API int dlg_get_thread_level(void);
+
 // Untagged leveled logging
 #define dlg_trace(...) dlg_log(dlg_level_trace, __VA_ARGS__)
 #define dlg_debug(...) dlg_log(dlg_level_debug, __VA_ARGS__)
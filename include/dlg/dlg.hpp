@@ -43,6 +43,9 @@
 #include <string>
 #include <sstream>
 #include <type_traits>
+#include <utility>
+#include <vector>
+#include <initializer_list>
 
 // Define this macro as 1 to disable all dlg_check* blocks.
 // Note that checking is defined separately from DLG_DISABLE.
@@ -115,6 +118,189 @@ protected:
 		::dlg::TagsGuard _dlggtg_(_dlgtags_.begin(), nullptr)
 #endif
 
+// Overrides the level of the calling thread (see dlg_set_thread_level) on
+// its construction and restores the previous override on its destruction.
+// Instead of explicitly constructing an object, use the dlg_scoped_level macro.
+class ScopedLevel {
+public:
+	explicit ScopedLevel(int level) : prev_(dlg_set_thread_level(level)) {}
+	~ScopedLevel() { dlg_set_thread_level(prev_); }
+
+	ScopedLevel(const ScopedLevel&) = delete;
+	ScopedLevel& operator=(const ScopedLevel&) = delete;
+
+protected:
+	int prev_;
+};
+
+#ifdef DLG_DISABLE
+	// Constructs a dlg::ScopedLevel in the current scope, i.e. log calls
+	// of the current thread use the given level until the scope is left.
+	// ```dlg_scoped_level(dlg_level_trace)```
+	#define dlg_scoped_level(level)
+#else
+	#define dlg_scoped_level(level) ::dlg::ScopedLevel _dlgsl_(level)
+#endif
+
+// Owning dlg_context, e.g. holding the tags and fields of a request.
+// The strings are copied into the object and the dlg_context it derives
+// from refers to them, it stays valid when the object is moved (e.g. into
+// a coroutine frame or task). Must not be changed while it is installed.
+class Context : public dlg_context {
+public:
+	using Field = std::pair<std::string, std::string>;
+
+	Context(std::initializer_list<std::string> tags = {},
+			std::initializer_list<Field> fields = {},
+			const dlg_context* parent = nullptr) : dlg_context() {
+		this->parent = parent;
+		tags_.assign(tags.begin(), tags.end());
+		for(auto& field : fields) {
+			fields_.push_back(field.first);
+			fields_.push_back(field.second);
+		}
+		update();
+	}
+
+	Context(const Context& other) : dlg_context(other),
+		tags_(other.tags_), fields_(other.fields_) { update(); }
+	Context(Context&& other) : dlg_context(other),
+		tags_(std::move(other.tags_)), fields_(std::move(other.fields_)) {
+		update();
+		other.update();
+	}
+
+	Context& operator=(Context other) {
+		parent = other.parent;
+		std::swap(tags_, other.tags_);
+		std::swap(fields_, other.fields_);
+		update();
+		return *this;
+	}
+
+	Context& add_tag(std::string tag) {
+		tags_.push_back(std::move(tag));
+		update();
+		return *this;
+	}
+
+	Context& add_field(std::string key, std::string value) {
+		fields_.push_back(std::move(key));
+		fields_.push_back(std::move(value));
+		update();
+		return *this;
+	}
+
+protected:
+	// strings with small buffer optimization move their chars, so
+	// the pointers have to be updated whenever the strings move
+	void update() {
+		tag_ptrs_.clear();
+		for(auto& tag : tags_) {
+			tag_ptrs_.push_back(tag.c_str());
+		}
+		tag_ptrs_.push_back(nullptr);
+
+		field_ptrs_.clear();
+		for(auto& field : fields_) {
+			field_ptrs_.push_back(field.c_str());
+		}
+		field_ptrs_.push_back(nullptr);
+
+		tags = tag_ptrs_.data();
+		fields = field_ptrs_.data();
+	}
+
+	std::vector<std::string> tags_;
+	std::vector<std::string> fields_; // key, value, key, ...
+	std::vector<const char*> tag_ptrs_;
+	std::vector<const char*> field_ptrs_;
+};
+
+// Installs a dlg_context on its construction and restores the previous one
+// on its destruction, see dlg_context_install.
+// In a coroutine, the context must not stay installed while it is suspended
+// since the thread runs other work in the meantime and the coroutine may
+// be resumed on another one. Wrap its awaitables with the await function
+// (or call suspend and resume manually) to uninstall the context when
+// suspending and to install it in the resuming thread:
+// ```
+// dlg::ContextGuard guard(request.context);
+// auto data = co_await guard.await(socket.read());
+// ```
+class ContextGuard {
+public:
+	explicit ContextGuard(const dlg_context& context) :
+		context_(&context), prev_(dlg_context_install(&context)) {}
+
+	~ContextGuard() {
+		if(installed_) {
+			dlg_context_install(prev_);
+		}
+	}
+
+	ContextGuard(const ContextGuard&) = delete;
+	ContextGuard& operator=(const ContextGuard&) = delete;
+
+	// Restores the context that was installed before in the calling thread.
+	void suspend() {
+		if(installed_) {
+			dlg_context_install(prev_);
+			installed_ = false;
+		}
+	}
+
+	// Installs the context again in the calling thread (may be another one).
+	void resume() {
+		if(!installed_) {
+			prev_ = dlg_context_install(context_);
+			installed_ = true;
+		}
+	}
+
+#if __cplusplus >= 201402L
+	template<typename Awaiter> class Await;
+
+	// Wraps the given awaiter (an object with await_ready, await_suspend and
+	// await_resume functions), uninstalling the context while suspended.
+	template<typename Awaiter>
+	Await<Awaiter> await(Awaiter&& awaiter) {
+		return {std::forward<Awaiter>(awaiter), *this};
+	}
+#endif
+
+protected:
+	const dlg_context* context_;
+	const dlg_context* prev_;
+	bool installed_ {true};
+};
+
+#if __cplusplus >= 201402L
+template<typename Awaiter>
+class ContextGuard::Await {
+public:
+	Awaiter awaiter;
+	ContextGuard& guard;
+
+	bool await_ready() {
+		return awaiter.await_ready();
+	}
+
+	template<typename Handle>
+	decltype(auto) await_suspend(Handle handle) {
+		// the coroutine may already run in another thread when
+		// the wrapped await_suspend returns
+		guard.suspend();
+		return awaiter.await_suspend(handle);
+	}
+
+	decltype(auto) await_resume() {
+		guard.resume();
+		return awaiter.await_resume();
+	}
+};
+#endif
+
 // TODO: move this to the c api? together with (a scoped version of) dlg_tags?
 #if DLG_DISABLE_CHECK
 	// Executes the given block only if dlg checking is enabled
@@ -128,6 +314,40 @@ protected:
 	#define dlg_checkt(tags, code) do { dlg_tags(tags); code } while(0)
 #endif
 
+/// Compile-time level floor of a module given as type, e.g. for code that is
+/// generic over the module it logs for. Uses the static 'level' member of the
+/// module type if it has one (see dlg_declare_module), DLG_LOG_LEVEL otherwise.
+/// Can also be specialized directly.
+template<typename Module, typename = void>
+struct module_level : std::integral_constant<dlg_level, DLG_LOG_LEVEL> {};
+
+template<typename Module>
+struct module_level<Module, decltype(void(Module::level))>
+	: std::integral_constant<dlg_level, Module::level> {};
+
+/// Returns whether calls of the given level are enabled for the given module.
+template<typename Module>
+constexpr bool module_enabled(dlg_level level) {
+	return level >= module_level<Module>::value;
+}
+
+// Declares a module type whose floor is the floor of the dlg.h module with
+// the same name (i.e. DLG_MODULE_LEVEL_<name> if set), for dlg::module_level.
+#define dlg_declare_module(name) struct name { \
+		static constexpr dlg_level level = DLG_MODULE_LEVEL(name, DLG_LOG_LEVEL); \
+	}
+
+#ifdef DLG_DISABLE
+	// Like dlg_logm/dlg_logtm from dlg.h but for a module type, see dlg::module_level.
+	#define dlg_log_module(Module, level, ...)
+	#define dlg_logt_module(Module, level, tags, ...)
+#else
+	#define dlg_log_module(Module, level, ...) DLG__LOG( \
+		::dlg::module_level<Module>::value, level, (NULL), __VA_ARGS__)
+	#define dlg_logt_module(Module, level, tags, ...) DLG__LOG( \
+		::dlg::module_level<Module>::value, level, tags, __VA_ARGS__)
+#endif
+
 /// Alternative output handler that allows to e.g. set lambdas or member functions.
 using Handler = std::function<void(const struct dlg_origin& origin, const char* str)>;
 
@@ -203,7 +423,17 @@ inline void handler_wrapper(const struct dlg_origin* origin, const char* str, vo
 	}
 }
 
+// Passes the format string on to dlg_origin_ex.
+inline void set_format(const char* format) {
+#ifndef DLG_DISABLE
+	dlg__set_format(format);
+#else
+	(void) format;
+#endif
+}
+
 // Implements std::basic_streambuf into the dlg_thread_buffer.
+// Output beyond the buffer cap (see dlg_set_buffer_limits) is cut off.
 class StreamBuffer : public std::basic_streambuf<char> {
 public:
 	StreamBuffer(char*& buf, std::size_t& size) : buf_(buf), size_(size) {
@@ -212,18 +442,20 @@ public:
 
 	~StreamBuffer() {
 		// make sure only the end has a null terminator
-		setp(std::remove(buf_, pptr(), '\0'), buf_ + size_);
-		sputc('\0');
+		auto len = std::size_t(std::remove(buf_, pptr(), '\0') - buf_);
+		if(truncated_ || (len >= size_ && !dlg_thread_buffer_grow(len + 1))) {
+			dlg_thread_buffer_truncate();
+			return;
+		}
+
+		buf_[len] = '\0';
 	}
 
 	int_type overflow(int_type ch = traits_type::eof()) override {
 		if(pptr() >= epptr()) {
 			auto off = pptr() - buf_;
-			size_ = size_ * 2 + 1;
-			buf_ = static_cast<char*>(std::realloc(buf_, size_));
-			if(!buf_) {
-				size_ = 0;
-				setp(nullptr, nullptr);
+			if(!dlg_thread_buffer_grow(size_ + 1)) {
+				truncated_ = true;
 				return traits_type::eof();
 			}
 
@@ -241,6 +473,7 @@ public:
 protected:
 	char*& buf_;
 	size_t& size_;
+	bool truncated_ {};
 };
 
 // Like std::strstr but only matches if target is not wrapped in backslashes,
@@ -262,6 +495,7 @@ inline const char* find_next(std::ostream& os, const char*& src, const char* tar
 // a new buffer on every call
 template<typename... Args>
 const char* tlformat(StringParam fmt, Args&&... args) {
+	set_format(fmt.str);
 	{
 		std::size_t* size;
 		char** dbuf = dlg_thread_buffer(&size);
@@ -348,13 +582,12 @@ struct TLBufferOutputIterator {
 
 	TLBufferOutputIterator() { buf = dlg_thread_buffer(&size); }
 	char& operator*() {
-		if (off >= *size) {
-			auto nsize = 2 * *size;
-			auto nbuf = static_cast<char*>(std::malloc(nsize));
-			std::memcpy(nbuf, *buf, *size);
-			std::free(*buf);
-			*buf = nbuf;
-			*size = nsize;
+		if(off >= *size) {
+			dlg_thread_buffer_grow(off + 1);
+			if(off >= *size) { // cut off at the cap, see stdtlformat
+				static thread_local char sink;
+				return sink;
+			}
 		}
 
 		return (*buf)[off];
@@ -376,14 +609,22 @@ struct TLBufferOutputIterator {
 template<typename Arg, typename... Args>
 const char* stdtlformat(std::format_string<Arg, Args...> fmt,
 		Arg&& first, Args&&... args) {
+	detail::set_format(fmt.get().data());
 	auto out = std::format_to(TLBufferOutputIterator(), fmt,
 		std::forward<Arg>(first), std::forward<Args>(args)...);
-	*out = 0;
+	dlg_thread_buffer_grow(out.off + 1);
+	if(out.off < *out.size) {
+		(*out.buf)[out.off] = '\0';
+	} else {
+		dlg_thread_buffer_truncate();
+	}
+
 	return *dlg_thread_buffer(nullptr);
 }
 
 // To allow dlg_error(msg)
 inline const char* stdtlformat(StringParam p) {
+	detail::set_format(p.str);
 	return p.str;
 }
 
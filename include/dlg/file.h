@@ -0,0 +1,85 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_FILE_H_
+#define INC_DLG_FILE_H_
+
+#include <dlg/dlg.h>
+
+// File sink with a durability policy per level. Not available on windows.
+//
+// Records are either buffered in the sink (lazy), written to the os
+// before the call returns (they survive a crash of the process) or
+// additionally synced to stable storage with fdatasync (they survive a
+// crash of the os or a power loss). Writing or syncing a record also
+// writes the lazy records buffered before it, the file keeps the order.
+// Syncs use group commit: a thread waiting for its record to become
+// durable while another thread syncs does not issue its own fdatasync.
+// Once the running sync is done, one of the waiting threads (the leader)
+// syncs once on behalf of everything written meanwhile and wakes the
+// others. The number of syncs is bounded by the sync latency instead of
+// growing with the number of records, so the throughput of durable
+// records grows with the number of threads logging them.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum dlg_durability {
+	dlg_durability_lazy, // buffered, written with the next non-lazy record or when full
+	dlg_durability_write, // written to the os before returning
+	dlg_durability_sync, // on stable storage before returning
+};
+
+// Durability per level, indexed by enum dlg_level.
+struct dlg_file_policy {
+	enum dlg_durability levels[6];
+};
+
+enum dlg_file_flags {
+	dlg_file_json = 1, // dlg_file_output writes json lines
+};
+
+struct dlg_file;
+
+// Opens (appending to, creating if needed) the file at the given path.
+// Without policy (NULL), trace to info records are lazy, warnings are
+// written and error and fatal records synced. Lazy records are buffered
+// up to buffer_size bytes (64KB if 0). flags is a combination of
+// dlg_file_flags. Returns NULL on error.
+DLG_API struct dlg_file* dlg_file_create(const char* path,
+	const struct dlg_file_policy* policy, size_t buffer_size, unsigned flags);
+
+// Writes and syncs the buffered records and closes the file.
+DLG_API void dlg_file_destroy(struct dlg_file*);
+
+// Writes the data as a single record with the given durability.
+// Returns false if writing (or syncing) it failed. Threadsafe.
+DLG_API bool dlg_file_write(struct dlg_file*, const char* data, size_t size,
+	enum dlg_durability);
+
+// Writes the buffered records and waits until everything written so far
+// is on stable storage, sharing the sync with concurrent callers.
+// Returns false on error. Threadsafe.
+DLG_API bool dlg_file_sync(struct dlg_file*);
+
+// Output handler that renders the record like dlg_default_output
+// (without style) or, with dlg_file_json, as json line and writes it
+// with the durability of its level.
+// Pass the struct dlg_file* as data to dlg_set_handler. Threadsafe.
+DLG_API void dlg_file_output(const struct dlg_origin* origin, const char* string,
+	void* file);
+
+// Issued fdatasync calls. Compare with the number of synced records to
+// see how many were shared.
+DLG_API unsigned long long dlg_file_syncs(struct dlg_file*);
+
+// Failed (or short) writes and syncs.
+DLG_API unsigned long long dlg_file_errors(struct dlg_file*);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
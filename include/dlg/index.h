@@ -0,0 +1,107 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_INDEX_H_
+#define INC_DLG_INDEX_H_
+
+#include <dlg/dlg.h>
+#include <stdint.h>
+
+// Sidecar index for json lines log files (see dlg_generic_output_json_buf),
+// allowing queries by time, level and tag to skip most of a large file.
+// The index of "app.log" is "app.log.idx". It consists of a header followed
+// by one entry per block of consecutive records (about block_size bytes),
+// holding the time range of the block and bitmaps of the levels and tags
+// in it. Both are appended while the log is written, so parts of the log
+// may not be covered by the index (e.g. after a crash); queries have to
+// scan those completely. Values are stored in native byte order.
+// See the dlg-query tool for building indexes of existing files and
+// querying them, and dlg_uring_index for writing an index with the log.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DLG_INDEX_MAGIC 0x49474c44u // "DLGI"
+#define DLG_INDEX_VERSION 1u
+
+// Bit in dlg_index_block.levels set when the block contains a record that
+// could not be parsed. Such blocks must not be skipped by queries.
+#define DLG_INDEX_UNKNOWN (1u << 31)
+
+// Time of records without (parsable) time.
+#define DLG_INDEX_NO_TIME INT64_MIN
+
+struct dlg_index_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t block_size; // target size, blocks may be larger or smaller
+	uint32_t reserved;
+};
+
+struct dlg_index_block {
+	uint64_t offset; // of the first record in the log file
+	uint64_t size; // in bytes, ends with the last record
+	int64_t time_min; // microseconds since the epoch (utc)
+	int64_t time_max;
+	uint64_t tags; // dlg_index_tag_bit of every tag set
+	uint32_t records;
+	uint32_t levels; // (1u << level) of every level set, see also DLG_INDEX_UNKNOWN
+};
+
+// A parsed json lines record.
+struct dlg_index_record {
+	int64_t time; // microseconds since the epoch (utc)
+	enum dlg_level level;
+	const char* tags; // escaped content of the tags array, without brackets
+	size_t tags_size;
+};
+
+struct dlg_index;
+
+// Opens the index for the log file at the given path, creating it if
+// needed. New blocks are appended unless truncate is true (then the
+// index is recreated) or the existing index is not valid.
+// block_size is 64KB if 0. Returns NULL on error.
+DLG_API struct dlg_index* dlg_index_create(const char* log_path, unsigned block_size,
+	bool truncate);
+
+// Writes the last (partial) block and closes the index.
+DLG_API void dlg_index_destroy(struct dlg_index*);
+
+// Adds a record of size bytes starting at the given offset in the log file.
+// Records have to be added in file order; gaps start a new block.
+// record may be NULL if it could not be parsed.
+// Not threadsafe, the sink writing the log has to synchronize it.
+DLG_API void dlg_index_add(struct dlg_index*, unsigned long long offset, size_t size,
+	const struct dlg_index_record* record);
+
+// Parses the line (json lines record) and adds it.
+// Returns false if it could not be parsed (it is added anyways).
+DLG_API bool dlg_index_add_json(struct dlg_index*, unsigned long long offset,
+	const char* line, size_t size);
+
+// Parses the time, level and tags of a record as written by
+// dlg_generic_output_json_buf. Returns false on error.
+DLG_API bool dlg_index_parse(const char* line, size_t size,
+	struct dlg_index_record* record);
+
+// Parses an iso 8601 utc time as used by the json output
+// ("2026-10-18T10:00:00.000000Z"). Trailing parts may be omitted, e.g.
+// "2026-10-18T10:00" is the start of that minute. Returns false on error.
+DLG_API bool dlg_index_parse_time(const char* str, size_t size, int64_t* time);
+
+// Returns whether the record has the given tag. Tags are compared (and
+// hashed by dlg_index_tag_bit) as they appear in the log, i.e. escaped,
+// see dlg_json_escape_buf.
+DLG_API bool dlg_index_has_tag(const struct dlg_index_record*, const char* tag);
+
+// Returns the bit used for the given (escaped) tag in dlg_index_block.tags.
+DLG_API uint64_t dlg_index_tag_bit(const char* tag, size_t size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
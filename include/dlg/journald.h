@@ -0,0 +1,51 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_JOURNALD_H_
+#define INC_DLG_JOURNALD_H_
+
+#include <dlg/dlg.h>
+
+// Output handler speaking the native journald protocol.
+// Only available on linux.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The socket journald listens on by default.
+#define DLG_JOURNALD_SOCKET "/run/systemd/journal/socket"
+
+struct dlg_journald;
+
+// Creates a journald sink sending to the unix datagram socket at the given
+// path (or DLG_JOURNALD_SOCKET if path is NULL). If identifier is not
+// NULL, it is sent as SYSLOG_IDENTIFIER with every record.
+// Returns NULL if the socket could not be created. Does not fail
+// if there is no socket at the given path (yet), sending will then fail
+// silently.
+DLG_API struct dlg_journald* dlg_journald_create(const char* path,
+	const char* identifier);
+DLG_API void dlg_journald_destroy(struct dlg_journald*);
+
+// Output handler that sends the record to journald. Pass the struct
+// dlg_journald* as data to dlg_set_handler. Threadsafe.
+// The record is mapped to the following fields:
+// - MESSAGE: the message (or the assertion text if there is none)
+// - PRIORITY: the syslog priority of the level (trace and debug map to debug)
+// - CODE_FILE, CODE_LINE, CODE_FUNC: taken from the origin
+// - DLG_LEVEL: the dlg level name
+// - DLG_EXPR: the failed assertion expression (only for assertions)
+// - DLG_TAG: once for every tag (journald allows repeated fields)
+// The record is sent with one sendmsg call, referencing the strings directly.
+// Records too large for a datagram are written to a sealed memfd
+// that is passed to journald instead.
+DLG_API void dlg_journald_output(const struct dlg_origin* origin,
+	const char* string, void* journald);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
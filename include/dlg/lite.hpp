@@ -0,0 +1,183 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_LITE_HPP_
+#define INC_DLG_LITE_HPP_
+
+// Lightweight alternative to dlg.hpp for translation units that only log.
+// Uses the same "{}" format syntax for the dlg macros but does not include
+// any heavy standard headers: the arguments are converted to dlg_arg and
+// formatted out-of-line by dlg_format_args. Integers (and unscoped enums),
+// floating point values, bool, characters, strings (anything with char data()
+// and size(), e.g. std::string and std::string_view) and pointers are
+// supported out of the box. Other types are printed using operator<< with an
+// std::ostringstream, so translation units logging them have to include <sstream>.
+// The format string must be a const char*. Unlike dlg::format this never
+// throws for a wrong number of arguments, see dlg_format_args.
+// Must be included before dlg.h, like dlg.hpp. Don't include both.
+#ifndef DLG_FMT_FUNC
+	#define DLG_FMT_FUNC ::dlg::lite::format
+#elif defined(INC_DLG_DLG_H_)
+	#warning "dlg.h was included before dlg/lite.hpp, not overriding DLG_FMT_FUNC"
+#endif
+
+#include <dlg/dlg.h>
+#include <iosfwd>
+#include <cstring>
+#include <type_traits>
+
+// See dlg.hpp
+#ifndef DLG_FORMAT_DEFAULT_REPLACE
+	#define DLG_FORMAT_DEFAULT_REPLACE "{}"
+#endif
+
+namespace dlg {
+namespace lite {
+namespace detail {
+
+template<typename T, typename Stream = std::ostringstream>
+void print_custom(const void* obj, struct dlg_arg_sink* sink) {
+	Stream stream;
+	stream << *static_cast<const T*>(obj);
+	auto str = stream.str();
+	dlg_arg_sink_append(sink, str.data(), str.size());
+}
+
+template<typename T>
+struct is_char : std::integral_constant<bool,
+	std::is_same<T, char>::value ||
+	std::is_same<T, signed char>::value ||
+	std::is_same<T, unsigned char>::value> {};
+
+// integral_constant of the dlg_arg_type used for T
+template<typename T, typename = void>
+struct arg_type : std::integral_constant<dlg_arg_type, dlg_arg_custom> {};
+
+template<typename T>
+struct arg_type<T, typename std::enable_if<std::is_same<T, bool>::value>::type>
+	: std::integral_constant<dlg_arg_type, dlg_arg_bool> {};
+
+template<typename T>
+struct arg_type<T, typename std::enable_if<is_char<T>::value>::type>
+	: std::integral_constant<dlg_arg_type, dlg_arg_char> {};
+
+template<typename T>
+struct arg_type<T, typename std::enable_if<(std::is_integral<T>::value &&
+		!std::is_same<T, bool>::value && !is_char<T>::value) ||
+		(std::is_enum<T>::value && std::is_convertible<T, long long>::value)>::type>
+	: std::integral_constant<dlg_arg_type, std::is_signed<T>::value ||
+		std::is_enum<T>::value ? dlg_arg_int : dlg_arg_uint> {};
+
+template<typename T>
+struct arg_type<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+	: std::integral_constant<dlg_arg_type, dlg_arg_double> {};
+
+template<typename T>
+struct arg_type<T, typename std::enable_if<std::is_pointer<T>::value ||
+		std::is_same<T, decltype(nullptr)>::value>::type>
+	: std::integral_constant<dlg_arg_type, dlg_arg_pointer> {};
+
+template<typename T>
+struct arg_type<T, typename std::enable_if<std::is_convertible<
+		decltype(std::declval<const T&>().data()), const char*>::value &&
+		std::is_integral<decltype(std::declval<const T&>().size())>::value>::type>
+	: std::integral_constant<dlg_arg_type, dlg_arg_string> {};
+
+// Converts the value to a dlg_arg of the given type.
+template<dlg_arg_type Type> struct convert;
+
+template<> struct convert<dlg_arg_int> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.i = static_cast<long long>(val);
+	}
+};
+
+template<> struct convert<dlg_arg_uint> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.u = static_cast<unsigned long long>(val);
+	}
+};
+
+template<> struct convert<dlg_arg_double> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.d = static_cast<double>(val);
+	}
+};
+
+template<> struct convert<dlg_arg_char> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.c = static_cast<char>(val);
+	}
+};
+
+template<> struct convert<dlg_arg_bool> {
+	static void apply(dlg_arg& arg, bool val) {
+		arg.value.b = val;
+	}
+};
+
+template<> struct convert<dlg_arg_string> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.str.data = val.data();
+		arg.value.str.size = val.size();
+	}
+};
+
+template<> struct convert<dlg_arg_pointer> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.ptr = static_cast<const void*>(val);
+	}
+
+	// strings
+	static void apply(dlg_arg& arg, const char* val) {
+		arg.type = dlg_arg_string;
+		arg.value.str.data = val ? val : "(null)";
+		arg.value.str.size = std::strlen(arg.value.str.data);
+	}
+
+	static void apply(dlg_arg& arg, char* val) {
+		apply(arg, static_cast<const char*>(val));
+	}
+};
+
+template<> struct convert<dlg_arg_custom> {
+	template<typename T> static void apply(dlg_arg& arg, const T& val) {
+		arg.value.custom.obj = &val;
+		arg.value.custom.print = &print_custom<T>;
+	}
+};
+
+template<typename T>
+dlg_arg make_arg(const T& val) {
+	// arrays (i.e. string literals) as pointers to const
+	using Type = arg_type<typename std::decay<T>::type>;
+	using Param = typename std::conditional<std::is_array<T>::value,
+		const typename std::remove_extent<T>::type*, const T&>::type;
+
+	dlg_arg arg;
+	arg.type = Type::value;
+	convert<Type::value>::apply(arg, static_cast<Param>(val));
+	return arg;
+}
+
+} // namespace detail
+
+// Used as DLG_FMT_FUNC.
+template<typename... Args>
+const char* format(const char* fmt, const Args&... args) {
+	const dlg_arg list[] = {detail::make_arg(args)..., dlg_arg {}};
+	return dlg_format_args(DLG_FORMAT_DEFAULT_REPLACE, fmt, list, sizeof...(Args));
+}
+
+// To allow e.g. dlg_info(value)
+template<typename Arg, typename = typename std::enable_if<
+	!std::is_convertible<Arg, const char*>::value>::type>
+const char* format(const Arg& arg) {
+	return format(DLG_FORMAT_DEFAULT_REPLACE, arg);
+}
+
+} // namespace lite
+} // namespace dlg
+
+#endif // header guard
@@ -81,8 +81,10 @@ enum dlg_output_feature {
 	dlg_output_func = 8, // output function
 	dlg_output_file_line = 16, // output file:line,
 	dlg_output_newline = 32, // output a newline at the end
-	dlg_output_threadsafe = 64, // locks stream before printing
-	dlg_output_time_msecs = 128 // output micro seconds (ms on windows)
+	dlg_output_threadsafe = 64, // locks stream while writing
+	dlg_output_time_msecs = 128, // output micro seconds (ms on windows)
+	dlg_output_thread_id = 256, // output the os thread id
+	dlg_output_thread_name = 512 // output the thread name, see dlg_set_thread_name
 };
 
 // The default level-dependent output styles. The array values represent the styles
@@ -107,6 +109,8 @@ DLG_API void dlg_generic_output(dlg_generic_output_handler output, void* data,
 // %t - output the full list of tags, comma separated
 // %f - output the function name noted in the origin
 // %o - output the file:line of the origin
+// %i - output the os thread id of the logging thread
+// %n - output the name of the logging thread, see dlg_set_thread_name
 // %s - print the appropriate style escape sequence.
 // %r - print the escape sequence to reset the style.
 // %c - The content of the log/assert
@@ -121,8 +125,10 @@ DLG_API void dlg_generic_outputf(dlg_generic_output_handler output, void* data,
 // for custom output handlers (that don't want to manually format the output).
 // If stream is NULL uses stdout.
 // Automatically uses dlg_fprintf to assure correct utf-8 even on windows consoles.
-// Locks the stream (i.e. assures threadsafe access) when the associated feature
-// is passed (note that stdout/stderr might still mix from multiple threads).
+// The record is rendered into a thread-specific buffer first and then written
+// with a single fwrite. Locks the stream (i.e. assures threadsafe access) for
+// that write when the associated feature is passed (note that stdout/stderr
+// might still mix from multiple threads).
 DLG_API void dlg_generic_output_stream(FILE* stream, unsigned int features,
 	const struct dlg_origin* origin, const char* string,
 	const struct dlg_style styles[6]);
@@ -132,8 +138,9 @@ DLG_API void dlg_generic_outputf_stream(FILE* stream, const char* format_string,
 
 // Generic output function (see dlg_generic_output) that uses a buffer instead of
 // a stream. buf must at least point to *size bytes. Will set *size to the number
-// of bytes written (capped to the given size), if buf == NULL will set *size
-// to the needed size. The size parameter must not be NULL.
+// of bytes written without null terminator, output that does not fit is cut
+// off and buf is always null-terminated (if *size is not 0). If buf == NULL
+// will set *size to the needed size. The size parameter must not be NULL.
 DLG_API void dlg_generic_output_buf(char* buf, size_t* size, unsigned int features,
 	const struct dlg_origin* origin, const char* string,
 	const struct dlg_style styles[6]);
@@ -141,6 +148,34 @@ DLG_API void dlg_generic_outputf_buf(char* buf, size_t* size, const char* format
 	const struct dlg_origin* origin, const char* string,
 	const struct dlg_style styles[6]);
 
+// Outputs the record as a single json object on one line (json lines), e.g.
+// {"time":"2026-01-02T10:00:00.000000Z","level":"info","file":"main.c",
+// "line":12,"func":"main","tags":["net"],"msg":"..."}
+// followed by a newline. The time is utc with microseconds, "expr" is only
+// present for assertions and "msg" only if string is not NULL. When called
+// by a handler for a record logged with a dlg_context that has fields, they
+// are added as "fields" object (string values) after "tags".
+// All strings are escaped, invalid utf-8 is replaced with U+FFFD.
+// The record is rendered into a thread-specific buffer first, the stream
+// variant writes it with a single fwrite (NULL stream means stdout).
+// The buf variant has the same semantics as dlg_generic_output_buf and
+// always null-terminates buf (if *size is not 0).
+DLG_API void dlg_generic_output_json_buf(char* buf, size_t* size,
+	const struct dlg_origin* origin, const char* string);
+DLG_API void dlg_generic_output_json_stream(FILE* stream,
+	const struct dlg_origin* origin, const char* string);
+
+// Escapes len bytes of string as the json output does (without quotes), with
+// the buf and size semantics of dlg_generic_output_json_buf.
+DLG_API void dlg_json_escape_buf(char* buf, size_t* size,
+	const char* string, size_t len);
+
+// Output handler that writes json lines (see dlg_generic_output_json_stream)
+// to the FILE* given as data (or stdout if it is NULL) and flushes it.
+// Can be used with dlg_set_handler instead of dlg_default_output.
+DLG_API void dlg_json_output(const struct dlg_origin* origin, const char* string,
+	void* stream);
+
 // Returns if the given stream is a tty. Useful for custom output handlers
 // e.g. to determine whether to use color.
 // NOTE: Due to windows limitations currently returns false for wsl ttys.
@@ -0,0 +1,71 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_PERCPU_H_
+#define INC_DLG_PERCPU_H_
+
+#include <dlg/dlg.h>
+
+// Output handler that appends records to per-cpu buffers, drained by a
+// collector thread that hands them to another handler. Only available
+// on linux.
+//
+// Logging threads only touch the buffer (shard) of the cpu they run on,
+// found with sched_getcpu (which reads the cpu id from the rseq area of
+// the thread with glibc 2.35 or later). So no cache line is shared
+// between cores and the memory does not grow with the number of threads.
+// A shard is a ring of fixed size slots. A slot is reserved with a
+// compare-and-swap that only fails when another thread reserves on the
+// same shard concurrently, i.e. after being preempted or migrated.
+// Records are dropped when the shard is full.
+// The collector merges the records of all shards by timestamp and calls
+// the wrapped handler for each, so existing handlers can be used
+// unchanged. Ordering is per drain: a record committed late (by a
+// preempted thread) can follow newer records of other shards.
+// The logging thread (id, name and the fields of its context) is captured
+// with the record and set with dlg_set_record_thread while the handler
+// runs, so the output functions render it instead of the collector.
+// The message, tags, thread name and fields are copied into the slot,
+// file, func and expr must stay valid until the record was handed over
+// (string literals, as used by the dlg macros, always do).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dlg_percpu;
+
+// Starts the collector, which calls handler with data for every record.
+// Every cpu gets slot_count (rounded up to a power of two, 512 if 0)
+// slots of slot_size (512 if 0) bytes. Messages not fitting into a slot
+// are cut off, tags and fields that don't fit are left out. The collector
+// drains the shards every interval_ms (10 if 0) milliseconds and as soon
+// as a shard is half full or an error record was logged.
+// Returns NULL on error.
+DLG_API struct dlg_percpu* dlg_percpu_create(dlg_handler handler, void* data,
+	unsigned slot_count, unsigned slot_size, unsigned interval_ms);
+
+// Stops the collector after handing over the remaining records.
+DLG_API void dlg_percpu_destroy(struct dlg_percpu*);
+
+// The output handler, pass the struct dlg_percpu* as data to
+// dlg_set_handler. Never blocks.
+DLG_API void dlg_percpu_output(const struct dlg_origin* origin, const char* string,
+	void* percpu);
+
+// Hands all records committed so far to the handler, in the calling
+// thread. The handler is never called concurrently.
+DLG_API void dlg_percpu_flush(struct dlg_percpu*);
+
+// Number of shards, i.e. configured cpus.
+DLG_API unsigned dlg_percpu_shards(struct dlg_percpu*);
+
+// Records dropped because the shard of their cpu was full.
+DLG_API unsigned long long dlg_percpu_dropped(struct dlg_percpu*);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
@@ -0,0 +1,127 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_SHM_H_
+#define INC_DLG_SHM_H_
+
+#include <dlg/dlg.h>
+#include <stdint.h>
+
+// Output handler writing into a ring buffer in named posix shared memory,
+// so that multiple processes can log to the same destination without
+// contending on it. A single collector process (see dlg_shm_read or the
+// dlg-shm-collect tool) drains the ring in order. Only available on linux.
+//
+// The ring consists of fixed-size slots. Producers reserve a slot with a
+// compare-and-swap on the shared write position, write the record into it
+// and commit it by advancing the slot sequence number. Nothing ever blocks:
+// if the ring is full, the record is dropped. A producer that crashes (or
+// stalls) between reserving and committing a slot doesn't wedge the ring,
+// the reader skips the slot after a timeout, see dlg_shm_set_abandon_timeout.
+// The slot is not reused until the stalled producer gave it up (its record
+// is dropped then), the slot of a crashed producer stays unused.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DLG_SHM_MAGIC 0x52474c44u // "DLGR"
+#define DLG_SHM_VERSION 2u
+
+// Layout of the shared memory, shared by all processes using the ring.
+// Followed by slot_count slots of slot_size bytes each, every slot
+// starting with a struct dlg_shm_slot.
+struct dlg_shm_header {
+	uint32_t magic; // written last when the ring is created
+	uint32_t version;
+	uint32_t slot_count; // power of two
+	uint32_t slot_size; // including struct dlg_shm_slot
+	uint64_t dropped; // records dropped by producers since creation
+	uint64_t abandoned; // slots skipped by the reader
+	uint32_t waiting; // reader is waiting on 'wake' (futex)
+	uint32_t wake;
+	char pad0[24];
+	uint64_t write; // next position to reserve, own cache line
+	char pad1[56];
+	uint64_t read; // next position to read, only written by the reader
+	char pad2[56];
+};
+
+// Flags of dlg_shm_slot.seq, see there.
+#define DLG_SHM_ABANDONED (1ull << 63)
+#define DLG_SHM_RELEASED (1ull << 62)
+
+struct dlg_shm_slot {
+	// Slot at position p is free for p when seq == p,
+	// committed when seq == p + 1 and free for the next round
+	// when seq == p + slot_count.
+	// When the reader skipped it, seq == p | DLG_SHM_ABANDONED. Producers
+	// and the reader pass over it until its producer adds
+	// DLG_SHM_RELEASED, the reader then frees it the next time it
+	// reaches it.
+	uint64_t seq;
+	uint32_t pid; // of the writing process
+	uint32_t size; // record size, without null terminator
+	// followed by the record, null-terminated
+};
+
+struct dlg_shm;
+
+// Opens the ring with the given shm_open name (e.g. "/myapp-log"), creating it
+// if it does not exist yet. slot_count (rounded up to a power of two,
+// 4096 if 0) and slot_size (512 if 0; records longer than
+// slot_size - sizeof(struct dlg_shm_slot) - 1 are cut off) are only used
+// when creating it. Returns NULL on error.
+// The returned object can be used from multiple threads and by children
+// forked afterwards, their records carry their own pid.
+DLG_API struct dlg_shm* dlg_shm_open(const char* name, unsigned slot_count,
+	unsigned slot_size);
+
+// Unmaps the ring. Does not remove the shared memory object.
+DLG_API void dlg_shm_close(struct dlg_shm*);
+
+// Removes the shared memory object with the given name. Processes that
+// have it opened can continue using it. Returns false on error.
+DLG_API bool dlg_shm_unlink(const char* name);
+
+// Writes a single record. Returns false if it was dropped
+// because the ring was full.
+DLG_API bool dlg_shm_write(struct dlg_shm*, const char* record, size_t size);
+
+// Output handler that writes the record as dlg_default_output does
+// (file:line, content, newline; without style) into the ring.
+// Pass the struct dlg_shm* as data to dlg_set_handler.
+DLG_API void dlg_shm_output(const struct dlg_origin* origin, const char* string,
+	void* shm);
+
+// Records dropped by all producers since the ring was created.
+DLG_API unsigned long long dlg_shm_dropped(struct dlg_shm*);
+
+// Slots skipped by readers since the ring was created.
+DLG_API unsigned long long dlg_shm_abandoned(struct dlg_shm*);
+
+// Called for every record read, see dlg_shm_read.
+typedef void(*dlg_shm_reader)(const char* record, size_t size, unsigned pid,
+	void* data);
+
+// Reads all committed records in ring order, passing them to the given
+// callback. Stops at the first slot that is reserved but not yet
+// committed unless it stays that way longer than the abandon timeout,
+// then it is skipped. Returns the number of records read.
+// There must only be one reader per ring at a time.
+DLG_API unsigned dlg_shm_read(struct dlg_shm*, dlg_shm_reader reader, void* data);
+
+// Waits until a record is committed or the timeout expires.
+// Returns whether there may be something to read.
+DLG_API bool dlg_shm_wait(struct dlg_shm*, unsigned timeout_ms);
+
+// Sets how long the reader waits for a reserved slot to be committed
+// before skipping it (1000ms by default).
+DLG_API void dlg_shm_set_abandon_timeout(struct dlg_shm*, unsigned timeout_ms);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
@@ -0,0 +1,62 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_SYSLOG_H_
+#define INC_DLG_SYSLOG_H_
+
+#include <dlg/dlg.h>
+
+// Output handler sending RFC 5424 syslog messages over udp or
+// unix datagram sockets. Only available on linux.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The maximum size of a single syslog message. Longer ones are truncated.
+#ifndef DLG_SYSLOG_MAX_RECORD
+	#define DLG_SYSLOG_MAX_RECORD 2048
+#endif
+
+struct dlg_syslog;
+
+// Creates a syslog sink. If address starts with '/' it is interpreted as the
+// path of a unix datagram socket (e.g. "/dev/log"), otherwise as "host:port"
+// of a udp collector (use "[v6addr]:port" for ipv6 addresses).
+// app_name is used as APP-NAME in the header (may be NULL), facility
+// is the syslog facility number (e.g. 1 for user, 16 for local0).
+// Records are queued and sent in batches of the given size (64 if 0)
+// with a single sendmmsg call. Up to 4 batches are queued.
+// Returns NULL if the address could not be resolved or connected.
+DLG_API struct dlg_syslog* dlg_syslog_create(const char* address,
+	const char* app_name, unsigned facility, unsigned batch);
+
+// Flushes the remaining records and destroys the sink.
+DLG_API void dlg_syslog_destroy(struct dlg_syslog*);
+
+// Sends all queued records. Records are otherwise only sent when a full
+// batch was queued or an error/fatal record is logged, so applications
+// should call this periodically (e.g. from a timer) and on shutdown.
+// Never blocks: if the socket would block, the records stay queued.
+DLG_API void dlg_syslog_flush(struct dlg_syslog*);
+
+// Returns the number of records dropped since creation, either because the
+// queue was full or because the socket returned an error.
+DLG_API unsigned long dlg_syslog_dropped(struct dlg_syslog*);
+
+// Output handler that formats and queues the record. Pass the
+// struct dlg_syslog* as data to dlg_set_handler. Threadsafe.
+// Message format:
+// <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID - [dlg@32473 file="main.c"
+// line="12" func="main" tags="a,b"] MSG
+// The message content is the same as for the %c conversion of
+// dlg_generic_outputf, an 'expr' parameter is added for assertions.
+DLG_API void dlg_syslog_output(const struct dlg_origin* origin,
+	const char* string, void* syslog);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
@@ -0,0 +1,75 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#ifndef INC_DLG_URING_H_
+#define INC_DLG_URING_H_
+
+#include <dlg/dlg.h>
+
+// Asynchronous file sink using io_uring. Only available on linux.
+//
+// Records are copied into one of a fixed number of buffers (registered
+// with the ring). Full buffers are handed to a thread owned by the sink
+// that submits them as writes to their file offset, so they land in order
+// even when they complete out of order, optionally linked to an
+// fdatasync, and reaps the completions. When all buffers are in flight,
+// records are dropped instead of blocking the logging thread.
+// When io_uring is not available (old kernel, disabled via sysctl or
+// seccomp) the buffers are written by a small pool of writer threads.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum dlg_uring_flags {
+	dlg_uring_sync = 1, // link an fdatasync to every write
+	dlg_uring_threads = 2, // always use the writer threads instead of io_uring
+	dlg_uring_json = 4, // dlg_uring_output writes json lines
+	dlg_uring_index = 8, // maintain the index of the file, see dlg/index.h
+};
+
+struct dlg_uring;
+
+// Opens (appending to, creating if needed) the file at the given path.
+// buffer_count (8 if 0) is the maximum number of writes in flight,
+// buffer_size (64KB if 0) the size of each write. Records larger than a
+// buffer are cut off. flags is a combination of dlg_uring_flags.
+// Returns NULL on error.
+DLG_API struct dlg_uring* dlg_uring_create(const char* path, unsigned buffer_count,
+	size_t buffer_size, unsigned flags);
+
+// Submits the remaining data, waits for all writes to complete and
+// closes the file.
+DLG_API void dlg_uring_destroy(struct dlg_uring*);
+
+// Submits the partially filled buffer. Buffers are otherwise only
+// submitted when full or when an error/fatal record is logged, so call
+// this periodically (e.g. from a timer). Never blocks.
+DLG_API void dlg_uring_flush(struct dlg_uring*);
+
+// Copies the data into the current buffer. Returns false if it was
+// dropped because no buffer was free. With dlg_uring_index, the data
+// is indexed as a single json lines record. Threadsafe.
+DLG_API bool dlg_uring_write(struct dlg_uring*, const char* data, size_t size);
+
+// Output handler that renders the record like dlg_default_output
+// (without style) or, with dlg_uring_json, as json line and writes it.
+// Pass the struct dlg_uring* as data to dlg_set_handler. Threadsafe.
+DLG_API void dlg_uring_output(const struct dlg_origin* origin, const char* string,
+	void* uring);
+
+// Returns whether io_uring is used (false for the writer threads).
+DLG_API bool dlg_uring_async(struct dlg_uring*);
+
+// Records dropped because no buffer was free.
+DLG_API unsigned long long dlg_uring_dropped(struct dlg_uring*);
+
+// Failed (or short) writes and syncs.
+DLG_API unsigned long long dlg_uring_errors(struct dlg_uring*);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // header guard
@@ -4,6 +4,7 @@
 
 #define _XOPEN_SOURCE 600
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // syscall
 #define _WIN32_WINNT 0x0600
 
 // Needed on windows so that we can use sprintf without warning.
@@ -15,8 +16,23 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
+// simd helpers for json escaping, only used when enabled at compile time
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define DLG_JSON_AVX2
+	#define DLG_JSON_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define DLG_JSON_SSE2
+#endif
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+#endif
+
 const char* const dlg_reset_sequence = "\033[0m";
 const struct dlg_style dlg_default_output_styles[] = {
 	{dlg_text_style_italic, dlg_color_green, dlg_color_none},
@@ -44,18 +60,190 @@ struct dlg_tag_func_pair {
 	const char* func;
 };
 
+// Relaxed atomic access for values that have a single writer but are
+// read by other threads (e.g. the per-thread counters).
+#if defined(__GNUC__) || defined(__clang__)
+	#define atomic_load_relaxed(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+	#define atomic_store_relaxed(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#else
+	// msvc: aligned loads and stores are atomic on all supported platforms
+	#define atomic_load_relaxed(ptr) (*(volatile const uint64_t*) (ptr))
+	#define atomic_store_relaxed(ptr, val) (*(volatile uint64_t*) (ptr) = (val))
+#endif
+
+// Per-thread counters, see dlg_stats. Only written by the owning thread.
+struct dlg_counters {
+	uint64_t records[6];
+	uint64_t filtered;
+	uint64_t bytes_formatted;
+	uint64_t bytes_output;
+	uint64_t buffer_reallocs;
+	uint64_t handler_ns;
+	uint64_t lock_ns;
+	uint64_t truncated;
+};
+
+#define dlg_counters_count (sizeof(struct dlg_counters) / sizeof(uint64_t))
+
+static inline void counter_add(uint64_t* counter, uint64_t val) {
+	atomic_store_relaxed(counter, atomic_load_relaxed(counter) + val);
+}
+
+static inline unsigned atomic_load_uint(const unsigned* ptr) {
+#if defined(__GNUC__) || defined(__clang__)
+	return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+#else
+	return *(volatile const unsigned*) ptr;
+#endif
+}
+
+static inline void atomic_store_uint(unsigned* ptr, unsigned val) {
+#if defined(__GNUC__) || defined(__clang__)
+	__atomic_store_n(ptr, val, __ATOMIC_RELAXED);
+#else
+	*(volatile unsigned*) ptr = val;
+#endif
+}
+
+// Publishing pointers from the owning thread to readers.
+#if defined(__GNUC__) || defined(__clang__)
+	#define atomic_load_ptr(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+	#define atomic_store_ptr(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#else
+	// msvc: volatile accesses have acquire/release semantics
+	#define atomic_load_ptr(ptr) (*(ptr))
+	#define atomic_store_ptr(ptr, val) (*(ptr) = (val))
+#endif
+
+// Profiling data of one callsite, see dlg_set_profiling.
+// The counters are only written by the owning thread.
+struct dlg_callsite {
+	const char* file; // NULL for empty slots, written last
+	const char* func;
+	unsigned line;
+	uint64_t hits;
+	uint64_t bytes;
+	uint64_t format_ns;
+	uint64_t handler_ns;
+};
+
+// Record copied into a batch queue. Strings and tags are stored as
+// offsets into the queue's buffers until the batch is handed over.
+struct batch_entry {
+	struct dlg_origin origin;
+	size_t string; // batch_no_string for NULL
+	size_t length;
+	size_t tags;
+};
+
+#define batch_no_string ((size_t) -1)
+
+// dlg_data.format_length when the buffer wasn't (completely) written by
+// dlg__printf_format or dlg_format_args, e.g. by the dlg.hpp formatters.
+#define format_no_length ((size_t) -1)
+
+// Per-thread queue for the batch handler, see dlg_set_batch_handler.
+// The vecs are created on first use.
+struct dlg_batch {
+	struct batch_entry* entries; // vec
+	size_t* tags; // vec of lists of offsets into strings, batch_no_string terminated
+	char* strings; // vec, messages and tags
+	struct dlg_record* records; // vec, filled when handing over
+	const char** tag_lists; // vec, filled when handing over
+	uint64_t first_ns; // time the first queued record was logged
+	bool flushing;
+};
+
+// Open addressing hash table of callsites. When growing, the old
+// table is kept (linked via 'old') until the table is destroyed since
+// other threads might still read it.
+struct dlg_callsite_table {
+	struct dlg_callsite_table* old;
+	unsigned cap; // power of two
+	unsigned count;
+	struct dlg_callsite entries[];
+};
+
 struct dlg_data {
+	// list of all thread data, see dlg_get_stats
+	struct dlg_data* prev;
+	struct dlg_data* next;
+	struct dlg_counters counters;
+
 	const char** tags; // vec
 	struct dlg_tag_func_pair* pairs; // vec
+	const struct dlg_context* context; // see dlg_context_install
+	const struct dlg_context* record_context; // of the record being dispatched
+	const struct dlg_record_thread* record_thread; // see dlg_set_record_thread
+	int level; // see dlg_set_thread_level, if DLG__THREAD_LEVEL_VAR isn't used
 	char* buffer;
 	size_t buffer_size;
+
+	// separate buffer for rendering complete records in output handlers,
+	// the string passed to the handler usually lives in 'buffer'
+	char* out_buffer;
+	size_t out_buffer_size;
+
+	// bounded buffers, see dlg_set_buffer_limits
+	uint64_t buffer_bytes; // size of both buffers, read by dlg_get_stats
+	size_t out_used; // largest out_buffer usage since the last record
+	unsigned small_records; // consecutive records below the high-water mark
+
+	// cached formatted second of the last json timestamp
+	time_t json_time;
+	char json_time_buf[24];
+
+	struct dlg_batch batch;
+
+	// callsite profile, published to readers via atomic_store_ptr
+	struct dlg_callsite_table* profile;
+	uint64_t format_ns; // of the last dlg__printf_format call
+
+	uint64_t thread_id; // see dlg_origin_ex
+	char thread_name[32]; // see dlg_set_thread_name
+	bool thread_name_set;
+	const char* format; // of the current call, see dlg__set_format
+	size_t format_length; // of the string formatted into buffer, see format_length
+	unsigned long long filtered; // via dlg__thread_filtered, see DLG__COUNT_FILTERED
 };
 
 static dlg_handler g_handler = dlg_default_output;
 static void* g_data = NULL;
+static dlg_handler_ex g_handler_ex = NULL; // overrides g_handler
+static void* g_handler_ex_data = NULL;
+static uint64_t g_sequence = 0u;
+static dlg_batch_handler g_batch_handler = NULL; // overrides both
+static void* g_batch_data = NULL;
+static struct dlg_batch_limits g_batch_limits = {64, 64 * 1024, 100, dlg_level_error};
+
+// guarded by the global lock
+static struct dlg_data* g_threads = NULL;
+static struct dlg_counters g_retired; // counters of exited threads
+static uint64_t g_thread_count = 0;
+
+static uint64_t g_stats_timing = 0;
+static uint64_t g_buffer_max = 0;
+static uint64_t g_buffer_shrink = 16 * 1024;
+static uint64_t g_buffer_shrink_after = 128;
+static uint64_t g_profiling = 0;
+
+// runtime filter, see dlg_set_filter. Guarded by the global lock,
+// the generation is also read without it.
+struct dlg_filter;
+static struct dlg_filter* g_filter = NULL;
+unsigned dlg__filter_gen = 1u; // 0 is never valid for caches
+static unsigned g_filter_init = 0u;
+static struct dlg_callsite_table* g_retired_profile = NULL; // global lock
 
 static void dlg_free_data(void* data);
 static struct dlg_data* dlg_create_data(void);
+static void batch_flush(struct dlg_data* data);
+
+// Must be called whenever the size of one of the thread buffers changes.
+static inline void buffer_account(struct dlg_data* data) {
+	atomic_store_relaxed(&data->buffer_bytes,
+		(uint64_t) (data->buffer_size + data->out_buffer_size));
+}
 
 // platform-specific
 #if defined(__unix__) || defined(__unix) || defined(__linux__) || defined(__APPLE__) || defined(__MACH__)
@@ -64,22 +252,56 @@ static struct dlg_data* dlg_create_data(void);
 	#include <pthread.h>
 	#include <sys/time.h>
 
+	#ifdef __linux__
+		#include <errno.h>
+		#include <poll.h>
+		#include <sys/inotify.h>
+		#include <sys/syscall.h>
+		#include <sys/prctl.h>
+	#endif
+
 	static pthread_key_t dlg_data_key;
 
+	// The key owns the data (its destructor frees it), this caches it so
+	// that the common case needs neither pthread_once nor pthread_getspecific.
+	#if defined(__GNUC__) || defined(__clang__)
+		static __thread struct dlg_data* t_data;
+		#define set_cached_data(data) (t_data = (struct dlg_data*) (data))
+	#else
+		#define set_cached_data(data) (void) (data)
+	#endif
+
 	static void dlg_main_cleanup(void) {
 		void* data = pthread_getspecific(dlg_data_key);
 		if(data) {
 			dlg_free_data(data);
 			pthread_setspecific(dlg_data_key, NULL);
+			set_cached_data(NULL);
 		}
 	}
 
+	// Makes the data available again while it is destroyed since queued
+	// batch records are handed to the handler, which might use dlg.
+	static void dlg_thread_cleanup(void* data) {
+		pthread_setspecific(dlg_data_key, data);
+		set_cached_data(data);
+		dlg_free_data(data);
+		pthread_setspecific(dlg_data_key, NULL);
+		set_cached_data(NULL);
+	}
+
 	static void init_data_key(void) {
-		pthread_key_create(&dlg_data_key, dlg_free_data);
+		pthread_key_create(&dlg_data_key, dlg_thread_cleanup);
 		atexit(dlg_main_cleanup);
 	}
 
 	static struct dlg_data* dlg_data(void) {
+	#if defined(__GNUC__) || defined(__clang__)
+		if(t_data) {
+			return t_data;
+		}
+	#endif
+
 		static pthread_once_t key_once = PTHREAD_ONCE_INIT;
 		pthread_once(&key_once, init_data_key);
 
@@ -89,9 +311,26 @@ static struct dlg_data* dlg_create_data(void);
 			pthread_setspecific(dlg_data_key, data);
 		}
 
+		set_cached_data(data);
 		return (struct dlg_data*) data;
 	}
 
+	static pthread_mutex_t g_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	static void lock_global(void) {
+		pthread_mutex_lock(&g_mutex);
+	}
+
+	static void unlock_global(void) {
+		pthread_mutex_unlock(&g_mutex);
+	}
+
+	static uint64_t get_nsecs(void) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+	}
+
 	static void lock_file(FILE* file) {
 		flockfile(file);
 	}
@@ -104,6 +343,34 @@ static struct dlg_data* dlg_create_data(void);
 		return isatty(fileno(stream));
 	}
 
+	static uint64_t get_thread_id(void) {
+	#if defined(__linux__)
+		return (uint64_t) syscall(SYS_gettid);
+	#elif defined(__APPLE__)
+		uint64_t id = 0;
+		pthread_threadid_np(NULL, &id);
+		return id;
+	#else
+		return (uint64_t) (uintptr_t) pthread_self();
+	#endif
+	}
+
+	static void get_thread_name(char* buf, size_t size) {
+	#if defined(__linux__)
+		char name[16] = {0}; // PR_GET_NAME writes up to 16 bytes
+		if(size && !prctl(PR_GET_NAME, name, 0, 0, 0)) {
+			snprintf(buf, size, "%s", name);
+		}
+	#else
+		(void) buf;
+		(void) size;
+	#endif
+	}
+
+	static uint64_t next_sequence(void) {
+		return __atomic_fetch_add(&g_sequence, 1u, __ATOMIC_RELAXED);
+	}
+
 	static unsigned get_msecs(void) {
 		struct timeval tv;
 		gettimeofday(&tv, NULL);
@@ -126,8 +393,13 @@ static struct dlg_data* dlg_create_data(void);
 	// the max buffer size we will convert on the stack
 	#define DLG_MAX_STACK_BUF_SIZE 1024
 
+	static DWORD g_fls = 0;
+
+	// See dlg_thread_cleanup for unix
 	static void WINAPI dlg_fls_destructor(void* data) {
+		FlsSetValue(g_fls, data);
 		dlg_free_data(data);
+		FlsSetValue(g_fls, NULL);
 	}
 
 	// TODO: error handling
@@ -140,18 +412,51 @@ static struct dlg_data* dlg_create_data(void);
 
 	static struct dlg_data* dlg_data(void) {
 		static INIT_ONCE init_once = INIT_ONCE_STATIC_INIT;
-		static DWORD fls = 0;
-		void* flsp = (void*) &fls;
+		void* flsp = (void*) &g_fls;
 		InitOnceExecuteOnce(&init_once, dlg_init_fls, NULL, &flsp);
-		void* data = FlsGetValue(fls);
+		void* data = FlsGetValue(g_fls);
 		if(!data) {
 			data = dlg_create_data();
-			FlsSetValue(fls, data);
+			FlsSetValue(g_fls, data);
 		}
 
 		return (struct dlg_data*) data;
 	}
 
+	static SRWLOCK g_mutex = SRWLOCK_INIT;
+
+	static void lock_global(void) {
+		AcquireSRWLockExclusive(&g_mutex);
+	}
+
+	static void unlock_global(void) {
+		ReleaseSRWLockExclusive(&g_mutex);
+	}
+
+	static uint64_t get_nsecs(void) {
+		static LARGE_INTEGER freq;
+		LARGE_INTEGER count;
+		if(!freq.QuadPart) {
+			QueryPerformanceFrequency(&freq);
+		}
+
+		QueryPerformanceCounter(&count);
+		return (uint64_t) ((double) count.QuadPart * 1e9 / (double) freq.QuadPart);
+	}
+
+	static uint64_t get_thread_id(void) {
+		return GetCurrentThreadId();
+	}
+
+	static void get_thread_name(char* buf, size_t size) {
+		(void) buf;
+		(void) size;
+	}
+
+	static uint64_t next_sequence(void) {
+		return (uint64_t) InterlockedIncrement64((volatile LONG64*) &g_sequence) - 1u;
+	}
+
 	static void lock_file(FILE* file) {
 		_lock_file(file);
 	}
@@ -307,7 +612,9 @@ void dlg_generic_output(dlg_generic_output_handler output, void* data,
 		format += sprintf(format, "%%s");
 	}
 
-	if(features & (dlg_output_time | dlg_output_file_line | dlg_output_tags | dlg_output_func)) {
+	const unsigned int meta = dlg_output_time | dlg_output_file_line | dlg_output_tags |
+		dlg_output_func | dlg_output_thread_id | dlg_output_thread_name;
+	if(features & meta) {
 		format += sprintf(format, "[");
 	}
 
@@ -326,6 +633,24 @@ void dlg_generic_output(dlg_generic_output_handler output, void* data,
 		first_meta = false;
 	}
 
+	if(features & dlg_output_thread_id) {
+		if(!first_meta) {
+			format += sprintf(format, " ");
+		}
+
+		format += sprintf(format, "%%i");
+		first_meta = false;
+	}
+
+	if(features & dlg_output_thread_name) {
+		if(!first_meta) {
+			format += sprintf(format, " ");
+		}
+
+		format += sprintf(format, "%%n");
+		first_meta = false;
+	}
+
 	if(features & dlg_output_file_line) {
 		if(!first_meta) {
 			format += sprintf(format, " ");
@@ -353,7 +678,7 @@ void dlg_generic_output(dlg_generic_output_handler output, void* data,
 		first_meta = false;
 	}
 
-	if(features & (dlg_output_time | dlg_output_file_line | dlg_output_tags | dlg_output_func)) {
+	if(features & meta) {
 		format += sprintf(format, "] ");
 	}
 
@@ -414,6 +739,16 @@ void dlg_generic_outputf(dlg_generic_output_handler output, void* data,
 		} else if(next == 'o') {
 			output(data, "%s:%u", origin->file, origin->line);
 			++it;
+		} else if(next == 'i') {
+			struct dlg_record_thread thread;
+			dlg_get_record_thread(&thread);
+			output(data, "%llu", thread.id);
+			++it;
+		} else if(next == 'n') {
+			struct dlg_record_thread thread;
+			dlg_get_record_thread(&thread);
+			output(data, "%s", thread.name);
+			++it;
 		} else if(next == 's') {
 			char buf[12];
 			dlg_escape_sequence(styles[origin->level], buf);
@@ -447,9 +782,12 @@ void dlg_generic_outputf(dlg_generic_output_handler output, void* data,
 	}
 }
 
+// Fixed size buffer, see dlg_generic_output_buf. Output that does not
+// fit is cut off.
 struct buf {
 	char* buf;
-	size_t* size;
+	size_t size;
+	size_t written; // without null terminator, less than size
 };
 
 static void print_size(void* size, const char* format, ...) {
@@ -466,15 +804,28 @@ static void print_size(void* size, const char* format, ...) {
 
 static void print_buf(void* dbuf, const char* format, ...) {
 	struct buf* buf = (struct buf*) dbuf;
+	size_t left = buf->size - buf->written;
+	if(left <= 1) {
+		return;
+	}
+
 	va_list args;
 	va_start(args, format);
 
-	int printed = vsnprintf(buf->buf, *buf->size, format, args);
+	int printed = vsnprintf(buf->buf + buf->written, left, format, args);
 	va_end(args);
 
 	if(printed > 0) {
-		*buf->size -= printed;
-		buf->buf += printed;
+		buf->written += ((size_t) printed < left) ? (size_t) printed : left - 1;
+	}
+}
+
+static void buf_init(struct buf* mbuf, char* buf, size_t size) {
+	mbuf->buf = buf;
+	mbuf->size = size;
+	mbuf->written = 0u;
+	if(size) {
+		buf[0] = '\0';
 	}
 }
 
@@ -483,9 +834,9 @@ void dlg_generic_output_buf(char* buf, size_t* size, unsigned int features,
 		const struct dlg_style styles[6]) {
 	if(buf) {
 		struct buf mbuf;
-		mbuf.buf = buf;
-		mbuf.size = size;
+		buf_init(&mbuf, buf, *size);
 		dlg_generic_output(print_buf, &mbuf, features, origin, string, styles);
+		*size = mbuf.written;
 	} else {
 		*size = 0;
 		dlg_generic_output(print_size, size, features, origin, string, styles);
@@ -497,262 +848,2176 @@ void dlg_generic_outputf_buf(char* buf, size_t* size, const char* format_string,
 		const struct dlg_style styles[6]) {
 	if(buf) {
 		struct buf mbuf;
-		mbuf.buf = buf;
-		mbuf.size = size;
+		buf_init(&mbuf, buf, *size);
 		dlg_generic_outputf(print_buf, &mbuf, format_string, origin, string, styles);
+		*size = mbuf.written;
 	} else {
 		*size = 0;
 		dlg_generic_outputf(print_size, size, format_string, origin, string, styles);
 	}
 }
 
-static void print_stream(void* stream, const char* format, ...) {
-	va_list args;
-	va_start(args, format);
-	dlg_vfprintf((FILE*) stream, format, args);
-	va_end(args);
+// json output
+// Growable output buffer, backed by the out_buffer of the thread data.
+struct obuf {
+	char** buf;
+	size_t* cap;
+	size_t* used; // high-water mark for the shrinking policy
+	size_t size;
+};
+
+static void obuf_init(struct obuf* buf) {
+	struct dlg_data* data = dlg_data();
+	buf->buf = &data->out_buffer;
+	buf->cap = &data->out_buffer_size;
+	buf->used = &data->out_used;
+	buf->size = 0;
 }
 
-void dlg_generic_output_stream(FILE* stream, unsigned int features,
-		const struct dlg_origin* origin, const char* string,
-		const struct dlg_style styles[6]) {
-	stream = stream ? stream : stdout;
-	if(features & dlg_output_threadsafe) {
-		lock_file(stream);
+// Makes sure there is space for at least count more bytes and returns
+// the current end of the buffer.
+static char* obuf_reserve(struct obuf* buf, size_t count) {
+	if(buf->size + count > *buf->used) {
+		*buf->used = buf->size + count;
 	}
 
-	dlg_generic_output(print_stream, stream, features, origin, string, styles);
-	if(features & dlg_output_threadsafe) {
-		unlock_file(stream);
+	if(buf->size + count > *buf->cap) {
+		size_t cap = (buf->size + count) * 2;
+		char* nbuf = (char*) xrealloc(*buf->buf, cap);
+		if(!nbuf) {
+			return NULL;
+		}
+
+		*buf->buf = nbuf;
+		*buf->cap = cap;
+		buffer_account(dlg_data());
 	}
+
+	return *buf->buf + buf->size;
 }
 
-void dlg_generic_outputf_stream(FILE* stream, const char* format_string,
-		const struct dlg_origin* origin, const char* string,
-		const struct dlg_style styles[6], bool lock_stream) {
-	stream = stream ? stream : stdout;
-	if(lock_stream) {
-		lock_file(stream);
+static void obuf_append(struct obuf* buf, const char* str, size_t len) {
+	char* dst = obuf_reserve(buf, len);
+	if(dst) {
+		memcpy(dst, str, len);
+		buf->size += len;
 	}
+}
 
-	dlg_generic_outputf(print_stream, stream, format_string, origin, string, styles);
-	if(lock_stream) {
-		unlock_file(stream);
-	}
+#define obuf_lit(buf, lit) obuf_append(buf, lit, sizeof(lit) - 1)
+
+static void obuf_uint(struct obuf* buf, unsigned long long val) {
+	char tmp[24];
+	char* it = tmp + sizeof(tmp);
+	do {
+		*(--it) = (char) ('0' + val % 10);
+		val /= 10;
+	} while(val);
+	obuf_append(buf, it, tmp + sizeof(tmp) - it);
 }
 
-void dlg_default_output(const struct dlg_origin* origin, const char* string, void* data) {
-	FILE* stream = data ? (FILE*) data : stdout;
-	unsigned int features = dlg_output_file_line |
-		dlg_output_newline |
-		dlg_output_threadsafe;
+static const char* const level_names[] = {
+	"trace", "debug", "info", "warn", "error", "fatal"
+};
 
-#ifdef DLG_DEFAULT_OUTPUT_ALWAYS_COLOR
-	dlg_win_init_ansi();
-	features |= dlg_output_style;
+static inline unsigned dlg_ctz(unsigned val) {
+#ifdef _MSC_VER
+	unsigned long ret;
+	_BitScanForward(&ret, val);
+	return (unsigned) ret;
 #else
-	if(dlg_is_tty(stream) && dlg_win_init_ansi()) {
-		features |= dlg_output_style;
-	}
+	return (unsigned) __builtin_ctz(val);
 #endif
-
-	dlg_generic_output_stream(stream, features, origin, string, dlg_default_output_styles);
-	fflush(stream);
 }
 
-bool dlg_win_init_ansi(void) {
-#if defined(DLG_OS_WIN) && defined(DLG_WIN_CONSOLE)
-	// TODO: use init once
-	static volatile LONG status = 0;
-	LONG res = InterlockedCompareExchange(&status, 1, 0);
-	if(res == 0) { // not initialized
-		InterlockedExchange(&status, 3 + init_ansi_console());
+// Non-zero for all ascii chars that must be escaped in a json string.
+// The chars >= 0x80 are handled separately (utf-8 validation).
+static const unsigned char json_escape_table[128] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // '"'
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, // '\\'
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// Returns the length of the prefix of str that can be copied into a json
+// string as it is, i.e. pure ascii without quotes, backslashes or control chars.
+static size_t json_clean_span(const unsigned char* str, size_t len) {
+	size_t i = 0;
+
+	// A signed comparison of (byte < 0x20) catches both control characters
+	// and all bytes >= 0x80 (which are negative as signed char).
+#ifdef DLG_JSON_AVX2
+	const __m256i ctrl32 = _mm256_set1_epi8(0x20);
+	const __m256i quote32 = _mm256_set1_epi8('"');
+	const __m256i bslash32 = _mm256_set1_epi8('\\');
+	for(; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (str + i));
+		__m256i m = _mm256_or_si256(_mm256_cmpgt_epi8(ctrl32, v),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, quote32),
+				_mm256_cmpeq_epi8(v, bslash32)));
+		unsigned mask = (unsigned) _mm256_movemask_epi8(m);
+		if(mask) {
+			return i + dlg_ctz(mask);
+		}
 	}
+#endif
 
-	while(status == 1); // currently initialized in another thread, spinlock
-	return (status == 4);
-#else
-	return true;
+#ifdef DLG_JSON_SSE2
+	const __m128i ctrl = _mm_set1_epi8(0x20);
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	for(; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (str + i));
+		__m128i m = _mm_or_si128(_mm_cmplt_epi8(v, ctrl),
+			_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)));
+		unsigned mask = (unsigned) _mm_movemask_epi8(m);
+		if(mask) {
+			return i + dlg_ctz(mask);
+		}
+	}
 #endif
-}
 
-// small dynamic vec/array implementation
-// Since the macros vec_init and vec_add[c]/vec_push might
-// change the pointers value it must not be referenced somewhere else.
-#define vec__raw(vec) (((unsigned int*) vec) - 2)
+	for(; i < len; ++i) {
+		if(str[i] >= 0x80 || json_escape_table[str[i]]) {
+			break;
+		}
+	}
 
-static void* vec_do_create(unsigned int typesize, unsigned int cap, unsigned int size) {
-	unsigned long a = (size > cap) ? size : cap;
-	void* ptr = xalloc(2 * sizeof(unsigned int) + a * typesize);
-	unsigned int* begin = (unsigned int*) ptr;
-	begin[0] = size * typesize;
-	begin[1] = a * typesize;
-	return begin + 2;
+	return i;
 }
 
-// NOTE: can be more efficient if we are allowed to reorder vector
-static void vec_do_erase(void* vec, unsigned int pos, unsigned int size) {
-	unsigned int* begin = vec__raw(vec);
-	begin[0] -= size;
-	char* buf = (char*) vec;
-	memcpy(buf + pos, buf + pos + size, size);
-}
+// Returns the length of the valid utf-8 sequence starting at str
+// or 0 if there is none. str[0] must be >= 0x80.
+static size_t utf8_sequence(const unsigned char* str, size_t len) {
+	unsigned char c = str[0];
+	unsigned char lo = 0x80, hi = 0xBF;
+	size_t count;
+	if(c >= 0xC2 && c <= 0xDF) {
+		count = 2;
+	} else if(c >= 0xE0 && c <= 0xEF) {
+		count = 3;
+		if(c == 0xE0) lo = 0xA0;
+		if(c == 0xED) hi = 0x9F; // no surrogates
+	} else if(c >= 0xF0 && c <= 0xF4) {
+		count = 4;
+		if(c == 0xF0) lo = 0x90;
+		if(c == 0xF4) hi = 0x8F;
+	} else {
+		return 0;
+	}
 
-static void* vec_do_add(void** vec, unsigned int size) {
-	unsigned int* begin = vec__raw(*vec);
-	unsigned int needed = begin[0] + size;
-	if(needed >= begin[1]) {
-		void* ptr = xrealloc(begin, sizeof(unsigned int) * 2 + needed * 2);
-		begin = (unsigned int*) ptr;
-		begin[1] = needed * 2;
-		(*vec) = begin + 2;
+	if(len < count || str[1] < lo || str[1] > hi) {
+		return 0;
 	}
 
-	void* ptr = ((char*) (*vec)) + begin[0];
-	begin[0] += size;
-	return ptr;
+	for(size_t i = 2; i < count; ++i) {
+		if(str[i] < 0x80 || str[i] > 0xBF) {
+			return 0;
+		}
+	}
+
+	return count;
 }
 
-#define vec_create(type, size) (type*) vec_do_create(sizeof(type), size * 2, size)
-#define vec_create_reserve(type, size, capacity) (type*) vec_do_create(sizeof(type), capcity, size)
-#define vec_init(array, size) array = vec_do_create(sizeof(*array), size * 2, size)
-#define vec_init_reserve(array, size, capacity) *((void**) &array) = vec_do_create(sizeof(*array), capacity, size)
-#define vec_free(vec) (free((vec) ? vec__raw(vec) : NULL), vec = NULL)
-#define vec_erase_range(vec, pos, count) vec_do_erase(vec, pos * sizeof(*vec), count * sizeof(*vec))
-#define vec_erase(vec, pos) vec_do_erase(vec, pos * sizeof(*vec), sizeof(*vec))
-#define vec_size(vec) (vec__raw(vec)[0] / sizeof(*vec))
-#define vec_capacity(vec) (vec_raw(vec)[1] / sizeof(*vec))
-#define vec_add(vec) vec_do_add((void**) &vec, sizeof(*vec))
-#define vec_addc(vec, count) (vec_do_add((void**) &vec, sizeof(*vec) * count))
-#define vec_push(vec, value) (vec_do_add((void**) &vec, sizeof(*vec)), vec_last(vec) = (value))
-#define vec_pop(vec) (vec__raw(vec)[0] -= sizeof(*vec))
-#define vec_popc(vec, count) (vec__raw(vec)[0] -= sizeof(*vec) * count)
-#define vec_clear(vec) (vec__raw(vec)[0] = 0)
-#define vec_last(vec) (vec[vec_size(vec) - 1])
+// Appends the given string json-escaped (without quotes).
+// Invalid utf-8 is replaced with U+FFFD.
+static void json_escape(struct obuf* buf, const char* string, size_t len) {
+	static const char hex[] = "0123456789abcdef";
+	const unsigned char* str = (const unsigned char*) string;
+	while(len) {
+		size_t clean = json_clean_span(str, len);
+		obuf_append(buf, (const char*) str, clean);
+		str += clean;
+		len -= clean;
+		if(!len) {
+			break;
+		}
 
-static struct dlg_data* dlg_create_data(void) {
-	struct dlg_data* data = (struct dlg_data*) xalloc(sizeof(struct dlg_data));
-	vec_init_reserve(data->tags, 0, 20);
-	vec_init_reserve(data->pairs, 0, 20);
-	data->buffer_size = 100;
-	data->buffer = (char*) xalloc(data->buffer_size);
-	return data;
-}
+		unsigned char c = *str;
+		if(c >= 0x80) {
+			size_t seq = utf8_sequence(str, len);
+			if(seq) {
+				obuf_append(buf, (const char*) str, seq);
+				str += seq;
+				len -= seq;
+			} else {
+				obuf_lit(buf, "\\ufffd");
+				++str;
+				--len;
+			}
+			continue;
+		}
 
-static void dlg_free_data(void* ddata) {
-	struct dlg_data* data = (struct dlg_data*) ddata;
-	if(data) {
-		vec_free(data->pairs);
-		vec_free(data->tags);
-		free(data->buffer);
-		free(data);
+		switch(c) {
+			case '"': obuf_lit(buf, "\\\""); break;
+			case '\\': obuf_lit(buf, "\\\\"); break;
+			case '\b': obuf_lit(buf, "\\b"); break;
+			case '\f': obuf_lit(buf, "\\f"); break;
+			case '\n': obuf_lit(buf, "\\n"); break;
+			case '\r': obuf_lit(buf, "\\r"); break;
+			case '\t': obuf_lit(buf, "\\t"); break;
+			default: {
+				char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+				obuf_append(buf, esc, sizeof(esc));
+				break;
+			}
+		}
+
+		++str;
+		--len;
 	}
 }
 
-void dlg_add_tag(const char* tag, const char* func) {
-	struct dlg_data* data = dlg_data();
-	struct dlg_tag_func_pair* pair =
-		(struct dlg_tag_func_pair*) vec_add(data->pairs);
-	pair->tag = tag;
-	pair->func = func;
+static void json_string(struct obuf* buf, const char* str) {
+	obuf_lit(buf, "\"");
+	if(str) {
+		json_escape(buf, str, strlen(str));
+	}
+	obuf_lit(buf, "\"");
 }
 
-bool dlg_remove_tag(const char* tag, const char* func) {
+// Appends the current utc time in iso 8601 format with microseconds.
+// The formatted date is cached per thread since it rarely changes.
+static void json_time(struct obuf* buf) {
+	struct timespec ts;
+	if(!timespec_get(&ts, TIME_UTC)) {
+		obuf_lit(buf, "null");
+		return;
+	}
+
 	struct dlg_data* data = dlg_data();
-	for(unsigned int i = 0; i < vec_size(data->pairs); ++i) {
-		if(data->pairs[i].func == func && data->pairs[i].tag == tag) {
-			vec_erase(data->pairs, i);
+	if(ts.tv_sec != data->json_time || !data->json_time_buf[0]) {
+		struct tm tm_info;
+#ifdef DLG_OS_WIN
+		if(gmtime_s(&tm_info, &ts.tv_sec)) {
+#else
+		if(!gmtime_r(&ts.tv_sec, &tm_info)) {
+#endif
+			obuf_lit(buf, "null");
+			return;
+		}
+
+		strftime(data->json_time_buf, sizeof(data->json_time_buf),
+			"%Y-%m-%dT%H:%M:%S", &tm_info);
+		data->json_time = ts.tv_sec;
+	}
+
+	char usecs[8];
+	unsigned long us = (unsigned long) (ts.tv_nsec / 1000);
+	usecs[0] = '.';
+	for(int i = 6; i > 0; --i) {
+		usecs[i] = (char) ('0' + us % 10);
+		us /= 10;
+	}
+	usecs[7] = 'Z';
+
+	obuf_lit(buf, "\"");
+	obuf_append(buf, data->json_time_buf, strlen(data->json_time_buf));
+	obuf_append(buf, usecs, sizeof(usecs));
+	obuf_lit(buf, "\"");
+}
+
+// Renders the fields of the context, the ones of its parents first
+// (a later duplicate key overrides the earlier one for most readers).
+static void json_fields(struct obuf* buf, const struct dlg_context* context, bool* first) {
+	if(!context) {
+		return;
+	}
+
+	json_fields(buf, context->parent, first);
+	for(const char* const* field = context->fields; field && *field; field += 2) {
+		if(*first) {
+			obuf_lit(buf, ",\"fields\":{");
+			*first = false;
+		} else {
+			obuf_lit(buf, ",");
+		}
+
+		json_string(buf, field[0]);
+		obuf_lit(buf, ":");
+		json_string(buf, field[1] ? field[1] : "");
+	}
+}
+
+// Renders the record into the thread-specific out buffer.
+// Returns the number of bytes written, the buffer is not null-terminated.
+static size_t json_render(struct obuf* buf, const struct dlg_origin* origin,
+		const char* string) {
+	obuf_lit(buf, "{\"time\":");
+	json_time(buf);
+	obuf_lit(buf, ",\"level\":\"");
+	obuf_append(buf, level_names[origin->level], strlen(level_names[origin->level]));
+	obuf_lit(buf, "\",\"file\":");
+	json_string(buf, origin->file);
+	obuf_lit(buf, ",\"line\":");
+	obuf_uint(buf, origin->line);
+	obuf_lit(buf, ",\"func\":");
+	json_string(buf, origin->func);
+	obuf_lit(buf, ",\"tags\":[");
+	for(const char** tags = origin->tags; *tags; ++tags) {
+		if(tags != origin->tags) {
+			obuf_lit(buf, ",");
+		}
+		json_string(buf, *tags);
+	}
+	obuf_lit(buf, "]");
+
+	struct dlg_record_thread thread;
+	dlg_get_record_thread(&thread);
+	bool first = true;
+	json_fields(buf, thread.context, &first);
+	if(!first) {
+		obuf_lit(buf, "}");
+	}
+
+	if(origin->expr) {
+		obuf_lit(buf, ",\"expr\":");
+		json_string(buf, origin->expr);
+	}
+
+	if(string) {
+		obuf_lit(buf, ",\"msg\":");
+		json_string(buf, string);
+	}
+
+	obuf_lit(buf, "}\n");
+	return buf->size;
+}
+
+void dlg_generic_output_json_buf(char* buf, size_t* size,
+		const struct dlg_origin* origin, const char* string) {
+	struct obuf obuf;
+	obuf_init(&obuf);
+	size_t needed = json_render(&obuf, origin, string);
+	if(!buf) {
+		*size = needed;
+		return;
+	}
+
+	if(*size) {
+		size_t count = (needed < *size) ? needed : *size - 1;
+		memcpy(buf, *obuf.buf, count);
+		buf[count] = '\0';
+		*size = count;
+	}
+}
+
+void dlg_json_escape_buf(char* buf, size_t* size, const char* string, size_t len) {
+	struct obuf obuf;
+	obuf_init(&obuf);
+	json_escape(&obuf, string, len);
+	if(!buf) {
+		*size = obuf.size;
+		return;
+	}
+
+	if(*size) {
+		size_t count = (obuf.size < *size) ? obuf.size : *size - 1;
+		memcpy(buf, *obuf.buf, count);
+		buf[count] = '\0';
+		*size = count;
+	}
+}
+
+void dlg_generic_output_json_stream(FILE* stream, const struct dlg_origin* origin,
+		const char* string) {
+	stream = stream ? stream : stdout;
+	struct obuf obuf;
+	obuf_init(&obuf);
+	size_t size = json_render(&obuf, origin, string);
+	size = fwrite(*obuf.buf, 1, size, stream);
+	counter_add(&dlg_data()->counters.bytes_output, size);
+}
+
+void dlg_json_output(const struct dlg_origin* origin, const char* string, void* data) {
+	FILE* stream = data ? (FILE*) data : stdout;
+	dlg_generic_output_json_stream(stream, origin, string);
+	fflush(stream);
+}
+
+void dlg_default_output(const struct dlg_origin* origin, const char* string, void* data) {
+	FILE* stream = data ? (FILE*) data : stdout;
+	unsigned int features = dlg_output_file_line |
+		dlg_output_newline |
+		dlg_output_threadsafe;
+
+#ifdef DLG_DEFAULT_OUTPUT_ALWAYS_COLOR
+	dlg_win_init_ansi();
+	features |= dlg_output_style;
+#else
+	if(dlg_is_tty(stream) && dlg_win_init_ansi()) {
+		features |= dlg_output_style;
+	}
+#endif
+
+	dlg_generic_output_stream(stream, features, origin, string, dlg_default_output_styles);
+	fflush(stream);
+}
+
+static void print_obuf(void* dbuf, const char* format, ...) {
+	struct obuf* buf = (struct obuf*) dbuf;
+	va_list args;
+	va_start(args, format);
+	va_list args_copy;
+	va_copy(args_copy, args);
+
+	// usually fits into the remaining space, otherwise format again
+	size_t space = *buf->cap - buf->size;
+	char* end = *buf->buf ? *buf->buf + buf->size : NULL;
+	int needed = vsnprintf(end, space, format, args);
+	if(needed >= 0 && (size_t) needed >= space) {
+		char* dst = obuf_reserve(buf, (size_t) needed + 1);
+		if(!dst) {
+			needed = -1;
+		} else {
+			vsnprintf(dst, (size_t) needed + 1, format, args_copy);
+		}
+	}
+
+	if(needed > 0) {
+		buf->size += (size_t) needed;
+		if(buf->size + 1 > *buf->used) {
+			*buf->used = buf->size + 1;
+		}
+	}
+
+	va_end(args_copy);
+	va_end(args);
+}
+
+// Writes the buffer with a single fwrite, the stream is only locked
+// (if requested) for that. Returns the number of bytes written.
+static size_t write_obuf(FILE* stream, const struct obuf* buf, bool lock) {
+	uint64_t lock_start = 0;
+	if(lock) {
+		lock_file(stream);
+		lock_start = atomic_load_relaxed(&g_stats_timing) ? get_nsecs() : 0;
+	}
+
+	size_t written = 0u;
+#if defined(DLG_OS_WIN) && defined(DLG_WIN_CONSOLE)
+	if(stream == stdout || stream == stderr) { // needs utf-16 conversion
+		int ret = dlg_fprintf(stream, "%.*s", (int) buf->size, *buf->buf);
+		written = ret > 0 ? (size_t) ret : 0u;
+	} else
+#endif
+	if(buf->size) {
+		written = fwrite(*buf->buf, 1, buf->size, stream);
+	}
+
+	struct dlg_counters* counters = &dlg_data()->counters;
+	if(lock) {
+		unlock_file(stream);
+		if(lock_start) {
+			counter_add(&counters->lock_ns, get_nsecs() - lock_start);
+		}
+	}
+
+	counter_add(&counters->bytes_output, written);
+	return written;
+}
+
+// The record is rendered into the thread buffer without holding any lock,
+// slow formatting doesn't block other threads writing to the stream.
+void dlg_generic_output_stream(FILE* stream, unsigned int features,
+		const struct dlg_origin* origin, const char* string,
+		const struct dlg_style styles[6]) {
+	struct obuf buf;
+	obuf_init(&buf);
+	dlg_generic_output(print_obuf, &buf, features, origin, string, styles);
+	write_obuf(stream ? stream : stdout, &buf, features & dlg_output_threadsafe);
+}
+
+void dlg_generic_outputf_stream(FILE* stream, const char* format_string,
+		const struct dlg_origin* origin, const char* string,
+		const struct dlg_style styles[6], bool lock_stream) {
+	struct obuf buf;
+	obuf_init(&buf);
+	dlg_generic_outputf(print_obuf, &buf, format_string, origin, string, styles);
+	write_obuf(stream ? stream : stdout, &buf, lock_stream);
+}
+
+void dlg_default_batch_output(const struct dlg_record* records, unsigned count, void* data) {
+	FILE* stream = data ? (FILE*) data : stdout;
+	unsigned int features = dlg_output_file_line | dlg_output_newline;
+
+#ifdef DLG_DEFAULT_OUTPUT_ALWAYS_COLOR
+	dlg_win_init_ansi();
+	features |= dlg_output_style;
+#else
+	if(dlg_is_tty(stream) && dlg_win_init_ansi()) {
+		features |= dlg_output_style;
+	}
+#endif
+
+	struct obuf buf;
+	obuf_init(&buf);
+	for(unsigned i = 0u; i < count; ++i) {
+		dlg_generic_output(print_obuf, &buf, features, records[i].origin,
+			records[i].string, dlg_default_output_styles);
+	}
+
+	write_obuf(stream, &buf, false);
+	fflush(stream);
+}
+
+bool dlg_win_init_ansi(void) {
+#if defined(DLG_OS_WIN) && defined(DLG_WIN_CONSOLE)
+	// TODO: use init once
+	static volatile LONG status = 0;
+	LONG res = InterlockedCompareExchange(&status, 1, 0);
+	if(res == 0) { // not initialized
+		InterlockedExchange(&status, 3 + init_ansi_console());
+	}
+
+	while(status == 1); // currently initialized in another thread, spinlock
+	return (status == 4);
+#else
+	return true;
+#endif
+}
+
+// small dynamic vec/array implementation
+// Since the macros vec_init and vec_add[c]/vec_push might
+// change the pointers value it must not be referenced somewhere else.
+#define vec__raw(vec) (((unsigned int*) vec) - 2)
+
+static void* vec_do_create(unsigned int typesize, unsigned int cap, unsigned int size) {
+	unsigned long a = (size > cap) ? size : cap;
+	void* ptr = xalloc(2 * sizeof(unsigned int) + a * typesize);
+	unsigned int* begin = (unsigned int*) ptr;
+	begin[0] = size * typesize;
+	begin[1] = a * typesize;
+	return begin + 2;
+}
+
+// NOTE: can be more efficient if we are allowed to reorder vector
+static void vec_do_erase(void* vec, unsigned int pos, unsigned int size) {
+	unsigned int* begin = vec__raw(vec);
+	begin[0] -= size;
+	char* buf = (char*) vec;
+	memcpy(buf + pos, buf + pos + size, size);
+}
+
+static void* vec_do_add(void** vec, unsigned int size) {
+	unsigned int* begin = vec__raw(*vec);
+	unsigned int needed = begin[0] + size;
+	if(needed >= begin[1]) {
+		void* ptr = xrealloc(begin, sizeof(unsigned int) * 2 + needed * 2);
+		begin = (unsigned int*) ptr;
+		begin[1] = needed * 2;
+		(*vec) = begin + 2;
+	}
+
+	void* ptr = ((char*) (*vec)) + begin[0];
+	begin[0] += size;
+	return ptr;
+}
+
+#define vec_create(type, size) (type*) vec_do_create(sizeof(type), size * 2, size)
+#define vec_create_reserve(type, size, capacity) (type*) vec_do_create(sizeof(type), capcity, size)
+#define vec_init(array, size) array = vec_do_create(sizeof(*array), size * 2, size)
+#define vec_init_reserve(array, size, capacity) *((void**) &array) = vec_do_create(sizeof(*array), capacity, size)
+#define vec_free(vec) (free((vec) ? vec__raw(vec) : NULL), vec = NULL)
+#define vec_erase_range(vec, pos, count) vec_do_erase(vec, pos * sizeof(*vec), count * sizeof(*vec))
+#define vec_erase(vec, pos) vec_do_erase(vec, pos * sizeof(*vec), sizeof(*vec))
+#define vec_size(vec) (vec__raw(vec)[0] / sizeof(*vec))
+#define vec_capacity(vec) (vec_raw(vec)[1] / sizeof(*vec))
+#define vec_add(vec) vec_do_add((void**) &vec, sizeof(*vec))
+#define vec_addc(vec, count) (vec_do_add((void**) &vec, sizeof(*vec) * count))
+#define vec_push(vec, value) (vec_do_add((void**) &vec, sizeof(*vec)), vec_last(vec) = (value))
+#define vec_pop(vec) (vec__raw(vec)[0] -= sizeof(*vec))
+#define vec_popc(vec, count) (vec__raw(vec)[0] -= sizeof(*vec) * count)
+#define vec_clear(vec) (vec__raw(vec)[0] = 0)
+#define vec_last(vec) (vec[vec_size(vec) - 1])
+
+// callsite profiling tables
+static struct dlg_callsite_table* callsite_table_create(unsigned cap) {
+	struct dlg_callsite_table* table = (struct dlg_callsite_table*) xalloc(
+		sizeof(*table) + cap * sizeof(struct dlg_callsite));
+	table->cap = cap;
+	return table;
+}
+
+static void callsite_table_free(struct dlg_callsite_table* table) {
+	while(table) {
+		struct dlg_callsite_table* old = table->old;
+		free(table);
+		table = old;
+	}
+}
+
+static inline unsigned callsite_hash(const char* file, unsigned line) {
+	uintptr_t h = (uintptr_t) file ^ ((uintptr_t) line * 0x9E3779B1u);
+	h ^= h >> 15;
+	return (unsigned) (h * 0x2C1B3C6Du) ^ (unsigned) (h >> 16);
+}
+
+// Returns the slot for the given callsite (or the empty slot where it
+// would be inserted) in a table that has at least one empty slot.
+static struct dlg_callsite* callsite_slot(struct dlg_callsite_table* table,
+		const char* file, const char* func, unsigned line) {
+	unsigned i = callsite_hash(file, line) & (table->cap - 1);
+	while(true) {
+		struct dlg_callsite* entry = &table->entries[i];
+		if(!entry->file || (entry->file == file && entry->line == line &&
+				entry->func == func)) {
+			return entry;
+		}
+		i = (i + 1) & (table->cap - 1);
+	}
+}
+
+// Finds or inserts the given callsite. Only called by the thread owning the
+// table (or with the global lock held for g_retired_profile).
+static struct dlg_callsite* callsite_get(struct dlg_callsite_table** ptable,
+		const char* file, const char* func, unsigned line) {
+	struct dlg_callsite_table* table = *ptable;
+	if(!table) {
+		table = callsite_table_create(64);
+		atomic_store_ptr(ptable, table);
+	}
+
+	struct dlg_callsite* entry = callsite_slot(table, file, func, line);
+	if(entry->file) {
+		return entry;
+	}
+
+	// max load factor 1/2
+	if(2 * (table->count + 1) > table->cap) {
+		struct dlg_callsite_table* grown = callsite_table_create(2 * table->cap);
+		for(unsigned i = 0u; i < table->cap; ++i) {
+			const struct dlg_callsite* old = &table->entries[i];
+			if(old->file) {
+				*callsite_slot(grown, old->file, old->func, old->line) = *old;
+			}
+		}
+
+		grown->count = table->count;
+		grown->old = table;
+		atomic_store_ptr(ptable, grown);
+		table = grown;
+		entry = callsite_slot(table, file, func, line);
+	}
+
+	++table->count;
+	entry->func = func;
+	entry->line = line;
+	atomic_store_ptr(&entry->file, file);
+	return entry;
+}
+
+static void callsite_merge(struct dlg_callsite_table** dst,
+		const struct dlg_callsite_table* src) {
+	for(unsigned i = 0u; i < src->cap; ++i) {
+		const struct dlg_callsite* entry = &src->entries[i];
+		if(entry->file) {
+			struct dlg_callsite* to = callsite_get(dst, entry->file,
+				entry->func, entry->line);
+			to->hits += entry->hits;
+			to->bytes += entry->bytes;
+			to->format_ns += entry->format_ns;
+			to->handler_ns += entry->handler_ns;
+		}
+	}
+}
+
+static struct dlg_data* dlg_create_data(void) {
+	struct dlg_data* data = (struct dlg_data*) xalloc(sizeof(struct dlg_data));
+	vec_init_reserve(data->tags, 0, 20);
+	vec_init_reserve(data->pairs, 0, 20);
+	data->buffer_size = 100;
+	data->buffer = (char*) xalloc(data->buffer_size);
+	buffer_account(data);
+	data->thread_id = get_thread_id();
+	data->level = -1;
+	data->format_length = format_no_length;
+#ifdef DLG__THREAD_LEVEL_VAR
+	dlg__thread_filtered = &data->filtered;
+#endif
+
+	lock_global();
+	data->next = g_threads;
+	if(g_threads) {
+		g_threads->prev = data;
+	}
+	g_threads = data;
+	++g_thread_count;
+	unlock_global();
+
+	return data;
+}
+
+static void dlg_free_data(void* ddata) {
+	struct dlg_data* data = (struct dlg_data*) ddata;
+	if(data) {
+		batch_flush(data);
+
+		// unlink and keep the counters of the thread
+		lock_global();
+		if(data->prev) {
+			data->prev->next = data->next;
+		} else {
+			g_threads = data->next;
+		}
+		if(data->next) {
+			data->next->prev = data->prev;
+		}
+
+		const uint64_t* src = (const uint64_t*) &data->counters;
+		uint64_t* dst = (uint64_t*) &g_retired;
+		for(size_t i = 0u; i < dlg_counters_count; ++i) {
+			dst[i] += src[i];
+		}
+		g_retired.filtered += data->filtered;
+
+		if(data->profile) {
+			callsite_merge(&g_retired_profile, data->profile);
+		}
+		unlock_global();
+
+		callsite_table_free(data->profile);
+#ifdef DLG__THREAD_LEVEL_VAR
+		if(dlg__thread_filtered == &data->filtered) {
+			dlg__thread_filtered = NULL;
+		}
+#endif
+
+		vec_free(data->pairs);
+		vec_free(data->tags);
+		free(data->buffer);
+		free(data->out_buffer);
+		if(data->batch.entries) {
+			vec_free(data->batch.entries);
+			vec_free(data->batch.tags);
+			vec_free(data->batch.strings);
+			vec_free(data->batch.records);
+			vec_free(data->batch.tag_lists);
+		}
+		free(data);
+	}
+}
+
+void dlg_set_thread_name(const char* name) {
+	struct dlg_data* data = dlg_data();
+	snprintf(data->thread_name, sizeof(data->thread_name), "%s", name ? name : "");
+	data->thread_name_set = true;
+}
+
+const char* dlg_get_thread_name(void) {
+	struct dlg_data* data = dlg_data();
+	if(!data->thread_name_set) {
+		get_thread_name(data->thread_name, sizeof(data->thread_name));
+		if(!data->thread_name[0]) {
+			snprintf(data->thread_name, sizeof(data->thread_name), "%llu",
+				(unsigned long long) data->thread_id);
+		}
+		data->thread_name_set = true;
+	}
+
+	return data->thread_name;
+}
+
+void dlg_set_record_thread(const struct dlg_record_thread* thread) {
+	dlg_data()->record_thread = thread;
+}
+
+void dlg_get_record_thread(struct dlg_record_thread* thread) {
+	struct dlg_data* data = dlg_data();
+	if(data->record_thread) {
+		*thread = *data->record_thread;
+		return;
+	}
+
+	thread->id = data->thread_id;
+	thread->name = dlg_get_thread_name();
+	thread->context = data->record_context;
+}
+
+void dlg_add_tag(const char* tag, const char* func) {
+	struct dlg_data* data = dlg_data();
+	struct dlg_tag_func_pair* pair =
+		(struct dlg_tag_func_pair*) vec_add(data->pairs);
+	pair->tag = tag;
+	pair->func = func;
+}
+
+bool dlg_remove_tag(const char* tag, const char* func) {
+	struct dlg_data* data = dlg_data();
+	for(unsigned int i = 0; i < vec_size(data->pairs); ++i) {
+		if(data->pairs[i].func == func && data->pairs[i].tag == tag) {
+			vec_erase(data->pairs, i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const struct dlg_context* dlg_context_install(const struct dlg_context* context) {
+	struct dlg_data* data = dlg_data();
+	const struct dlg_context* prev = data->context;
+	data->context = context;
+	return prev;
+}
+
+const struct dlg_context* dlg_context_current(void) {
+	return dlg_data()->context;
+}
+
+char** dlg_thread_buffer(size_t** size) {
+	struct dlg_data* data = dlg_data();
+	data->format_length = format_no_length; // written by the caller
+	if(size) {
+		*size = &data->buffer_size;
+	}
+	return &data->buffer;
+}
+
+// Grows the formatting buffer to at least size bytes (doubling), but
+// not beyond the cap. Returns false if it could not grow at all.
+static bool buffer_grow(struct dlg_data* data, size_t size) {
+	size_t max = (size_t) atomic_load_relaxed(&g_buffer_max);
+	size_t nsize = size * 2;
+	if(max && nsize > max) {
+		nsize = max;
+	}
+
+	if(nsize <= data->buffer_size) {
+		return false;
+	}
+
+	char* nbuf = (char*) xrealloc(data->buffer, nsize);
+	if(!nbuf) {
+		return false;
+	}
+
+	data->buffer = nbuf;
+	data->buffer_size = nsize;
+	counter_add(&data->counters.buffer_reallocs, 1);
+	buffer_account(data);
+	return true;
+}
+
+static void buffer_shrink(char** buf, size_t* size, size_t to) {
+	char* nbuf = (char*) realloc(*buf, to);
+	if(nbuf) { // otherwise just keep the old buffer
+		*buf = nbuf;
+		*size = to;
+	}
+}
+
+// Shrinks the buffers back to the high-water mark after enough records that
+// didn't need more than that. Called after every record, the common case
+// (buffers small enough already) only costs a few loads.
+static void buffer_decay(struct dlg_data* data, const char* string) {
+	size_t used = data->out_used;
+	data->out_used = 0;
+
+	size_t high = (size_t) atomic_load_relaxed(&g_buffer_shrink);
+	size_t max = (size_t) atomic_load_relaxed(&g_buffer_max);
+	unsigned after = (unsigned) atomic_load_relaxed(&g_buffer_shrink_after);
+	if(max && data->buffer_size > max) { // cap was lowered
+		buffer_shrink(&data->buffer, &data->buffer_size, max);
+		buffer_account(data);
+	}
+
+	if(!after || (data->buffer_size <= high && data->out_buffer_size <= high)) {
+		data->small_records = 0;
+		return;
+	}
+
+	if(string == data->buffer) {
+		size_t len = strlen(string) + 1;
+		used = len > used ? len : used;
+	}
+
+	if(used > high) {
+		data->small_records = 0;
+		return;
+	}
+
+	if(++data->small_records < after) {
+		return;
+	}
+
+	data->small_records = 0;
+	if(data->buffer_size > high) {
+		buffer_shrink(&data->buffer, &data->buffer_size, high);
+	}
+	if(data->out_buffer_size > high) {
+		buffer_shrink(&data->out_buffer, &data->out_buffer_size, high);
+	}
+	buffer_account(data);
+}
+
+bool dlg_thread_buffer_grow(size_t size) {
+	struct dlg_data* data = dlg_data();
+	return size <= data->buffer_size || buffer_grow(data, size);
+}
+
+void dlg_thread_buffer_truncate(void) {
+	struct dlg_data* data = dlg_data();
+	const size_t len = sizeof(DLG_TRUNCATED_MARKER); // with null terminator
+	if(data->buffer_size >= len) {
+		memcpy(data->buffer + data->buffer_size - len, DLG_TRUNCATED_MARKER, len);
+	} else if(data->buffer_size) {
+		data->buffer[data->buffer_size - 1] = '\0';
+	}
+	data->format_length = format_no_length;
+	counter_add(&data->counters.truncated, 1);
+}
+
+void dlg_set_buffer_limits(const struct dlg_buffer_limits* limits) {
+	size_t max = limits->max_size;
+	if(max && max < 64) {
+		max = 64;
+	}
+
+	size_t shrink = limits->shrink_size < 64 ? 64 : limits->shrink_size;
+	atomic_store_relaxed(&g_buffer_max, (uint64_t) max);
+	atomic_store_relaxed(&g_buffer_shrink, (uint64_t) shrink);
+	atomic_store_relaxed(&g_buffer_shrink_after, (uint64_t) limits->shrink_after);
+}
+
+void dlg_get_buffer_limits(struct dlg_buffer_limits* limits) {
+	limits->max_size = (size_t) atomic_load_relaxed(&g_buffer_max);
+	limits->shrink_size = (size_t) atomic_load_relaxed(&g_buffer_shrink);
+	limits->shrink_after = (unsigned) atomic_load_relaxed(&g_buffer_shrink_after);
+}
+
+// Calls the single-record handler. Handlers set with dlg_set_handler
+// are called directly, i.e. the adapter to dlg_handler_ex is implicit.
+// context is the one of the record if it is dispatched while logging it.
+static void dispatch(struct dlg_data* data, const struct dlg_origin* origin,
+		const char* string, size_t length, const char* format,
+		const struct dlg_context* context) {
+	// records logged while rendering one of another thread are our own
+	const struct dlg_record_thread* record_thread = data->record_thread;
+	data->record_thread = NULL;
+	data->record_context = context;
+	if(!g_handler_ex) {
+		g_handler(origin, string, g_data);
+		data->record_context = NULL;
+		data->record_thread = record_thread;
+		return;
+	}
+
+	struct dlg_origin_ex ex;
+	ex.size = sizeof(ex);
+	ex.origin = origin;
+	ex.length = length;
+	ex.thread_id = data->thread_id;
+	ex.sequence = next_sequence();
+	ex.format = format;
+	ex.context = context;
+	g_handler_ex(&ex, string, g_handler_ex_data);
+	data->record_context = NULL;
+	data->record_thread = record_thread;
+}
+
+// Hands the queued records to the current (batch) handler.
+static void batch_deliver(struct dlg_data* data, const struct dlg_record* records,
+		unsigned count) {
+	if(g_batch_handler) {
+		g_batch_handler(records, count, g_batch_data);
+		return;
+	}
+
+	for(unsigned i = 0u; i < count; ++i) {
+		dispatch(data, records[i].origin, records[i].string, records[i].length,
+			NULL, NULL);
+	}
+}
+
+static void batch_flush(struct dlg_data* data) {
+	struct dlg_batch* batch = &data->batch;
+	if(!batch->entries || !vec_size(batch->entries) || batch->flushing) {
+		return;
+	}
+
+	batch->flushing = true;
+	unsigned count = vec_size(batch->entries);
+	vec_clear(batch->records);
+	vec_addc(batch->records, count);
+
+	// strings may have been reallocated while queueing, resolve the
+	// tag offsets only now
+	unsigned tag_count = vec_size(batch->tags);
+	vec_clear(batch->tag_lists);
+	vec_addc(batch->tag_lists, tag_count);
+	for(unsigned i = 0u; i < tag_count; ++i) {
+		batch->tag_lists[i] = (batch->tags[i] == batch_no_string) ?
+			NULL : batch->strings + batch->tags[i];
+	}
+
+	for(unsigned i = 0u; i < count; ++i) {
+		struct batch_entry* entry = &batch->entries[i];
+		entry->origin.tags = batch->tag_lists + entry->tags;
+		batch->records[i].origin = &entry->origin;
+		batch->records[i].string = (entry->string == batch_no_string) ?
+			NULL : batch->strings + entry->string;
+		batch->records[i].length = entry->length;
+	}
+
+	batch_deliver(data, batch->records, count);
+
+	vec_clear(batch->entries);
+	vec_clear(batch->tags);
+	vec_clear(batch->strings);
+	batch->flushing = false;
+}
+
+// Queues the record, hands the queue over when a limit is reached.
+static void batch_push(struct dlg_data* data, const struct dlg_origin* origin,
+		const char* string, size_t length, const char* format) {
+	struct dlg_batch* batch = &data->batch;
+	if(batch->flushing) { // logged by the handler itself
+		struct dlg_record record = {origin, string, length};
+		batch_deliver(data, &record, 1u);
+		return;
+	}
+
+	if(!g_batch_handler) { // records queued before dlg_set_handler
+		batch_flush(data);
+		dispatch(data, origin, string, length, format, data->context);
+		return;
+	}
+
+	if(!batch->entries) {
+		vec_init_reserve(batch->entries, 0, 16);
+		vec_init_reserve(batch->tags, 0, 64);
+		vec_init_reserve(batch->strings, 0, 1024);
+		vec_init_reserve(batch->records, 0, 16);
+		vec_init_reserve(batch->tag_lists, 0, 64);
+	}
+
+	const struct dlg_batch_limits* limits = &g_batch_limits;
+	uint64_t now = limits->max_latency_ms ? get_nsecs() : 0u;
+	if(!vec_size(batch->entries)) {
+		batch->first_ns = now;
+	}
+
+	struct batch_entry* entry = (struct batch_entry*) vec_add(batch->entries);
+	entry->origin = *origin;
+	entry->tags = vec_size(batch->tags);
+	for(const char** tag = origin->tags; *tag; ++tag) {
+		size_t len = strlen(*tag) + 1;
+		vec_push(batch->tags, vec_size(batch->strings));
+		memcpy(vec_addc(batch->strings, len), *tag, len);
+	}
+	vec_push(batch->tags, batch_no_string);
+
+	entry->string = batch_no_string;
+	entry->length = length;
+	if(string) {
+		entry->string = vec_size(batch->strings);
+		memcpy(vec_addc(batch->strings, entry->length + 1), string, entry->length + 1);
+	}
+
+	if(vec_size(batch->entries) >= limits->max_records ||
+			vec_size(batch->strings) >= limits->max_bytes ||
+			origin->level >= limits->flush_level ||
+			(now && now - batch->first_ns >= (uint64_t) limits->max_latency_ms * 1000000u)) {
+		batch_flush(data);
+	}
+}
+
+void dlg_set_handler(dlg_handler handler, void* data) {
+	batch_flush(dlg_data());
+	g_handler = handler;
+	g_data = data;
+	g_handler_ex = NULL;
+	g_handler_ex_data = NULL;
+	g_batch_handler = NULL;
+	g_batch_data = NULL;
+}
+
+void dlg_set_handler_ex(dlg_handler_ex handler, void* data) {
+	batch_flush(dlg_data());
+	g_handler_ex = handler;
+	g_handler_ex_data = data;
+	g_batch_handler = NULL;
+	g_batch_data = NULL;
+}
+
+dlg_handler_ex dlg_get_handler_ex(void** data) {
+	*data = g_handler_ex_data;
+	return g_handler_ex;
+}
+
+void dlg__set_format(const char* format) {
+	dlg_data()->format = format;
+}
+
+void dlg_set_batch_handler(dlg_batch_handler handler, void* data,
+		const struct dlg_batch_limits* limits) {
+	batch_flush(dlg_data());
+	g_batch_handler = handler;
+	g_batch_data = data;
+	g_handler_ex = NULL;
+	g_handler_ex_data = NULL;
+	if(limits) {
+		g_batch_limits = *limits;
+		if(!g_batch_limits.max_records) {
+			g_batch_limits.max_records = 1u;
+		}
+	} else {
+		struct dlg_batch_limits defaults = {64, 64 * 1024, 100, dlg_level_error};
+		g_batch_limits = defaults;
+	}
+}
+
+dlg_batch_handler dlg_get_batch_handler(void** data) {
+	*data = g_batch_data;
+	return g_batch_handler;
+}
+
+void dlg_flush(void) {
+	batch_flush(dlg_data());
+}
+
+dlg_handler dlg_get_handler(void** data) {
+	*data = g_data;
+	return g_handler;
+}
+
+const char* dlg__printf_format(const char* str, ...) {
+	va_list vlist;
+	va_start(vlist, str);
+
+	va_list vlistcopy;
+	va_copy(vlistcopy, vlist);
+	int needed = vsnprintf(NULL, 0, str, vlist);
+	if(needed < 0) {
+		printf("dlg__printf_format: invalid format given\n");
+		va_end(vlist);
+		va_end(vlistcopy);
+		return NULL;
+	}
+
+	va_end(vlist);
+
+	struct dlg_data* data = dlg_data();
+	data->format = str;
+	uint64_t start = atomic_load_relaxed(&g_profiling) ? get_nsecs() : 0;
+	if(data->buffer_size <= (unsigned int) needed) {
+		buffer_grow(data, (size_t) needed + 1);
+	}
+
+	counter_add(&data->counters.bytes_formatted, needed);
+
+	vsnprintf(data->buffer, data->buffer_size, str, vlistcopy);
+	va_end(vlistcopy);
+
+	data->format_length = (size_t) needed;
+	if(data->buffer_size <= (unsigned int) needed) {
+		dlg_thread_buffer_truncate();
+	}
+
+	if(start) {
+		data->format_ns = get_nsecs() - start;
+	}
+
+	return data->buffer;
+}
+
+struct dlg_arg_sink {
+	struct dlg_data* data;
+	size_t size; // written to the thread buffer, without null terminator
+	bool truncated;
+};
+
+void dlg_arg_sink_append(struct dlg_arg_sink* sink, const char* str, size_t size) {
+	struct dlg_data* data = sink->data;
+	if(sink->truncated) {
+		return;
+	}
+
+	// keep space for the null terminator
+	if(sink->size + size >= data->buffer_size) {
+		buffer_grow(data, sink->size + size + 1);
+		if(sink->size + size >= data->buffer_size) {
+			sink->truncated = true;
+			size = (data->buffer_size > sink->size) ? data->buffer_size - sink->size - 1 : 0u;
+		}
+	}
+
+	if(size) {
+		memcpy(data->buffer + sink->size, str, size);
+		sink->size += size;
+	}
+}
+
+static void print_arg(struct dlg_arg_sink* sink, const struct dlg_arg* arg) {
+	char buf[64];
+	int len = 0;
+	switch(arg->type) {
+		case dlg_arg_int:
+			len = snprintf(buf, sizeof(buf), "%lld", arg->value.i);
+			break;
+		case dlg_arg_uint:
+			len = snprintf(buf, sizeof(buf), "%llu", arg->value.u);
+			break;
+		case dlg_arg_double:
+			len = snprintf(buf, sizeof(buf), "%g", arg->value.d);
+			break;
+		case dlg_arg_char:
+			dlg_arg_sink_append(sink, &arg->value.c, 1u);
+			return;
+		case dlg_arg_bool:
+			dlg_arg_sink_append(sink, arg->value.b ? "1" : "0", 1u);
+			return;
+		case dlg_arg_string:
+			dlg_arg_sink_append(sink, arg->value.str.data, arg->value.str.size);
+			return;
+		case dlg_arg_pointer:
+			// like std::ostream, %p of NULL is implementation-defined
+			len = arg->value.ptr ? snprintf(buf, sizeof(buf), "%p", arg->value.ptr) :
+				snprintf(buf, sizeof(buf), "0");
+			break;
+		case dlg_arg_custom:
+			arg->value.custom.print(arg->value.custom.obj, sink);
+			return;
+	}
+
+	if(len > 0) {
+		dlg_arg_sink_append(sink, buf, (size_t) len < sizeof(buf) ? (size_t) len : sizeof(buf) - 1);
+	}
+}
+
+const char* dlg_format_args(const char* replace, const char* format,
+		const struct dlg_arg* args, unsigned count) {
+	struct dlg_data* data = dlg_data();
+	data->format = format;
+	uint64_t start = atomic_load_relaxed(&g_profiling) ? get_nsecs() : 0;
+
+	struct dlg_arg_sink sink = {data, 0u, false};
+	size_t len = strlen(replace);
+	unsigned next_arg = 0u;
+	const char* it = format;
+	const char* next;
+	while((next = strstr(it, replace))) {
+		if(next > it && next[-1] == '\\' && next[len] == '\\') { // escaped
+			dlg_arg_sink_append(&sink, it, (size_t) (next - it - 1));
+			dlg_arg_sink_append(&sink, replace, len);
+			it = next + len + 1;
+			continue;
+		}
+
+		dlg_arg_sink_append(&sink, it, (size_t) (next - it));
+		if(next_arg < count) {
+			print_arg(&sink, &args[next_arg++]);
+		} else {
+			dlg_arg_sink_append(&sink, replace, len);
+		}
+
+		it = next + len;
+	}
+
+	dlg_arg_sink_append(&sink, it, strlen(it));
+	counter_add(&data->counters.bytes_formatted, sink.size);
+
+	if(sink.truncated) {
+		dlg_thread_buffer_truncate();
+	} else {
+		data->buffer[sink.size] = '\0';
+		data->format_length = sink.size;
+	}
+
+	if(start) {
+		data->format_ns = get_nsecs() - start;
+	}
+
+	return data->buffer;
+}
+
+// Pushes the tags of the context, the ones of its parents first.
+static void push_context_tags(struct dlg_data* data, const struct dlg_context* context) {
+	if(!context) {
+		return;
+	}
+
+	push_context_tags(data, context->parent);
+	for(const char* const* tag = context->tags; tag && *tag; ++tag) {
+		vec_push(data->tags, *tag);
+	}
+}
+
+void dlg__do_log(enum dlg_level lvl, const char* const* tags, const char* file, int line,
+		const char* func, const char* string, const char* expr) {
+	struct dlg_data* data = dlg_data();
+	unsigned int tag_count = 0;
+
+	// push default tags
+	while(tags[tag_count]) {
+		vec_push(data->tags, tags[tag_count++]);
+	}
+
+	// push current global tags
+	for(size_t i = 0; i < vec_size(data->pairs); ++i) {
+		const struct dlg_tag_func_pair pair = data->pairs[i];
+		if(pair.func == NULL || !strcmp(pair.func, func)) {
+			vec_push(data->tags, pair.tag);
+		}
+	}
+
+	push_context_tags(data, data->context);
+
+	// push call-specific tags, skip first terminating NULL
+	++tag_count;
+	while(tags[tag_count]) {
+		vec_push(data->tags, tags[tag_count++]);
+	}
+
+	vec_push(data->tags, NULL); // terminating NULL
+	struct dlg_origin origin;
+	origin.level = lvl;
+	origin.file = file;
+	origin.line = line;
+	origin.func = func;
+	origin.expr = expr;
+	origin.tags = data->tags;
+
+	// taken over from the formatting, so that nothing stale is left
+	// when the thread buffer is formatted outside of a log call
+	const char* format = data->format;
+	size_t length = (string && string == data->buffer &&
+		data->format_length != format_no_length) ? data->format_length :
+		(string ? strlen(string) : 0u);
+	data->format = NULL;
+	data->format_length = format_no_length;
+
+	counter_add(&data->counters.records[lvl], 1);
+	bool batched = g_batch_handler || (data->batch.entries && vec_size(data->batch.entries));
+	bool timing = atomic_load_relaxed(&g_stats_timing);
+	bool profiling = atomic_load_relaxed(&g_profiling);
+	if(timing || profiling) {
+		uint64_t start = get_nsecs();
+		if(batched) {
+			batch_push(data, &origin, string, length, format);
+		} else {
+			dispatch(data, &origin, string, length, format, data->context);
+		}
+		uint64_t ns = get_nsecs() - start;
+		if(timing) {
+			counter_add(&data->counters.handler_ns, ns);
+		}
+		if(profiling) {
+			struct dlg_callsite* site = callsite_get(&data->profile, file, func, line);
+			counter_add(&site->hits, 1);
+			counter_add(&site->bytes, length);
+			counter_add(&site->format_ns, data->format_ns);
+			counter_add(&site->handler_ns, ns);
+		}
+	} else if(batched) {
+		batch_push(data, &origin, string, length, format);
+	} else {
+		dispatch(data, &origin, string, length, format, data->context);
+	}
+
+	data->format_ns = 0;
+	data->format = NULL;
+	vec_clear(data->tags);
+	buffer_decay(data, string);
+}
+
+bool dlg__check_level(enum dlg_level level, enum dlg_level min) {
+	if(level >= min) {
+		return true;
+	}
+
+	dlg__count_filtered();
+	return false;
+}
+
+void dlg__count_filtered(void) {
+	counter_add(&dlg_data()->counters.filtered, 1);
+}
+
+// runtime filter
+#define DLG_LEVEL_OFF 6u
+
+enum filter_kind {
+	filter_kind_any,
+	filter_kind_tag,
+	filter_kind_file,
+	filter_kind_func,
+};
+
+struct filter_rule {
+	enum filter_kind kind;
+	const char* pattern; // points into dlg_filter.strings
+	unsigned level;
+};
+
+// Decision table, the first matching rule decides.
+struct dlg_filter {
+	struct filter_rule* rules;
+	unsigned count;
+	char* strings;
+};
+
+static void filter_free(struct dlg_filter* filter) {
+	if(filter) {
+		free(filter->rules);
+		free(filter->strings);
+		free(filter);
+	}
+}
+
+// glob matching, '*' matches any sequence, '?' any single char
+static bool glob_match(const char* pattern, const char* str) {
+	const char* star = NULL;
+	const char* retry = NULL;
+	while(*str) {
+		if(*pattern == '*') {
+			star = pattern++;
+			retry = str;
+		} else if(*pattern == '?' || *pattern == *str) {
+			++pattern;
+			++str;
+		} else if(star) {
+			pattern = star + 1;
+			str = ++retry;
+		} else {
+			return false;
+		}
+	}
+
+	while(*pattern == '*') {
+		++pattern;
+	}
+	return !*pattern;
+}
+
+static char* trim(char* str) {
+	while(*str == ' ' || *str == '\t' || *str == '\r') {
+		++str;
+	}
+
+	size_t len = strlen(str);
+	while(len && (str[len - 1] == ' ' || str[len - 1] == '\t' || str[len - 1] == '\r')) {
+		str[--len] = '\0';
+	}
+	return str;
+}
+
+static bool parse_level(const char* name, unsigned* level) {
+	static const char* const names[] = {"trace", "debug", "info", "warn",
+		"error", "fatal", "off"};
+	for(unsigned i = 0u; i < sizeof(names) / sizeof(names[0]); ++i) {
+		if(!strcmp(name, names[i])) {
+			*level = i;
 			return true;
 		}
 	}
+	return false;
+}
+
+// Parses the given filter expression. Returns NULL and prints an
+// error on failure. An empty filter (without rules) is valid.
+static struct dlg_filter* filter_parse(const char* expr) {
+	struct dlg_filter* filter = (struct dlg_filter*) xalloc(sizeof(*filter));
+	size_t len = strlen(expr);
+	filter->strings = (char*) xalloc(len + 1);
+	memcpy(filter->strings, expr, len);
+
+	// strip comments, a rule per ',' or newline
+	unsigned cap = 1u;
+	for(char* it = filter->strings; *it; ++it) {
+		if(*it == '#') {
+			while(*it && *it != '\n') {
+				*(it++) = ' ';
+			}
+			if(!*it) {
+				break;
+			}
+		}
+		if(*it == ',' || *it == '\n') {
+			*it = '\0';
+			++cap;
+		}
+	}
+
+	filter->rules = (struct filter_rule*) xalloc(cap * sizeof(*filter->rules));
+	char* rule = filter->strings;
+	for(unsigned i = 0u; i < cap; ++i) {
+		size_t rule_len = strlen(rule);
+		char* next = rule + rule_len + 1;
+		rule = trim(rule);
+		if(!*rule) {
+			rule = next;
+			continue;
+		}
+
+		struct filter_rule* parsed = &filter->rules[filter->count];
+		char* op = strstr(rule, ">=");
+		const char* level = rule;
+		char* selector = (char*) "*";
+		if(op) {
+			*op = '\0';
+			selector = trim(rule);
+			level = trim(op + 2);
+		}
+
+		if(!parse_level(level, &parsed->level) || !*selector) {
+			fprintf(stderr, "dlg: invalid filter rule '%s>=%s'\n", selector, level);
+			filter_free(filter);
+			return NULL;
+		}
+
+		parsed->pattern = selector;
+		if(!strcmp(selector, "*")) {
+			parsed->kind = filter_kind_any;
+		} else if(!strncmp(selector, "file:", 5)) {
+			parsed->kind = filter_kind_file;
+			parsed->pattern = selector + 5;
+		} else if(!strncmp(selector, "func:", 5)) {
+			parsed->kind = filter_kind_func;
+			parsed->pattern = selector + 5;
+		} else if(!strncmp(selector, "tag:", 4)) {
+			parsed->kind = filter_kind_tag;
+			parsed->pattern = selector + 4;
+		} else {
+			parsed->kind = filter_kind_tag;
+		}
+
+		++filter->count;
+		rule = next;
+	}
+
+	return filter;
+}
 
+// Matches the tags as created by DLG_CREATE_TAGS: the default tags
+// and the call tags, both terminated by NULL.
+static bool filter_match_tags(const char* pattern, const char* const* tags) {
+	for(unsigned list = 0u; list < 2; ++list) {
+		for(; *tags; ++tags) {
+			if(glob_match(pattern, *tags)) {
+				return true;
+			}
+		}
+		++tags;
+	}
 	return false;
 }
 
-char** dlg_thread_buffer(size_t** size) {
-	struct dlg_data* data = dlg_data();
-	if(size) {
-		*size = &data->buffer_size;
+static unsigned filter_decide(const struct dlg_filter* filter,
+		const char* const* tags, const char* file, const char* func) {
+	if(!filter) {
+		return dlg_level_trace;
 	}
-	return &data->buffer;
+
+	for(unsigned i = 0u; i < filter->count; ++i) {
+		const struct filter_rule* rule = &filter->rules[i];
+		bool match = false;
+		switch(rule->kind) {
+			case filter_kind_any: match = true; break;
+			case filter_kind_tag: match = filter_match_tags(rule->pattern, tags); break;
+			case filter_kind_file: match = file && glob_match(rule->pattern, file); break;
+			case filter_kind_func: match = func && glob_match(rule->pattern, func); break;
+		}
+
+		if(match) {
+			return rule->level;
+		}
+	}
+
+	return dlg_level_trace;
 }
 
-void dlg_set_handler(dlg_handler handler, void* data) {
-	g_handler = handler;
-	g_data = data;
+static void filter_swap(struct dlg_filter* filter) {
+	lock_global();
+	struct dlg_filter* old = g_filter;
+	g_filter = filter;
+	atomic_store_uint(&dlg__filter_gen, dlg__filter_gen + 1);
+	unlock_global();
+	filter_free(old);
 }
 
-dlg_handler dlg_get_handler(void** data) {
-	*data = g_data;
-	return g_handler;
+// Applies the filter from the environment once.
+static void filter_init(void) {
+	lock_global();
+	bool init = !g_filter_init;
+	atomic_store_uint(&g_filter_init, 1u);
+	unlock_global();
+
+	if(!init) {
+		return;
+	}
+
+	const char* expr = getenv("DLG_FILTER");
+	const char* path = getenv("DLG_FILTER_FILE");
+	if(expr) {
+		dlg_set_filter(expr);
+	} else if(path) {
+		dlg_watch_filter(path);
+	}
 }
 
-const char* dlg__printf_format(const char* str, ...) {
-	va_list vlist;
-	va_start(vlist, str);
+int dlg__filter_update(unsigned* cache, const char* const* tags,
+		const char* file, const char* func) {
+	if(!atomic_load_uint(&g_filter_init)) {
+		filter_init();
+	}
 
-	va_list vlistcopy;
-	va_copy(vlistcopy, vlist);
-	int needed = vsnprintf(NULL, 0, str, vlist);
-	if(needed < 0) {
-		printf("dlg__printf_format: invalid format given\n");
-		va_end(vlist);
-		va_end(vlistcopy);
+	lock_global();
+	unsigned level = filter_decide(g_filter, tags, file, func);
+	atomic_store_uint(cache, (dlg__filter_gen << 3) | level);
+	unlock_global();
+	return (int) level;
+}
+
+bool dlg_set_filter(const char* expr) {
+	filter_init();
+	struct dlg_filter* filter = NULL;
+	if(expr && *expr) {
+		filter = filter_parse(expr);
+		if(!filter) {
+			return false;
+		}
+	}
+
+	filter_swap(filter);
+	return true;
+}
+
+// Reads the whole file, returns NULL on error. Must be freed.
+static char* read_file(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if(!file) {
 		return NULL;
 	}
 
-	va_end(vlist);
+	size_t size = 0u;
+	size_t cap = 256u;
+	char* buf = (char*) xalloc(cap);
+	size_t read;
+	while((read = fread(buf + size, 1, cap - size - 1, file)) > 0) {
+		size += read;
+		if(size + 1 == cap) {
+			cap *= 2;
+			buf = (char*) xrealloc(buf, cap);
+		}
+	}
+
+	fclose(file);
+	buf[size] = '\0';
+	return buf;
+}
 
-	size_t* buf_size;
-	char** buf = dlg_thread_buffer(&buf_size);
-	if(*buf_size <= (unsigned int) needed) {
-		*buf_size = (needed + 1) * 2;
-		*buf = (char*) xrealloc(*buf, *buf_size);
+bool dlg_load_filter(const char* path) {
+	char* expr = read_file(path);
+	if(!expr) {
+		fprintf(stderr, "dlg: could not read filter file '%s'\n", path);
+		return false;
 	}
 
-	vsnprintf(*buf, *buf_size, str, vlistcopy);
-	va_end(vlistcopy);
+	bool ret = dlg_set_filter(expr);
+	free(expr);
+	return ret;
+}
 
-	return *buf;
+unsigned dlg_filter_generation(void) {
+	return atomic_load_uint(&dlg__filter_gen);
 }
 
-void dlg__do_log(enum dlg_level lvl, const char* const* tags, const char* file, int line,
-		const char* func, const char* string, const char* expr) {
-	struct dlg_data* data = dlg_data();
-	unsigned int tag_count = 0;
+// thread level override, read by the log macros
+#ifdef DLG__THREAD_LEVEL_VAR
+	__thread int dlg__thread_level = -1;
+	__thread unsigned long long* dlg__thread_filtered = NULL;
+	#define thread_level() (&dlg__thread_level)
+#else
+	#define thread_level() (&dlg_data()->level)
+#endif
 
-	// push default tags
-	while(tags[tag_count]) {
-		vec_push(data->tags, tags[tag_count++]);
+int dlg_set_thread_level(int level) {
+	int* current = thread_level();
+	int prev = *current;
+	*current = (level < 0) ? -1 : (level > (int) DLG_LEVEL_OFF ? (int) DLG_LEVEL_OFF : level);
+	return prev;
+}
+
+int dlg_get_thread_level(void) {
+	return *thread_level();
+}
+
+#ifdef __linux__
+
+struct filter_watch {
+	pthread_t thread;
+	int inotify;
+	int stop[2]; // pipe
+	char* path;
+	const char* name; // file name in path
+};
+
+static struct filter_watch* g_filter_watch = NULL;
+
+static void* filter_watch_thread(void* dwatch) {
+	struct filter_watch* watch = (struct filter_watch*) dwatch;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct pollfd fds[2] = {
+		{watch->inotify, POLLIN, 0},
+		{watch->stop[0], POLLIN, 0},
+	};
+
+	while(poll(fds, 2, -1) >= 0 || errno == EINTR) {
+		if(fds[1].revents) {
+			break;
+		}
+		if(!(fds[0].revents & POLLIN)) {
+			continue;
+		}
+
+		ssize_t len = read(watch->inotify, buf, sizeof(buf));
+		bool reload = false;
+		for(ssize_t off = 0; off < len; ) {
+			const struct inotify_event* ev = (const struct inotify_event*) (buf + off);
+			if(ev->len && !strcmp(ev->name, watch->name)) {
+				reload = true;
+			}
+			off += (ssize_t) (sizeof(*ev) + ev->len);
+		}
+
+		if(reload) {
+			dlg_load_filter(watch->path);
+		}
 	}
 
-	// push current global tags
-	for(size_t i = 0; i < vec_size(data->pairs); ++i) {
-		const struct dlg_tag_func_pair pair = data->pairs[i];
-		if(pair.func == NULL || !strcmp(pair.func, func)) {
-			vec_push(data->tags, pair.tag);
+	return NULL;
+}
+
+static void filter_watch_stop(void) {
+	struct filter_watch* watch = g_filter_watch;
+	if(!watch) {
+		return;
+	}
+
+	ssize_t ret = write(watch->stop[1], "", 1);
+	(void) ret;
+	pthread_join(watch->thread, NULL);
+	close(watch->stop[0]);
+	close(watch->stop[1]);
+	close(watch->inotify);
+	free(watch->path);
+	free(watch);
+	g_filter_watch = NULL;
+}
+
+bool dlg_watch_filter(const char* path) {
+	static bool registered = false;
+	filter_init();
+	filter_watch_stop();
+	if(!path) {
+		return true;
+	}
+
+	bool ret = dlg_load_filter(path);
+	if(!registered) {
+		atexit(filter_watch_stop);
+		registered = true;
+	}
+
+	// watch the directory since editors usually replace the file
+	struct filter_watch* watch = (struct filter_watch*) xalloc(sizeof(*watch));
+	// path, followed by its directory
+	size_t len = strlen(path);
+	watch->path = (char*) xalloc(2 * len + 3);
+	memcpy(watch->path, path, len);
+	char* slash = strrchr(watch->path, '/');
+	char* dir = watch->path + len + 1;
+	if(slash) {
+		watch->name = slash + 1;
+		memcpy(dir, watch->path, (size_t) (slash - watch->path));
+		dir[slash - watch->path] = '\0';
+		if(slash == watch->path) {
+			memcpy(dir, "/", 2);
 		}
+	} else {
+		watch->name = watch->path;
+		memcpy(dir, ".", 2);
 	}
 
-	// push call-specific tags, skip first terminating NULL
-	++tag_count;
-	while(tags[tag_count]) {
-		vec_push(data->tags, tags[tag_count++]);
+	watch->inotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if(watch->inotify < 0 || inotify_add_watch(watch->inotify, dir,
+			IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		goto err_inotify;
 	}
 
-	vec_push(data->tags, NULL); // terminating NULL
-	struct dlg_origin origin;
-	origin.level = lvl;
-	origin.file = file;
-	origin.line = line;
-	origin.func = func;
-	origin.expr = expr;
-	origin.tags = data->tags;
+	if(pipe(watch->stop) != 0) {
+		goto err_inotify;
+	}
 
-	g_handler(&origin, string, g_data);
-	vec_clear(data->tags);
+	if(pthread_create(&watch->thread, NULL, filter_watch_thread, watch) != 0) {
+		close(watch->stop[0]);
+		close(watch->stop[1]);
+		goto err_inotify;
+	}
+
+	g_filter_watch = watch;
+	return ret;
+
+err_inotify:
+	fprintf(stderr, "dlg: could not watch filter file '%s'\n", path);
+	if(watch->inotify >= 0) {
+		close(watch->inotify);
+	}
+	free(watch->path);
+	free(watch);
+	return false;
+}
+
+#else // __linux__
+
+bool dlg_watch_filter(const char* path) {
+	filter_init();
+	return path ? dlg_load_filter(path) : true;
+}
+
+#endif // __linux__
+
+// stats
+void dlg_get_stats(struct dlg_stats* stats) {
+	lock_global();
+	struct dlg_counters sum = g_retired;
+	uint64_t* dst = (uint64_t*) &sum;
+	for(struct dlg_data* data = g_threads; data; data = data->next) {
+		const uint64_t* src = (const uint64_t*) &data->counters;
+		for(size_t i = 0u; i < dlg_counters_count; ++i) {
+			dst[i] += atomic_load_relaxed(&src[i]);
+		}
+		sum.filtered += atomic_load_relaxed(&data->filtered);
+	}
+	stats->threads = g_thread_count;
+	stats->buffer_bytes = 0u;
+	stats->buffer_bytes_max = 0u;
+	for(struct dlg_data* data = g_threads; data; data = data->next) {
+		uint64_t bytes = atomic_load_relaxed(&data->buffer_bytes);
+		stats->buffer_bytes += bytes;
+		if(bytes > stats->buffer_bytes_max) {
+			stats->buffer_bytes_max = bytes;
+		}
+	}
+	unlock_global();
+
+	for(unsigned i = 0u; i < 6; ++i) {
+		stats->records[i] = sum.records[i];
+	}
+	stats->filtered = sum.filtered;
+	stats->bytes_formatted = sum.bytes_formatted;
+	stats->bytes_output = sum.bytes_output;
+	stats->buffer_reallocs = sum.buffer_reallocs;
+	stats->handler_ns = sum.handler_ns;
+	stats->lock_ns = sum.lock_ns;
+	stats->truncated = sum.truncated;
+}
+
+void dlg_set_stats_timing(bool enable) {
+	atomic_store_relaxed(&g_stats_timing, enable ? 1u : 0u);
+}
+
+void dlg_write_stats(FILE* stream) {
+	struct dlg_stats stats;
+	dlg_get_stats(&stats);
+
+	fprintf(stream, "# HELP dlg_records_total Records passed to the log handler.\n");
+	fprintf(stream, "# TYPE dlg_records_total counter\n");
+	for(unsigned i = 0u; i < 6; ++i) {
+		fprintf(stream, "dlg_records_total{level=\"%s\"} %llu\n",
+			level_names[i], stats.records[i]);
+	}
+
+	const struct {
+		const char* name;
+		const char* help;
+		unsigned long long value;
+	} counters[] = {
+		{"dlg_filtered_total", "Log calls and assertions filtered by level or the runtime filter.", stats.filtered},
+		{"dlg_formatted_bytes_total", "Bytes formatted into the thread buffers.", stats.bytes_formatted},
+		{"dlg_output_bytes_total", "Bytes written by the stream output functions.", stats.bytes_output},
+		{"dlg_buffer_reallocations_total", "Thread buffer reallocations.", stats.buffer_reallocs},
+		{"dlg_threads_total", "Threads that used dlg.", stats.threads},
+		{"dlg_truncated_total", "Messages cut off at the thread buffer cap.", stats.truncated},
+	};
+
+	for(unsigned i = 0u; i < sizeof(counters) / sizeof(counters[0]); ++i) {
+		fprintf(stream, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+			counters[i].name, counters[i].help, counters[i].name,
+			counters[i].name, counters[i].value);
+	}
+
+	fprintf(stream, "# HELP dlg_handler_seconds_total Time spent in the log handler.\n"
+		"# TYPE dlg_handler_seconds_total counter\n"
+		"dlg_handler_seconds_total %.9f\n", (double) stats.handler_ns * 1e-9);
+	fprintf(stream, "# HELP dlg_stream_lock_seconds_total Time the stream lock was held.\n"
+		"# TYPE dlg_stream_lock_seconds_total counter\n"
+		"dlg_stream_lock_seconds_total %.9f\n", (double) stats.lock_ns * 1e-9);
+	fprintf(stream, "# HELP dlg_buffer_bytes Memory held by the thread buffers.\n"
+		"# TYPE dlg_buffer_bytes gauge\n"
+		"dlg_buffer_bytes %llu\n", stats.buffer_bytes);
+}
+
+// profiling
+void dlg_set_profiling(bool enable) {
+	atomic_store_relaxed(&g_profiling, enable ? 1u : 0u);
+}
+
+static int callsite_cmp_location(const void* a, const void* b) {
+	const struct dlg_callsite* ca = (const struct dlg_callsite*) a;
+	const struct dlg_callsite* cb = (const struct dlg_callsite*) b;
+	int ret = strcmp(ca->file, cb->file);
+	if(ret == 0) {
+		ret = (ca->line > cb->line) - (ca->line < cb->line);
+	}
+	if(ret == 0) {
+		ret = strcmp(ca->func, cb->func);
+	}
+	return ret;
+}
+
+// most expensive first, then most frequent
+static int callsite_cmp_cost(const void* a, const void* b) {
+	const struct dlg_callsite* ca = (const struct dlg_callsite*) a;
+	const struct dlg_callsite* cb = (const struct dlg_callsite*) b;
+	uint64_t cost_a = ca->format_ns + ca->handler_ns;
+	uint64_t cost_b = cb->format_ns + cb->handler_ns;
+	if(cost_a != cost_b) {
+		return cost_a < cost_b ? 1 : -1;
+	}
+	if(ca->hits != cb->hits) {
+		return ca->hits < cb->hits ? 1 : -1;
+	}
+	return callsite_cmp_location(a, b);
+}
+
+static void callsite_collect(struct dlg_callsite** sites, size_t* count,
+		size_t* cap, const struct dlg_callsite_table* table) {
+	for(unsigned i = 0u; i < table->cap; ++i) {
+		const struct dlg_callsite* entry = &table->entries[i];
+		const char* file = atomic_load_ptr(&entry->file);
+		if(!file) {
+			continue;
+		}
+
+		if(*count == *cap) {
+			*cap = *cap ? 2 * *cap : 64;
+			*sites = (struct dlg_callsite*) xrealloc(*sites, *cap * sizeof(**sites));
+		}
+
+		struct dlg_callsite* site = &(*sites)[(*count)++];
+		site->file = file;
+		site->func = entry->func;
+		site->line = entry->line;
+		site->hits = atomic_load_relaxed(&entry->hits);
+		site->bytes = atomic_load_relaxed(&entry->bytes);
+		site->format_ns = atomic_load_relaxed(&entry->format_ns);
+		site->handler_ns = atomic_load_relaxed(&entry->handler_ns);
+	}
+}
+
+void dlg_profile_report(FILE* stream, unsigned top) {
+	stream = stream ? stream : stderr;
+	struct dlg_callsite* sites = NULL;
+	size_t count = 0u;
+	size_t cap = 0u;
+
+	lock_global();
+	for(struct dlg_data* data = g_threads; data; data = data->next) {
+		const struct dlg_callsite_table* table = atomic_load_ptr(&data->profile);
+		if(table) {
+			callsite_collect(&sites, &count, &cap, table);
+		}
+	}
+	if(g_retired_profile) {
+		callsite_collect(&sites, &count, &cap, g_retired_profile);
+	}
+	unlock_global();
+
+	// merge the entries of the same callsite from different threads.
+	// Compares the strings since the same file may have different
+	// addresses in different translation units.
+	size_t merged = 0u;
+	uint64_t total_hits = 0u;
+	if(count) {
+		qsort(sites, count, sizeof(*sites), callsite_cmp_location);
+		for(size_t i = 1u; i < count; ++i) {
+			struct dlg_callsite* to = &sites[merged];
+			if(callsite_cmp_location(to, &sites[i]) == 0) {
+				to->hits += sites[i].hits;
+				to->bytes += sites[i].bytes;
+				to->format_ns += sites[i].format_ns;
+				to->handler_ns += sites[i].handler_ns;
+			} else {
+				sites[++merged] = sites[i];
+			}
+		}
+
+		++merged;
+		qsort(sites, merged, sizeof(*sites), callsite_cmp_cost);
+	}
+
+	for(size_t i = 0u; i < merged; ++i) {
+		total_hits += sites[i].hits;
+	}
+
+	fprintf(stream, "dlg profile: %zu callsites, %llu records\n", merged,
+		(unsigned long long) total_hits);
+	fprintf(stream, "%10s %12s %12s %12s %10s  %s\n", "hits", "bytes",
+		"format_us", "handler_us", "ns/record", "callsite");
+
+	size_t shown = (top && top < merged) ? top : merged;
+	for(size_t i = 0u; i < shown; ++i) {
+		const struct dlg_callsite* site = &sites[i];
+		uint64_t cost = site->format_ns + site->handler_ns;
+		fprintf(stream, "%10llu %12llu %12.1f %12.1f %10llu  %s:%u %s\n",
+			(unsigned long long) site->hits, (unsigned long long) site->bytes,
+			(double) site->format_ns * 1e-3, (double) site->handler_ns * 1e-3,
+			(unsigned long long) (site->hits ? cost / site->hits : 0u),
+			site->file, site->line, site->func);
+	}
+
+	free(sites);
+}
+
+static FILE* g_profile_exit_stream = NULL;
+static unsigned g_profile_exit_top = 0u;
+
+static void profile_report_exit(void) {
+	dlg_profile_report(g_profile_exit_stream, g_profile_exit_top);
+}
+
+void dlg_profile_report_at_exit(FILE* stream, unsigned top) {
+	static bool registered = false;
+	g_profile_exit_stream = stream;
+	g_profile_exit_top = top;
+	if(!registered) {
+		atexit(profile_report_exit);
+		registered = true;
+	}
+}
+
+#ifdef DLG_OS_UNIX
+
+struct stats_dump {
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool stop;
+	char* path;
+	char* tmp_path;
+	unsigned interval_ms;
+};
+
+static struct stats_dump* g_stats_dump = NULL;
+
+static void stats_dump_write(struct stats_dump* dump) {
+	FILE* file = fopen(dump->tmp_path, "w");
+	if(!file) {
+		return;
+	}
+
+	dlg_write_stats(file);
+	if(fclose(file) == 0) {
+		rename(dump->tmp_path, dump->path);
+	}
+}
+
+static void* stats_dump_thread(void* ddump) {
+	struct stats_dump* dump = (struct stats_dump*) ddump;
+	pthread_mutex_lock(&dump->mutex);
+	while(!dump->stop) {
+		stats_dump_write(dump);
+
+		struct timespec until;
+		clock_gettime(CLOCK_REALTIME, &until);
+		until.tv_sec += dump->interval_ms / 1000;
+		until.tv_nsec += (long) (dump->interval_ms % 1000) * 1000000l;
+		if(until.tv_nsec >= 1000000000l) {
+			until.tv_nsec -= 1000000000l;
+			++until.tv_sec;
+		}
+
+		while(!dump->stop && pthread_cond_timedwait(&dump->cond,
+				&dump->mutex, &until) == 0);
+	}
+	pthread_mutex_unlock(&dump->mutex);
+
+	stats_dump_write(dump); // final state
+	return NULL;
+}
+
+static void stats_dump_stop(void) {
+	struct stats_dump* dump = g_stats_dump;
+	if(!dump) {
+		return;
+	}
+
+	pthread_mutex_lock(&dump->mutex);
+	dump->stop = true;
+	pthread_cond_signal(&dump->cond);
+	pthread_mutex_unlock(&dump->mutex);
+	pthread_join(dump->thread, NULL);
+
+	pthread_cond_destroy(&dump->cond);
+	pthread_mutex_destroy(&dump->mutex);
+	free(dump->path);
+	free(dump->tmp_path);
+	free(dump);
+	g_stats_dump = NULL;
+}
+
+bool dlg_dump_stats(const char* path, unsigned interval_ms) {
+	static bool registered = false;
+	stats_dump_stop();
+	if(!path) {
+		return true;
+	}
+
+	if(!registered) {
+		atexit(stats_dump_stop);
+		registered = true;
+	}
+
+	struct stats_dump* dump = (struct stats_dump*) xalloc(sizeof(*dump));
+	size_t len = strlen(path);
+	dump->path = (char*) xalloc(len + 1);
+	memcpy(dump->path, path, len);
+	dump->tmp_path = (char*) xalloc(len + 5);
+	memcpy(dump->tmp_path, path, len);
+	memcpy(dump->tmp_path + len, ".tmp", 4);
+	dump->interval_ms = interval_ms ? interval_ms : 1000;
+	pthread_mutex_init(&dump->mutex, NULL);
+	pthread_cond_init(&dump->cond, NULL);
+
+	if(pthread_create(&dump->thread, NULL, stats_dump_thread, dump) != 0) {
+		pthread_cond_destroy(&dump->cond);
+		pthread_mutex_destroy(&dump->mutex);
+		free(dump->path);
+		free(dump->tmp_path);
+		free(dump);
+		return false;
+	}
+
+	g_stats_dump = dump;
+	return true;
+}
+
+#else // DLG_OS_UNIX
+
+bool dlg_dump_stats(const char* path, unsigned interval_ms) {
+	(void) interval_ms;
+	return !path;
 }
 
+#endif // DLG_OS_UNIX
+
 #ifdef _MSC_VER
 // shitty msvc compatbility
 // meson gives us sane paths (separated by '/') while on MSVC,
@@ -801,3 +3066,8 @@ const char* dlg__strip_root_path(const char* file, const char* base) {
 
 	return file;
 }
+
+const char* dlg__cache_file(const char** cache, const char* file) {
+	__atomic_store_n(cache, file, __ATOMIC_RELAXED);
+	return file;
+}
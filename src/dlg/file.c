@@ -0,0 +1,272 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Needed for fdatasync (and F_FULLFSYNC on apple).
+#define _POSIX_C_SOURCE 200809L
+#if defined(__APPLE__)
+	#define _DARWIN_C_SOURCE
+#endif
+
+#include <dlg/file.h>
+#include <dlg/output.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct dlg_file {
+	int fd;
+	unsigned flags;
+	struct dlg_file_policy policy;
+	pthread_mutex_t mutex;
+	pthread_cond_t synced_cond; // signaled when a sync is done
+
+	char* buffer; // lazy records
+	size_t size;
+	size_t buffer_size;
+
+	// Writes are numbered. All data of writes up to written is in the
+	// kernel, the ones up to synced on stable storage. A failed sync sets
+	// failed to the writes it should have covered.
+	uint64_t written;
+	uint64_t synced;
+	uint64_t failed;
+	bool syncing; // a leader is in sync_fd, without holding the mutex
+
+	unsigned long long syncs;
+	unsigned long long errors;
+};
+
+static int sync_fd(int fd) {
+#if defined(__APPLE__)
+	// fsync only hands the data to the drive, which may cache it
+	if(fcntl(fd, F_FULLFSYNC) == 0) {
+		return 0;
+	}
+	return fsync(fd);
+#elif defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+	return fdatasync(fd);
+#else
+	return fsync(fd);
+#endif
+}
+
+// Writes the given buffers completely, continuing after short writes.
+static bool write_all(int fd, struct iovec* iov, int count) {
+	while(count > 0) {
+		ssize_t ret = writev(fd, iov, count);
+		if(ret < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		size_t done = (size_t) ret;
+		while(count > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			++iov;
+			--count;
+		}
+
+		if(count > 0) {
+			iov->iov_base = (char*) iov->iov_base + done;
+			iov->iov_len -= done;
+		}
+	}
+
+	return true;
+}
+
+// Writes the buffered records followed by the given data with a single
+// writev. The buffer is emptied even on error.
+static bool write_locked(struct dlg_file* file, const char* data, size_t size) {
+	struct iovec iov[2] = {
+		{file->buffer, file->size},
+		{(void*) data, size},
+	};
+
+	if(!file->size && !size) {
+		return true;
+	}
+
+	file->size = 0u;
+	if(!write_all(file->fd, iov, 2)) {
+		++file->errors;
+		return false;
+	}
+
+	++file->written;
+	return true;
+}
+
+// Waits until all writes up to target are on stable storage, see the
+// group commit in file.h. Returns false if the sync covering them failed.
+static bool sync_locked(struct dlg_file* file, uint64_t target) {
+	while(file->synced < target && file->failed < target) {
+		if(file->syncing) {
+			pthread_cond_wait(&file->synced_cond, &file->mutex);
+			continue;
+		}
+
+		// leader: covers the writes of all threads waiting for the
+		// previous sync as well
+		uint64_t covers = file->written;
+		file->syncing = true;
+		pthread_mutex_unlock(&file->mutex);
+		int ret = sync_fd(file->fd);
+		pthread_mutex_lock(&file->mutex);
+
+		file->syncing = false;
+		++file->syncs;
+		if(ret == 0) {
+			file->synced = covers;
+		} else {
+			file->failed = covers;
+			++file->errors;
+		}
+
+		pthread_cond_broadcast(&file->synced_cond);
+	}
+
+	return file->synced >= target;
+}
+
+struct dlg_file* dlg_file_create(const char* path,
+		const struct dlg_file_policy* policy, size_t buffer_size, unsigned flags) {
+	buffer_size = buffer_size ? buffer_size : 64u * 1024u;
+	int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "dlg_file_create: open: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	struct dlg_file* file = (struct dlg_file*) calloc(1, sizeof(*file));
+	char* buffer = (char*) malloc(buffer_size);
+	if(!file || !buffer) {
+		fprintf(stderr, "dlg_file_create: allocation failed\n");
+		free(file);
+		free(buffer);
+		close(fd);
+		return NULL;
+	}
+
+	file->fd = fd;
+	file->flags = flags;
+	file->buffer = buffer;
+	file->buffer_size = buffer_size;
+	if(policy) {
+		file->policy = *policy;
+	} else {
+		for(unsigned i = 0u; i < 6u; ++i) {
+			file->policy.levels[i] = (i >= dlg_level_error) ? dlg_durability_sync :
+				(i == dlg_level_warn) ? dlg_durability_write : dlg_durability_lazy;
+		}
+	}
+
+	pthread_mutex_init(&file->mutex, NULL);
+	pthread_cond_init(&file->synced_cond, NULL);
+	return file;
+}
+
+void dlg_file_destroy(struct dlg_file* file) {
+	if(!file) {
+		return;
+	}
+
+	dlg_file_sync(file);
+	pthread_cond_destroy(&file->synced_cond);
+	pthread_mutex_destroy(&file->mutex);
+	close(file->fd);
+	free(file->buffer);
+	free(file);
+}
+
+bool dlg_file_write(struct dlg_file* file, const char* data, size_t size,
+		enum dlg_durability durability) {
+	pthread_mutex_lock(&file->mutex);
+	if(durability == dlg_durability_lazy && size <= file->buffer_size - file->size) {
+		memcpy(file->buffer + file->size, data, size);
+		file->size += size;
+		pthread_mutex_unlock(&file->mutex);
+		return true;
+	}
+
+	bool ok = write_locked(file, data, size);
+	if(ok && durability == dlg_durability_sync) {
+		ok = sync_locked(file, file->written);
+	}
+
+	pthread_mutex_unlock(&file->mutex);
+	return ok;
+}
+
+bool dlg_file_sync(struct dlg_file* file) {
+	pthread_mutex_lock(&file->mutex);
+	bool ok = write_locked(file, NULL, 0u);
+	ok = sync_locked(file, file->written) && ok;
+	pthread_mutex_unlock(&file->mutex);
+	return ok;
+}
+
+// Renders the record into buf, see dlg_generic_output_buf.
+static void render_buf(struct dlg_file* file, char* buf, size_t* size,
+		const struct dlg_origin* origin, const char* string) {
+	if(file->flags & dlg_file_json) {
+		dlg_generic_output_json_buf(buf, size, origin, string);
+	} else {
+		dlg_generic_output_buf(buf, size, dlg_output_file_line | dlg_output_newline,
+			origin, string, dlg_default_output_styles);
+	}
+}
+
+// Renders the record into the stack buffer or, if it does not fit,
+// into *heap. Returns the size.
+static size_t render(struct dlg_file* file, const struct dlg_origin* origin,
+		const char* string, char* stack, size_t stack_size, char** heap) {
+	size_t size = stack_size;
+	render_buf(file, stack, &size, origin, string);
+	if(size < stack_size - 1) {
+		return size;
+	}
+
+	render_buf(file, NULL, &size, origin, string);
+	if(!(*heap = (char*) malloc(size + 1))) {
+		return stack_size - 1;
+	}
+
+	++size;
+	render_buf(file, *heap, &size, origin, string);
+	return size;
+}
+
+void dlg_file_output(const struct dlg_origin* origin, const char* string, void* data) {
+	struct dlg_file* file = (struct dlg_file*) data;
+
+	// render outside the lock, usually on the stack
+	char stack[1024];
+	char* heap = NULL;
+	size_t size = render(file, origin, string, stack, sizeof(stack), &heap);
+	dlg_file_write(file, heap ? heap : stack, size, file->policy.levels[origin->level]);
+	free(heap);
+}
+
+unsigned long long dlg_file_syncs(struct dlg_file* file) {
+	pthread_mutex_lock(&file->mutex);
+	unsigned long long ret = file->syncs;
+	pthread_mutex_unlock(&file->mutex);
+	return ret;
+}
+
+unsigned long long dlg_file_errors(struct dlg_file* file) {
+	pthread_mutex_lock(&file->mutex);
+	unsigned long long ret = file->errors;
+	pthread_mutex_unlock(&file->mutex);
+	return ret;
+}
@@ -0,0 +1,337 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+#include <dlg/index.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct dlg_index {
+	FILE* file;
+	unsigned block_size;
+	struct dlg_index_block block; // current, not yet written
+};
+
+static const char* const level_names[] = {
+	"trace", "debug", "info", "warn", "error", "fatal"
+};
+
+static void block_reset(struct dlg_index_block* block, uint64_t offset) {
+	memset(block, 0, sizeof(*block));
+	block->offset = offset;
+	block->time_min = INT64_MAX;
+	block->time_max = INT64_MIN;
+}
+
+static void block_write(struct dlg_index* index) {
+	if(index->block.records) {
+		fwrite(&index->block, sizeof(index->block), 1, index->file);
+		fflush(index->file);
+	}
+}
+
+// Returns whether the file is an index we can append to.
+static bool index_valid(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if(!file) {
+		return false;
+	}
+
+	struct dlg_index_header header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == DLG_INDEX_MAGIC && header.version == DLG_INDEX_VERSION;
+
+	// a crash may have left a partial entry
+	long size = (fseek(file, 0, SEEK_END) == 0) ? ftell(file) : -1;
+	valid = valid && size >= (long) sizeof(header) &&
+		((size_t) size - sizeof(header)) % sizeof(struct dlg_index_block) == 0;
+
+	fclose(file);
+	return valid;
+}
+
+struct dlg_index* dlg_index_create(const char* log_path, unsigned block_size,
+		bool truncate) {
+	size_t len = strlen(log_path);
+	char* path = (char*) malloc(len + 5);
+	if(!path) {
+		return NULL;
+	}
+
+	memcpy(path, log_path, len);
+	memcpy(path + len, ".idx", 5);
+
+	block_size = block_size ? block_size : 64u * 1024u;
+	bool append = !truncate && index_valid(path);
+	FILE* file = fopen(path, append ? "ab" : "wb");
+	if(!file) {
+		fprintf(stderr, "dlg_index_create: could not open '%s'\n", path);
+		free(path);
+		return NULL;
+	}
+
+	free(path);
+	if(!append) {
+		struct dlg_index_header header = {DLG_INDEX_MAGIC, DLG_INDEX_VERSION, block_size, 0u};
+		fwrite(&header, sizeof(header), 1, file);
+		fflush(file);
+	}
+
+	struct dlg_index* index = (struct dlg_index*) calloc(1, sizeof(*index));
+	if(!index) {
+		fclose(file);
+		return NULL;
+	}
+
+	index->file = file;
+	index->block_size = block_size;
+	block_reset(&index->block, 0u);
+	return index;
+}
+
+void dlg_index_destroy(struct dlg_index* index) {
+	if(index) {
+		block_write(index);
+		fclose(index->file);
+		free(index);
+	}
+}
+
+void dlg_index_add(struct dlg_index* index, unsigned long long offset, size_t size,
+		const struct dlg_index_record* record) {
+	struct dlg_index_block* block = &index->block;
+	if(block->records && block->offset + block->size != offset) {
+		block_write(index);
+		block_reset(block, offset);
+	} else if(!block->records) {
+		block->offset = offset;
+	}
+
+	++block->records;
+	block->size += size;
+	if(!record) {
+		block->levels |= DLG_INDEX_UNKNOWN;
+	} else {
+		block->levels |= 1u << record->level;
+		if(record->time != DLG_INDEX_NO_TIME) {
+			block->time_min = (record->time < block->time_min) ? record->time : block->time_min;
+			block->time_max = (record->time > block->time_max) ? record->time : block->time_max;
+		}
+
+		// for every tag string
+		const char* end = record->tags + record->tags_size;
+		for(const char* it = record->tags; it < end; ++it) {
+			if(*it != '"') {
+				continue;
+			}
+
+			const char* tag = ++it;
+			while(it < end && *it != '"') {
+				it += (*it == '\\') ? 2 : 1;
+			}
+
+			block->tags |= dlg_index_tag_bit(tag, (size_t) (it - tag));
+		}
+	}
+
+	if(block->size >= index->block_size) {
+		block_write(index);
+		block_reset(block, offset + size);
+	}
+}
+
+bool dlg_index_add_json(struct dlg_index* index, unsigned long long offset,
+		const char* line, size_t size) {
+	struct dlg_index_record record;
+	bool ok = dlg_index_parse(line, size, &record);
+	dlg_index_add(index, offset, size, ok ? &record : NULL);
+	return ok;
+}
+
+// Skips the given literal at *pos, returns false if it isn't there.
+static bool skip(const char* str, size_t size, size_t* pos, const char* lit) {
+	size_t len = strlen(lit);
+	if(size - *pos < len || memcmp(str + *pos, lit, len) != 0) {
+		return false;
+	}
+
+	*pos += len;
+	return true;
+}
+
+// Finds the literal in [str + pos, str + size), returns size if not found.
+static size_t find(const char* str, size_t size, size_t pos, const char* lit) {
+	size_t len = strlen(lit);
+	for(; pos + len <= size; ++pos) {
+		if(str[pos] == lit[0] && memcmp(str + pos, lit, len) == 0) {
+			return pos;
+		}
+	}
+
+	return size;
+}
+
+bool dlg_index_parse(const char* line, size_t size, struct dlg_index_record* record) {
+	size_t pos = 0u;
+	if(!skip(line, size, &pos, "{\"time\":")) {
+		return false;
+	}
+
+	record->time = DLG_INDEX_NO_TIME;
+	if(!skip(line, size, &pos, "null")) {
+		if(!skip(line, size, &pos, "\"")) {
+			return false;
+		}
+
+		size_t end = find(line, size, pos, "\"");
+		if(end == size || !dlg_index_parse_time(line + pos, end - pos, &record->time)) {
+			return false;
+		}
+
+		pos = end + 1;
+	}
+
+	if(!skip(line, size, &pos, ",\"level\":\"")) {
+		return false;
+	}
+
+	size_t end = find(line, size, pos, "\"");
+	unsigned level = 0u;
+	for(; level < sizeof(level_names) / sizeof(level_names[0]); ++level) {
+		if(strlen(level_names[level]) == end - pos &&
+				!memcmp(line + pos, level_names[level], end - pos)) {
+			break;
+		}
+	}
+
+	if(level > dlg_level_fatal) {
+		return false;
+	}
+
+	record->level = (enum dlg_level) level;
+
+	// file and func are escaped strings, so this can't match inside them
+	pos = find(line, size, end, ",\"tags\":[");
+	if(pos == size) {
+		return false;
+	}
+
+	pos += strlen(",\"tags\":[");
+	record->tags = line + pos;
+	for(bool string = false; pos < size; ++pos) {
+		if(string && line[pos] == '\\') {
+			++pos;
+		} else if(line[pos] == '"') {
+			string = !string;
+		} else if(!string && line[pos] == ']') {
+			record->tags_size = (size_t) (line + pos - record->tags);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Parses count digits at *pos.
+static bool digits(const char* str, size_t size, size_t* pos, unsigned count, int* val) {
+	*val = 0;
+	for(unsigned i = 0u; i < count; ++i, ++*pos) {
+		if(*pos == size || str[*pos] < '0' || str[*pos] > '9') {
+			return false;
+		}
+		*val = *val * 10 + (str[*pos] - '0');
+	}
+
+	return true;
+}
+
+// Days since 1970-01-01 of the given date in the proleptic gregorian calendar.
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+	y -= m <= 2;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	unsigned yoe = (unsigned) (y - era * 400);
+	unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + (int64_t) doe - 719468;
+}
+
+bool dlg_index_parse_time(const char* str, size_t size, int64_t* time) {
+	// year, month, day, hour, minute, second
+	static const char seps[] = "--T::";
+	static const unsigned widths[] = {4, 2, 2, 2, 2, 2};
+	int fields[] = {0, 1, 1, 0, 0, 0};
+
+	size_t pos = 0u;
+	unsigned i = 0u;
+	for(; i < 6; ++i) {
+		if(i > 0 && (pos == size || str[pos] == 'Z')) {
+			break;
+		}
+
+		if(i > 0 && str[pos++] != seps[i - 1]) {
+			return false;
+		}
+
+		if(!digits(str, size, &pos, widths[i], &fields[i])) {
+			return false;
+		}
+	}
+
+	int64_t us = 0;
+	if(i == 6 && pos < size && str[pos] == '.') {
+		unsigned count = 0u;
+		for(++pos; pos < size && str[pos] >= '0' && str[pos] <= '9'; ++pos, ++count) {
+			us = (count < 6) ? us * 10 + (str[pos] - '0') : us;
+		}
+
+		for(; count < 6; ++count) {
+			us *= 10;
+		}
+	}
+
+	if(pos < size && str[pos] == 'Z') {
+		++pos;
+	}
+
+	if(i < 3 || pos != size || fields[1] < 1 || fields[1] > 12 || fields[2] < 1 ||
+			fields[2] > 31 || fields[3] > 23 || fields[4] > 59 || fields[5] > 60) {
+		return false;
+	}
+
+	int64_t days = days_from_civil(fields[0], (unsigned) fields[1], (unsigned) fields[2]);
+	int64_t secs = ((days * 24 + fields[3]) * 60 + fields[4]) * 60 + fields[5];
+	*time = secs * 1000000 + us;
+	return true;
+}
+
+bool dlg_index_has_tag(const struct dlg_index_record* record, const char* tag) {
+	size_t len = strlen(tag);
+	const char* end = record->tags + record->tags_size;
+	for(const char* it = record->tags; it < end; ++it) {
+		if(*it != '"') {
+			continue;
+		}
+
+		const char* start = ++it;
+		while(it < end && *it != '"') {
+			it += (*it == '\\') ? 2 : 1;
+		}
+
+		if((size_t) (it - start) == len && !memcmp(start, tag, len)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint64_t dlg_index_tag_bit(const char* tag, size_t size) {
+	// fnv-1a
+	uint64_t hash = 14695981039346656037ull;
+	for(size_t i = 0u; i < size; ++i) {
+		hash = (hash ^ (unsigned char) tag[i]) * 1099511628211ull;
+	}
+
+	return 1ull << (hash % 64u);
+}
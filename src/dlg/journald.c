@@ -0,0 +1,261 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Needed for memfd_create and the file sealing api.
+#define _GNU_SOURCE
+
+#include <dlg/journald.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Upper bound of iovecs used for one record. Tags exceeding it are dropped.
+#define DLG_JOURNALD_MAX_IOV 256
+
+struct dlg_journald {
+	int fd;
+	struct sockaddr_un addr;
+	socklen_t addr_len;
+	char* identifier;
+};
+
+// The iovecs making up a single record.
+// Field values are never copied, only referenced.
+struct jrecord {
+	struct iovec iov[DLG_JOURNALD_MAX_IOV];
+	unsigned count;
+	unsigned char lens[DLG_JOURNALD_MAX_IOV / 4][8]; // binary field lengths
+	unsigned lens_count;
+	size_t size;
+};
+
+struct jpart {
+	const char* str;
+	size_t len;
+};
+
+static void jpush(struct jrecord* rec, const void* data, size_t len) {
+	rec->iov[rec->count].iov_base = (void*) data;
+	rec->iov[rec->count].iov_len = len;
+	rec->size += len;
+	++rec->count;
+}
+
+// Adds a field with the given value parts. Values containing a newline
+// are encoded in the binary format (name, newline, little endian 64-bit
+// length, value), all others as name=value.
+// Returns false (and does not add anything) if there are not enough iovecs.
+static bool jfield(struct jrecord* rec, const char* name,
+		const struct jpart* parts, unsigned count) {
+	if(rec->count + count + 4 > DLG_JOURNALD_MAX_IOV) {
+		return false;
+	}
+
+	bool binary = false;
+	uint64_t len = 0;
+	for(unsigned i = 0; i < count; ++i) {
+		binary |= (memchr(parts[i].str, '\n', parts[i].len) != NULL);
+		len += parts[i].len;
+	}
+
+	jpush(rec, name, strlen(name));
+	if(binary) {
+		unsigned char* le = rec->lens[rec->lens_count++];
+		for(unsigned i = 0; i < 8; ++i) {
+			le[i] = (unsigned char) (len >> (8 * i));
+		}
+
+		jpush(rec, "\n", 1);
+		jpush(rec, le, 8);
+	} else {
+		jpush(rec, "=", 1);
+	}
+
+	for(unsigned i = 0; i < count; ++i) {
+		if(parts[i].len) {
+			jpush(rec, parts[i].str, parts[i].len);
+		}
+	}
+
+	jpush(rec, "\n", 1);
+	return true;
+}
+
+static bool jfield_str(struct jrecord* rec, const char* name, const char* value) {
+	struct jpart part = {value, strlen(value)};
+	return jfield(rec, name, &part, 1);
+}
+
+static bool write_all(int fd, const struct iovec* iov, unsigned count) {
+	for(unsigned i = 0; i < count; ++i) {
+		const char* data = (const char*) iov[i].iov_base;
+		size_t left = iov[i].iov_len;
+		while(left) {
+			ssize_t res = write(fd, data, left);
+			if(res < 0) {
+				if(errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+
+			data += res;
+			left -= (size_t) res;
+		}
+	}
+
+	return true;
+}
+
+// Records that are too large for a single datagram are written into a
+// sealed memfd, which is then passed to journald as the only content.
+static void send_memfd(struct dlg_journald* journald, struct jrecord* rec) {
+	int mfd = memfd_create("dlg-journald", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if(mfd < 0) {
+		return;
+	}
+
+	if(!write_all(mfd, rec->iov, rec->count) ||
+			fcntl(mfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+				F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+		close(mfd);
+		return;
+	}
+
+	union {
+		struct cmsghdr header;
+		char buf[CMSG_SPACE(sizeof(int))];
+	} control;
+	memset(&control, 0, sizeof(control));
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_name = &journald->addr;
+	msg.msg_namelen = journald->addr_len;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &mfd, sizeof(int));
+
+	while(sendmsg(journald->fd, &msg, MSG_NOSIGNAL) < 0 && errno == EINTR);
+	close(mfd);
+}
+
+struct dlg_journald* dlg_journald_create(const char* path, const char* identifier) {
+	path = path ? path : DLG_JOURNALD_SOCKET;
+
+	struct dlg_journald* journald = (struct dlg_journald*) calloc(1, sizeof(*journald));
+	if(!journald) {
+		return NULL;
+	}
+
+	size_t path_len = strlen(path);
+	if(path_len >= sizeof(journald->addr.sun_path)) {
+		fprintf(stderr, "dlg: journald socket path too long: %s\n", path);
+		free(journald);
+		return NULL;
+	}
+
+	journald->fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(journald->fd < 0) {
+		fprintf(stderr, "dlg: failed to create journald socket: %s\n", strerror(errno));
+		free(journald);
+		return NULL;
+	}
+
+	journald->addr.sun_family = AF_UNIX;
+	memcpy(journald->addr.sun_path, path, path_len + 1);
+	journald->addr_len = (socklen_t) (offsetof(struct sockaddr_un, sun_path) + path_len + 1);
+	journald->identifier = identifier ? strdup(identifier) : NULL;
+	return journald;
+}
+
+void dlg_journald_destroy(struct dlg_journald* journald) {
+	if(journald) {
+		close(journald->fd);
+		free(journald->identifier);
+		free(journald);
+	}
+}
+
+void dlg_journald_output(const struct dlg_origin* origin, const char* string,
+		void* data) {
+	static const char* const priorities[] = {"7", "7", "6", "4", "3", "2"};
+	static const char* const levels[] = {
+		"trace", "debug", "info", "warn", "error", "fatal"
+	};
+
+	struct dlg_journald* journald = (struct dlg_journald*) data;
+	struct jrecord rec;
+	rec.count = 0;
+	rec.lens_count = 0;
+	rec.size = 0;
+
+	// same content as the %c conversion of dlg_generic_outputf
+	struct jpart msg[5];
+	unsigned msg_count = 0;
+	if(origin->expr) {
+		msg[msg_count++] = (struct jpart) {"assertion '", 11};
+		msg[msg_count++] = (struct jpart) {origin->expr, strlen(origin->expr)};
+		if(string) {
+			msg[msg_count++] = (struct jpart) {"' failed: '", 11};
+			msg[msg_count++] = (struct jpart) {string, strlen(string)};
+			msg[msg_count++] = (struct jpart) {"'", 1};
+		} else {
+			msg[msg_count++] = (struct jpart) {"' failed", 8};
+		}
+	} else {
+		msg[msg_count++] = (struct jpart) {string ? string : "", string ? strlen(string) : 0};
+	}
+
+	char line[16];
+	snprintf(line, sizeof(line), "%u", origin->line);
+
+	jfield(&rec, "MESSAGE", msg, msg_count);
+	jfield_str(&rec, "PRIORITY", priorities[origin->level]);
+	jfield_str(&rec, "DLG_LEVEL", levels[origin->level]);
+	if(origin->file) {
+		jfield_str(&rec, "CODE_FILE", origin->file);
+	}
+	jfield_str(&rec, "CODE_LINE", line);
+	if(origin->func) {
+		jfield_str(&rec, "CODE_FUNC", origin->func);
+	}
+	if(journald->identifier) {
+		jfield_str(&rec, "SYSLOG_IDENTIFIER", journald->identifier);
+	}
+	if(origin->expr) {
+		jfield_str(&rec, "DLG_EXPR", origin->expr);
+	}
+	for(const char** tags = origin->tags; *tags; ++tags) {
+		if(!jfield_str(&rec, "DLG_TAG", *tags)) {
+			break;
+		}
+	}
+
+	struct msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_name = &journald->addr;
+	mh.msg_namelen = journald->addr_len;
+	mh.msg_iov = rec.iov;
+	mh.msg_iovlen = rec.count;
+
+	ssize_t res;
+	while((res = sendmsg(journald->fd, &mh, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+	if(res < 0 && (errno == EMSGSIZE || errno == ENOBUFS)) {
+		send_memfd(journald, &rec);
+	}
+}
@@ -0,0 +1,431 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Needed for sched_getcpu and syscall.
+#define _GNU_SOURCE
+
+#include <dlg/percpu.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Slot at position p is free for p when seq == p, committed when
+// seq == p + 1 and free for the next round when seq == p + slot_count,
+// like the slots of dlg/shm.h.
+// All pointers of a slot point into the slot itself.
+struct percpu_slot {
+	uint64_t seq;
+	uint64_t time; // CLOCK_MONOTONIC nanoseconds, the merge key
+	struct dlg_origin origin;
+	struct dlg_record_thread thread; // set while calling the handler
+	struct dlg_context context; // flattened fields of the record context
+	const char* string; // may be NULL
+	// followed by the null-terminated tag and field pointer lists and the
+	// strings: thread name, tags, fields and the message
+};
+
+// Cache line aligned, the reserve position has its own line.
+struct percpu_shard {
+	uint64_t write; // next position to reserve
+	char pad0[56];
+	uint64_t read; // next position to drain, only written by the collector
+	uint64_t dropped;
+	char* slots;
+	char pad1[40];
+};
+
+// A committed slot found while draining.
+struct percpu_entry {
+	uint64_t time;
+	uint64_t pos;
+	unsigned shard;
+};
+
+struct dlg_percpu {
+	dlg_handler handler;
+	void* data;
+
+	struct percpu_shard* shards;
+	unsigned shard_count;
+	unsigned slot_count; // power of two
+	unsigned slot_size;
+	char* memory;
+
+	// collector
+	pthread_t thread;
+	unsigned interval_ms;
+	uint32_t stop;
+	uint32_t waiting; // collector is waiting on 'wake' (futex)
+	uint32_t wake;
+
+	// drain state, guarded by the mutex
+	pthread_mutex_t mutex;
+	struct percpu_entry* entries; // shard_count * slot_count
+	uint64_t* ends; // per shard, first position not drained
+};
+
+static long futex(uint32_t* addr, int op, uint32_t val, const struct timespec* timeout) {
+	return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static uint64_t get_nsecs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static unsigned round_pow2(unsigned val) {
+	unsigned ret = 1u;
+	while(ret < val && ret < (1u << 30)) {
+		ret <<= 1;
+	}
+	return ret;
+}
+
+static struct percpu_slot* slot_at(struct dlg_percpu* percpu,
+		struct percpu_shard* shard, uint64_t pos) {
+	size_t off = (size_t) (pos & (percpu->slot_count - 1u)) * percpu->slot_size;
+	return (struct percpu_slot*) (shard->slots + off);
+}
+
+static void* collector(void* data);
+
+struct dlg_percpu* dlg_percpu_create(dlg_handler handler, void* data,
+		unsigned slot_count, unsigned slot_size, unsigned interval_ms) {
+	slot_count = round_pow2(slot_count ? slot_count : 512u);
+	slot_size = slot_size ? slot_size : 512u;
+	slot_size = (slot_size < sizeof(struct percpu_slot) + 64u) ?
+		(unsigned) sizeof(struct percpu_slot) + 64u : slot_size;
+	slot_size = (slot_size + 7u) & ~7u; // keep the pointer lists aligned
+
+	long cpus = sysconf(_SC_NPROCESSORS_CONF);
+	unsigned shard_count = (cpus > 0) ? (unsigned) cpus : 1u;
+
+	struct dlg_percpu* percpu = (struct dlg_percpu*) calloc(1, sizeof(*percpu));
+	if(!percpu) {
+		fprintf(stderr, "dlg_percpu_create: allocation failed\n");
+		return NULL;
+	}
+
+	size_t shard_bytes = (size_t) slot_count * slot_size;
+	if(posix_memalign((void**) &percpu->shards, 64,
+			shard_count * sizeof(*percpu->shards)) != 0) {
+		percpu->shards = NULL;
+	}
+
+	percpu->memory = (char*) calloc(shard_count, shard_bytes);
+	percpu->entries = (struct percpu_entry*) calloc((size_t) shard_count * slot_count,
+		sizeof(*percpu->entries));
+	percpu->ends = (uint64_t*) calloc(shard_count, sizeof(*percpu->ends));
+	if(!percpu->shards || !percpu->memory || !percpu->entries || !percpu->ends) {
+		fprintf(stderr, "dlg_percpu_create: allocation failed\n");
+		free(percpu->shards);
+		free(percpu->memory);
+		free(percpu->entries);
+		free(percpu->ends);
+		free(percpu);
+		return NULL;
+	}
+
+	percpu->handler = handler;
+	percpu->data = data;
+	percpu->shard_count = shard_count;
+	percpu->slot_count = slot_count;
+	percpu->slot_size = slot_size;
+	percpu->interval_ms = interval_ms ? interval_ms : 10u;
+	memset(percpu->shards, 0, shard_count * sizeof(*percpu->shards));
+	for(unsigned i = 0u; i < shard_count; ++i) {
+		struct percpu_shard* shard = &percpu->shards[i];
+		shard->slots = percpu->memory + i * shard_bytes;
+		for(unsigned s = 0u; s < slot_count; ++s) {
+			slot_at(percpu, shard, s)->seq = s;
+		}
+	}
+
+	pthread_mutex_init(&percpu->mutex, NULL);
+	if(pthread_create(&percpu->thread, NULL, collector, percpu) != 0) {
+		fprintf(stderr, "dlg_percpu_create: could not start the collector\n");
+		pthread_mutex_destroy(&percpu->mutex);
+		free(percpu->shards);
+		free(percpu->memory);
+		free(percpu->entries);
+		free(percpu->ends);
+		free(percpu);
+		return NULL;
+	}
+
+	return percpu;
+}
+
+static void wake_collector(struct dlg_percpu* percpu) {
+	// only the first producer noticing the waiting collector wakes it
+	if(__atomic_load_n(&percpu->waiting, __ATOMIC_SEQ_CST) &&
+			__atomic_exchange_n(&percpu->waiting, 0u, __ATOMIC_SEQ_CST)) {
+		__atomic_fetch_add(&percpu->wake, 1u, __ATOMIC_SEQ_CST);
+		futex(&percpu->wake, FUTEX_WAKE_PRIVATE, 1, NULL);
+	}
+}
+
+void dlg_percpu_destroy(struct dlg_percpu* percpu) {
+	if(!percpu) {
+		return;
+	}
+
+	__atomic_store_n(&percpu->stop, 1u, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&percpu->wake, 1u, __ATOMIC_SEQ_CST);
+	futex(&percpu->wake, FUTEX_WAKE_PRIVATE, 1, NULL);
+	pthread_join(percpu->thread, NULL);
+
+	pthread_mutex_destroy(&percpu->mutex);
+	free(percpu->shards);
+	free(percpu->memory);
+	free(percpu->entries);
+	free(percpu->ends);
+	free(percpu);
+}
+
+// Copies str to *next if there is space left before end, cut off if
+// requested. Returns the copy or NULL.
+static char* copy_string(char** next, char* end, const char* str, bool cut) {
+	size_t len = strlen(str);
+	size_t left = (size_t) (end - *next);
+	if(!left || (!cut && len >= left)) {
+		return NULL;
+	}
+
+	len = (len < left) ? len : left - 1;
+	char* ret = *next;
+	memcpy(ret, str, len);
+	ret[len] = '\0';
+	*next += len + 1;
+	return ret;
+}
+
+static unsigned count_fields(const struct dlg_context* context) {
+	unsigned ret = 0u;
+	for(; context; context = context->parent) {
+		for(const char* const* field = context->fields; field && *field; field += 2) {
+			++ret;
+		}
+	}
+	return ret;
+}
+
+// Copies the fields of the context, the ones of its parents first
+// (like the json output), as long as they fit.
+static void copy_fields(const struct dlg_context* context, const char** fields,
+		unsigned* count, unsigned max, char** next, char* end) {
+	if(!context) {
+		return;
+	}
+
+	copy_fields(context->parent, fields, count, max, next, end);
+	for(const char* const* field = context->fields; field && *field && *count < max;
+			field += 2) {
+		char* prev = *next;
+		const char* key = copy_string(next, end, field[0], false);
+		const char* value = key ? copy_string(next, end, field[1] ? field[1] : "", false) : NULL;
+		if(!value) {
+			*next = prev;
+			continue;
+		}
+
+		fields[2 * *count] = key;
+		fields[2 * *count + 1] = value;
+		++*count;
+	}
+}
+
+// Reserves a slot, returns NULL if the shard is full.
+static struct percpu_slot* reserve(struct dlg_percpu* percpu,
+		struct percpu_shard* shard, uint64_t* ppos) {
+	uint64_t pos = __atomic_load_n(&shard->write, __ATOMIC_RELAXED);
+	for(;;) {
+		struct percpu_slot* slot = slot_at(percpu, shard, pos);
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		int64_t diff = (int64_t) (seq - pos);
+		if(diff == 0) {
+			// only contended when preempted or migrated in between
+			if(__atomic_compare_exchange_n(&shard->write, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				*ppos = pos;
+				return slot;
+			}
+		} else if(diff < 0) { // not yet drained in the previous round
+			__atomic_fetch_add(&shard->dropped, 1u, __ATOMIC_RELAXED);
+			return NULL;
+		} else {
+			pos = __atomic_load_n(&shard->write, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void dlg_percpu_output(const struct dlg_origin* origin, const char* string, void* data) {
+	struct dlg_percpu* percpu = (struct dlg_percpu*) data;
+	int cpu = sched_getcpu();
+	struct percpu_shard* shard = &percpu->shards[(cpu < 0) ? 0u :
+		(unsigned) cpu % percpu->shard_count];
+
+	uint64_t pos;
+	struct percpu_slot* slot = reserve(percpu, shard, &pos);
+	if(!slot) {
+		return;
+	}
+
+	slot->time = get_nsecs();
+	slot->origin = *origin;
+
+	// the collector calls the handler in another thread, capture the
+	// logging thread and copy everything that may not outlive this call
+	struct dlg_record_thread thread;
+	dlg_get_record_thread(&thread);
+
+	unsigned tag_count = 0u;
+	for(const char** tag = origin->tags; tag && *tag; ++tag) {
+		++tag_count;
+	}
+	unsigned field_count = count_fields(thread.context);
+
+	// the pointer lists take at most a quarter of the space, tags first
+	char* end = (char*) slot + percpu->slot_size;
+	size_t max_ptrs = (size_t) (end - (char*) (slot + 1)) / (4u * sizeof(const char*));
+	tag_count = (tag_count + 2u <= max_ptrs) ? tag_count : (unsigned) max_ptrs - 2u;
+	size_t left = max_ptrs - tag_count - 2u;
+	field_count = (2u * field_count <= left) ? field_count : (unsigned) (left / 2u);
+
+	const char** tags = (const char**) (slot + 1);
+	const char** fields = tags + tag_count + 1;
+	char* next = (char*) (fields + 2u * field_count + 1);
+
+	// thread name, tags and fields may use half of the strings space,
+	// the message gets the rest (and at least one byte)
+	char* meta_end = next + (end - next) / 2;
+	slot->thread.id = thread.id;
+	slot->thread.name = copy_string(&next, meta_end, thread.name ? thread.name : "", true);
+	slot->thread.name = slot->thread.name ? slot->thread.name : "";
+
+	unsigned count = 0u;
+	for(unsigned i = 0u; i < tag_count; ++i) {
+		const char* tag = copy_string(&next, meta_end, origin->tags[i], false);
+		if(tag) {
+			tags[count++] = tag;
+		}
+	}
+	tags[count] = NULL;
+	slot->origin.tags = tags;
+
+	count = 0u;
+	copy_fields(thread.context, fields, &count, field_count, &next, meta_end);
+	fields[2 * count] = NULL;
+	slot->context.parent = NULL;
+	slot->context.tags = NULL;
+	slot->context.fields = fields;
+	slot->thread.context = thread.context ? &slot->context : NULL;
+
+	slot->string = string ? copy_string(&next, end, string, true) : NULL;
+
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	uint64_t read = __atomic_load_n(&shard->read, __ATOMIC_RELAXED);
+	if(origin->level >= dlg_level_error || pos + 1 - read >= percpu->slot_count / 2u) {
+		wake_collector(percpu);
+	}
+}
+
+static int compare_entries(const void* a, const void* b) {
+	const struct percpu_entry* ea = (const struct percpu_entry*) a;
+	const struct percpu_entry* eb = (const struct percpu_entry*) b;
+	if(ea->time != eb->time) {
+		return (ea->time < eb->time) ? -1 : 1;
+	}
+	if(ea->shard != eb->shard) {
+		return (ea->shard < eb->shard) ? -1 : 1;
+	}
+	return (ea->pos < eb->pos) ? -1 : (ea->pos > eb->pos);
+}
+
+void dlg_percpu_flush(struct dlg_percpu* percpu) {
+	pthread_mutex_lock(&percpu->mutex);
+
+	// collect the committed slots of all shards
+	size_t count = 0u;
+	for(unsigned i = 0u; i < percpu->shard_count; ++i) {
+		struct percpu_shard* shard = &percpu->shards[i];
+		uint64_t pos = shard->read;
+		for(;;) {
+			struct percpu_slot* slot = slot_at(percpu, shard, pos);
+			if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) {
+				break;
+			}
+
+			struct percpu_entry* entry = &percpu->entries[count++];
+			entry->time = slot->time;
+			entry->pos = pos;
+			entry->shard = i;
+			++pos;
+		}
+		percpu->ends[i] = pos;
+	}
+
+	// merge by timestamp, the shards are mostly sorted already
+	qsort(percpu->entries, count, sizeof(*percpu->entries), compare_entries);
+	for(size_t i = 0u; i < count; ++i) {
+		struct percpu_entry* entry = &percpu->entries[i];
+		struct percpu_slot* slot = slot_at(percpu, &percpu->shards[entry->shard],
+			entry->pos);
+		dlg_set_record_thread(&slot->thread);
+		percpu->handler(&slot->origin, slot->string, percpu->data);
+		dlg_set_record_thread(NULL);
+	}
+
+	// release the slots for the next round
+	for(unsigned i = 0u; i < percpu->shard_count; ++i) {
+		struct percpu_shard* shard = &percpu->shards[i];
+		for(uint64_t pos = shard->read; pos < percpu->ends[i]; ++pos) {
+			__atomic_store_n(&slot_at(percpu, shard, pos)->seq,
+				pos + percpu->slot_count, __ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&shard->read, percpu->ends[i], __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock(&percpu->mutex);
+}
+
+static void* collector(void* data) {
+	struct dlg_percpu* percpu = (struct dlg_percpu*) data;
+	struct timespec timeout;
+	timeout.tv_sec = percpu->interval_ms / 1000u;
+	timeout.tv_nsec = (long) (percpu->interval_ms % 1000u) * 1000000l;
+
+	while(!__atomic_load_n(&percpu->stop, __ATOMIC_SEQ_CST)) {
+		uint32_t wake = __atomic_load_n(&percpu->wake, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&percpu->waiting, 1u, __ATOMIC_SEQ_CST);
+		futex(&percpu->wake, FUTEX_WAIT_PRIVATE, wake, &timeout);
+		__atomic_store_n(&percpu->waiting, 0u, __ATOMIC_SEQ_CST);
+		dlg_percpu_flush(percpu);
+	}
+
+	dlg_percpu_flush(percpu);
+	return NULL;
+}
+
+unsigned dlg_percpu_shards(struct dlg_percpu* percpu) {
+	return percpu->shard_count;
+}
+
+unsigned long long dlg_percpu_dropped(struct dlg_percpu* percpu) {
+	unsigned long long ret = 0u;
+	for(unsigned i = 0u; i < percpu->shard_count; ++i) {
+		ret += __atomic_load_n(&percpu->shards[i].dropped, __ATOMIC_RELAXED);
+	}
+	return ret;
+}
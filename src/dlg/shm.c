@@ -0,0 +1,363 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Needed for syscall.
+#define _GNU_SOURCE
+
+#include <dlg/shm.h>
+#include <dlg/output.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct dlg_shm {
+	struct dlg_shm_header* header;
+	char* slots;
+	size_t map_size;
+	uint64_t mask;
+
+	// reader state
+	unsigned abandon_ms;
+	uint64_t stuck_pos; // position of the uncommitted slot, see dlg_shm_read
+	uint64_t stuck_since;
+};
+
+static uint64_t get_msecs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000u + (uint64_t) ts.tv_nsec / 1000000u;
+}
+
+// Stamped into the slots. Kept current in forked children so that
+// handles opened before fork (e.g. pre-forked workers) stay correct.
+static uint32_t g_pid;
+static pthread_once_t g_pid_once = PTHREAD_ONCE_INIT;
+
+static void refresh_pid(void) {
+	__atomic_store_n(&g_pid, (uint32_t) getpid(), __ATOMIC_RELAXED);
+}
+
+static void init_pid(void) {
+	refresh_pid();
+	pthread_atfork(NULL, NULL, refresh_pid);
+}
+
+static long futex(uint32_t* addr, int op, uint32_t val, const struct timespec* timeout) {
+	return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+static struct dlg_shm_slot* slot_at(struct dlg_shm* shm, uint64_t pos) {
+	size_t off = (size_t) (pos & shm->mask) * shm->header->slot_size;
+	return (struct dlg_shm_slot*) (shm->slots + off);
+}
+
+static size_t slot_capacity(const struct dlg_shm* shm) {
+	return shm->header->slot_size - sizeof(struct dlg_shm_slot) - 1;
+}
+
+static char* slot_data(struct dlg_shm_slot* slot) {
+	return (char*) (slot + 1);
+}
+
+static unsigned round_pow2(unsigned val) {
+	unsigned ret = 1u;
+	while(ret < val && ret < (1u << 30)) {
+		ret <<= 1;
+	}
+	return ret;
+}
+
+struct dlg_shm* dlg_shm_open(const char* name, unsigned slot_count, unsigned slot_size) {
+	slot_count = round_pow2(slot_count ? slot_count : 4096u);
+	slot_size = slot_size ? slot_size : 512u;
+	slot_size = (slot_size + 7u) & ~7u; // keep the slot headers aligned
+	if(slot_size < sizeof(struct dlg_shm_slot) + 8u) {
+		slot_size = sizeof(struct dlg_shm_slot) + 8u;
+	}
+
+	bool created = true;
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd < 0 && errno == EEXIST) {
+		created = false;
+		fd = shm_open(name, O_RDWR, 0);
+	}
+
+	if(fd < 0) {
+		fprintf(stderr, "dlg_shm_open: shm_open: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	struct dlg_shm_header* header = NULL;
+	size_t map_size = 0;
+	if(created) {
+		map_size = sizeof(*header) + (size_t) slot_count * slot_size;
+		if(ftruncate(fd, (off_t) map_size) != 0) {
+			fprintf(stderr, "dlg_shm_open: ftruncate: %s\n", strerror(errno));
+			close(fd);
+			shm_unlink(name);
+			return NULL;
+		}
+	} else {
+		// wait for the creator to size and initialize it
+		struct stat st;
+		for(unsigned i = 0u; ; ++i) {
+			if(fstat(fd, &st) == 0 && (size_t) st.st_size > sizeof(*header)) {
+				break;
+			}
+
+			if(i == 1000u) {
+				fprintf(stderr, "dlg_shm_open: '%s' was never initialized\n", name);
+				close(fd);
+				return NULL;
+			}
+
+			usleep(1000);
+		}
+
+		map_size = (size_t) st.st_size;
+	}
+
+	void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		fprintf(stderr, "dlg_shm_open: mmap: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	header = (struct dlg_shm_header*) map;
+	if(created) {
+		// ftruncate zeroed everything
+		header->version = DLG_SHM_VERSION;
+		header->slot_count = slot_count;
+		header->slot_size = slot_size;
+		char* slots = (char*) (header + 1);
+		for(unsigned i = 0u; i < slot_count; ++i) {
+			((struct dlg_shm_slot*) (slots + (size_t) i * slot_size))->seq = i;
+		}
+		__atomic_store_n(&header->magic, DLG_SHM_MAGIC, __ATOMIC_RELEASE);
+	} else {
+		for(unsigned i = 0u; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != DLG_SHM_MAGIC; ++i) {
+			if(i == 1000u) {
+				fprintf(stderr, "dlg_shm_open: '%s' is not a dlg ring\n", name);
+				munmap(map, map_size);
+				return NULL;
+			}
+			usleep(1000);
+		}
+
+		if(header->version != DLG_SHM_VERSION ||
+				sizeof(*header) + (size_t) header->slot_count * header->slot_size > map_size) {
+			fprintf(stderr, "dlg_shm_open: '%s' has an incompatible layout\n", name);
+			munmap(map, map_size);
+			return NULL;
+		}
+	}
+
+	struct dlg_shm* shm = (struct dlg_shm*) calloc(1, sizeof(*shm));
+	if(!shm) {
+		munmap(map, map_size);
+		return NULL;
+	}
+
+	pthread_once(&g_pid_once, init_pid);
+
+	shm->header = header;
+	shm->slots = (char*) (header + 1);
+	shm->map_size = map_size;
+	shm->mask = header->slot_count - 1u;
+	shm->abandon_ms = 1000u;
+	shm->stuck_pos = UINT64_MAX;
+	return shm;
+}
+
+void dlg_shm_close(struct dlg_shm* shm) {
+	if(shm) {
+		munmap(shm->header, shm->map_size);
+		free(shm);
+	}
+}
+
+bool dlg_shm_unlink(const char* name) {
+	return shm_unlink(name) == 0;
+}
+
+// Reserves a slot, returns NULL if the ring is full.
+static struct dlg_shm_slot* reserve(struct dlg_shm* shm, uint64_t* ppos) {
+	struct dlg_shm_header* header = shm->header;
+	uint64_t pos = __atomic_load_n(&header->write, __ATOMIC_RELAXED);
+	for(;;) {
+		struct dlg_shm_slot* slot = slot_at(shm, pos);
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		int64_t diff = (int64_t) (seq - pos);
+		if(seq & DLG_SHM_ABANDONED) { // still owned by a stalled producer, skip it
+			uint64_t expected = pos;
+			pos = __atomic_compare_exchange_n(&header->write, &expected, pos + 1, true,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED) ? pos + 1 : expected;
+		} else if(diff == 0) {
+			if(__atomic_compare_exchange_n(&header->write, &pos, pos + 1, true,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				*ppos = pos;
+				return slot;
+			}
+		} else if(diff < 0) { // not yet read in the previous round
+			__atomic_fetch_add(&header->dropped, 1u, __ATOMIC_RELAXED);
+			return NULL;
+		} else {
+			pos = __atomic_load_n(&header->write, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+// Publishes the slot and wakes the reader if needed.
+static bool commit(struct dlg_shm* shm, struct dlg_shm_slot* slot, uint64_t pos) {
+	struct dlg_shm_header* header = shm->header;
+	slot->pid = __atomic_load_n(&g_pid, __ATOMIC_RELAXED);
+
+	// fails when the reader already skipped the slot. Nobody else uses
+	// it until we give it up
+	uint64_t expected = pos;
+	if(!__atomic_compare_exchange_n(&slot->seq, &expected, pos + 1, false,
+			__ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		__atomic_fetch_or(&slot->seq, DLG_SHM_RELEASED, __ATOMIC_RELEASE);
+		__atomic_fetch_add(&header->dropped, 1u, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	if(__atomic_load_n(&header->waiting, __ATOMIC_SEQ_CST)) {
+		__atomic_fetch_add(&header->wake, 1u, __ATOMIC_SEQ_CST);
+		futex(&header->wake, FUTEX_WAKE, INT_MAX, NULL);
+	}
+
+	return true;
+}
+
+bool dlg_shm_write(struct dlg_shm* shm, const char* record, size_t size) {
+	uint64_t pos;
+	struct dlg_shm_slot* slot = reserve(shm, &pos);
+	if(!slot) {
+		return false;
+	}
+
+	size_t cap = slot_capacity(shm);
+	size = (size < cap) ? size : cap;
+	memcpy(slot_data(slot), record, size);
+	slot_data(slot)[size] = '\0';
+	slot->size = (uint32_t) size;
+	return commit(shm, slot, pos);
+}
+
+void dlg_shm_output(const struct dlg_origin* origin, const char* string, void* data) {
+	struct dlg_shm* shm = (struct dlg_shm*) data;
+	uint64_t pos;
+	struct dlg_shm_slot* slot = reserve(shm, &pos);
+	if(!slot) {
+		return;
+	}
+
+	// silently truncated
+	size_t size = slot_capacity(shm) + 1;
+	dlg_generic_output_buf(slot_data(slot), &size, dlg_output_file_line | dlg_output_newline,
+		origin, string, dlg_default_output_styles);
+	slot->size = (uint32_t) size;
+	commit(shm, slot, pos);
+}
+
+unsigned long long dlg_shm_dropped(struct dlg_shm* shm) {
+	return __atomic_load_n(&shm->header->dropped, __ATOMIC_RELAXED);
+}
+
+unsigned long long dlg_shm_abandoned(struct dlg_shm* shm) {
+	return __atomic_load_n(&shm->header->abandoned, __ATOMIC_RELAXED);
+}
+
+unsigned dlg_shm_read(struct dlg_shm* shm, dlg_shm_reader reader, void* data) {
+	struct dlg_shm_header* header = shm->header;
+	uint64_t count = header->slot_count;
+	uint64_t pos = __atomic_load_n(&header->read, __ATOMIC_RELAXED);
+	unsigned ret = 0u;
+	for(;;) {
+		struct dlg_shm_slot* slot = slot_at(shm, pos);
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if(seq == pos + 1) {
+			size_t size = slot->size;
+			size = (size < slot_capacity(shm)) ? size : slot_capacity(shm);
+			reader(slot_data(slot), size, slot->pid, data);
+			__atomic_store_n(&slot->seq, pos + count, __ATOMIC_RELEASE);
+			++pos;
+			++ret;
+			continue;
+		}
+
+		uint64_t write = __atomic_load_n(&header->write, __ATOMIC_RELAXED);
+		if((seq & DLG_SHM_ABANDONED) && write > pos) {
+			// skipped by the producers as well, see dlg_shm_slot
+			if(seq & DLG_SHM_RELEASED) {
+				__atomic_store_n(&slot->seq, pos + count, __ATOMIC_RELEASE);
+			}
+			++pos;
+			continue;
+		}
+
+		if(seq != pos || write <= pos) { // nothing more was written
+			break;
+		}
+
+		// reserved but not committed (yet)
+		uint64_t now = get_msecs();
+		if(shm->stuck_pos != pos) {
+			shm->stuck_pos = pos;
+			shm->stuck_since = now;
+			break;
+		}
+
+		if(now - shm->stuck_since < shm->abandon_ms) {
+			break;
+		}
+
+		// skip it; fails if the producer commits right now
+		if(__atomic_compare_exchange_n(&slot->seq, &seq, pos | DLG_SHM_ABANDONED, false,
+				__ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+			__atomic_fetch_add(&header->abandoned, 1u, __ATOMIC_RELAXED);
+			++pos;
+		}
+	}
+
+	__atomic_store_n(&header->read, pos, __ATOMIC_RELAXED);
+	return ret;
+}
+
+bool dlg_shm_wait(struct dlg_shm* shm, unsigned timeout_ms) {
+	struct dlg_shm_header* header = shm->header;
+	uint32_t wake = __atomic_load_n(&header->wake, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&header->waiting, 1u, __ATOMIC_SEQ_CST);
+
+	// check after announcing to not miss a commit
+	uint64_t pos = __atomic_load_n(&header->read, __ATOMIC_RELAXED);
+	uint64_t seq = __atomic_load_n(&slot_at(shm, pos)->seq, __ATOMIC_SEQ_CST);
+	bool ready = (seq == pos + 1);
+	if(!ready) {
+		struct timespec timeout;
+		timeout.tv_sec = timeout_ms / 1000u;
+		timeout.tv_nsec = (long) (timeout_ms % 1000u) * 1000000l;
+		ready = futex(&header->wake, FUTEX_WAIT, wake, &timeout) == 0 ||
+			errno == EAGAIN;
+	}
+
+	__atomic_store_n(&header->waiting, 0u, __ATOMIC_SEQ_CST);
+	return ready;
+}
+
+void dlg_shm_set_abandon_timeout(struct dlg_shm* shm, unsigned timeout_ms) {
+	shm->abandon_ms = timeout_ms;
+}
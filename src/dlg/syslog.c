@@ -0,0 +1,355 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Needed for sendmmsg.
+#define _GNU_SOURCE
+
+#include <dlg/syslog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct dlg_syslog {
+	int fd;
+	pthread_mutex_t mutex;
+	unsigned facility;
+
+	// queued records, ring buffer of fixed size slots
+	char* slots;
+	size_t* lens;
+	unsigned queue_size;
+	unsigned head; // oldest record
+	unsigned count;
+	unsigned batch;
+	unsigned long dropped;
+
+	struct mmsghdr* msgs; // batch
+	struct iovec* iovs; // batch
+
+	char header[384]; // " HOSTNAME APP-NAME PROCID - "
+	size_t header_len;
+
+	// cached formatted second of the last timestamp
+	time_t time;
+	char time_buf[24];
+};
+
+// Appends to a fixed size record, silently truncating.
+struct record {
+	char* buf;
+	size_t size;
+};
+
+static void append(struct record* rec, const char* str, size_t len) {
+	size_t left = DLG_SYSLOG_MAX_RECORD - rec->size;
+	len = (len < left) ? len : left;
+	memcpy(rec->buf + rec->size, str, len);
+	rec->size += len;
+}
+
+static void append_str(struct record* rec, const char* str) {
+	append(rec, str, strlen(str));
+}
+
+// Appends a structured data param value, escaping '"', '\' and ']'.
+static void append_param(struct record* rec, const char* str) {
+	const char* it = str;
+	while(*it) {
+		size_t span = strcspn(it, "\"\\]");
+		append(rec, it, span);
+		it += span;
+		if(*it) {
+			char esc[2] = {'\\', *it};
+			append(rec, esc, 2);
+			++it;
+		}
+	}
+}
+
+static void append_time(struct dlg_syslog* syslog, struct record* rec) {
+	struct timespec ts;
+	struct tm tm_info;
+	if(!timespec_get(&ts, TIME_UTC)) {
+		append(rec, "-", 1);
+		return;
+	}
+
+	if(ts.tv_sec != syslog->time || !syslog->time_buf[0]) {
+		if(!gmtime_r(&ts.tv_sec, &tm_info)) {
+			append(rec, "-", 1);
+			return;
+		}
+
+		strftime(syslog->time_buf, sizeof(syslog->time_buf),
+			"%Y-%m-%dT%H:%M:%S", &tm_info);
+		syslog->time = ts.tv_sec;
+	}
+
+	char usecs[16];
+	int len = snprintf(usecs, sizeof(usecs), ".%06ldZ", (long) (ts.tv_nsec / 1000));
+	append_str(rec, syslog->time_buf);
+	append(rec, usecs, (size_t) len);
+}
+
+static int connect_unix(const char* path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		return -1;
+	}
+
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(fd >= 0 && connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int connect_udp(const char* address) {
+	char host[256];
+	const char* port = strrchr(address, ':');
+	if(!port || (size_t) (port - address) >= sizeof(host)) {
+		return -1;
+	}
+
+	// strip brackets of ipv6 addresses
+	const char* begin = address;
+	const char* end = port;
+	if(*begin == '[' && end[-1] == ']') {
+		++begin;
+		--end;
+	}
+
+	memcpy(host, begin, end - begin);
+	host[end - begin] = '\0';
+	++port;
+
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	struct addrinfo* res;
+	if(getaddrinfo(host, port, &hints, &res) != 0) {
+		return -1;
+	}
+
+	int fd = -1;
+	for(struct addrinfo* it = res; it; it = it->ai_next) {
+		fd = socket(it->ai_family, it->ai_socktype | SOCK_CLOEXEC, it->ai_protocol);
+		if(fd < 0) {
+			continue;
+		}
+
+		if(connect(fd, it->ai_addr, it->ai_addrlen) == 0) {
+			break;
+		}
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(res);
+	return fd;
+}
+
+struct dlg_syslog* dlg_syslog_create(const char* address, const char* app_name,
+		unsigned facility, unsigned batch) {
+	int fd = (address[0] == '/') ? connect_unix(address) : connect_udp(address);
+	if(fd < 0) {
+		fprintf(stderr, "dlg: could not connect syslog socket to %s\n", address);
+		return NULL;
+	}
+
+	struct dlg_syslog* syslog = (struct dlg_syslog*) calloc(1, sizeof(*syslog));
+	if(!syslog) {
+		fprintf(stderr, "dlg_syslog_create: allocation failed\n");
+		close(fd);
+		return NULL;
+	}
+
+	syslog->fd = fd;
+	syslog->facility = facility;
+	syslog->batch = batch ? batch : 64;
+	syslog->queue_size = 4 * syslog->batch;
+	syslog->slots = (char*) malloc((size_t) syslog->queue_size * DLG_SYSLOG_MAX_RECORD);
+	syslog->lens = (size_t*) calloc(syslog->queue_size, sizeof(*syslog->lens));
+	syslog->msgs = (struct mmsghdr*) calloc(syslog->batch, sizeof(*syslog->msgs));
+	syslog->iovs = (struct iovec*) calloc(syslog->batch, sizeof(*syslog->iovs));
+	if(!syslog->slots || !syslog->lens || !syslog->msgs || !syslog->iovs) {
+		fprintf(stderr, "dlg_syslog_create: allocation failed\n");
+		free(syslog->slots);
+		free(syslog->lens);
+		free(syslog->msgs);
+		free(syslog->iovs);
+		free(syslog);
+		close(fd);
+		return NULL;
+	}
+
+	pthread_mutex_init(&syslog->mutex, NULL);
+
+	char hostname[256];
+	if(gethostname(hostname, sizeof(hostname)) != 0 || !hostname[0]) {
+		strcpy(hostname, "-");
+	}
+	hostname[sizeof(hostname) - 1] = '\0';
+
+	snprintf(syslog->header, sizeof(syslog->header), " %.255s %.48s %ld - ",
+		hostname, (app_name && *app_name) ? app_name : "-", (long) getpid());
+	syslog->header_len = strlen(syslog->header);
+	return syslog;
+}
+
+// Sends queued records until the queue is empty or the socket would block.
+// Must be called with the mutex locked.
+static void flush_locked(struct dlg_syslog* syslog) {
+	while(syslog->count) {
+		unsigned count = (syslog->count < syslog->batch) ? syslog->count : syslog->batch;
+		for(unsigned i = 0; i < count; ++i) {
+			unsigned slot = (syslog->head + i) % syslog->queue_size;
+			syslog->iovs[i].iov_base = syslog->slots + (size_t) slot * DLG_SYSLOG_MAX_RECORD;
+			syslog->iovs[i].iov_len = syslog->lens[slot];
+			memset(&syslog->msgs[i], 0, sizeof(syslog->msgs[i]));
+			syslog->msgs[i].msg_hdr.msg_iov = &syslog->iovs[i];
+			syslog->msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int sent = sendmmsg(syslog->fd, syslog->msgs, count, MSG_DONTWAIT | MSG_NOSIGNAL);
+		if(sent < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+
+			if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				return;
+			}
+
+			// the collector is unavailable, don't retry these records
+			sent = (int) count;
+			syslog->dropped += count;
+		}
+
+		syslog->head = (syslog->head + (unsigned) sent) % syslog->queue_size;
+		syslog->count -= (unsigned) sent;
+	}
+}
+
+void dlg_syslog_flush(struct dlg_syslog* syslog) {
+	pthread_mutex_lock(&syslog->mutex);
+	flush_locked(syslog);
+	pthread_mutex_unlock(&syslog->mutex);
+}
+
+void dlg_syslog_destroy(struct dlg_syslog* syslog) {
+	if(!syslog) {
+		return;
+	}
+
+	dlg_syslog_flush(syslog);
+	pthread_mutex_destroy(&syslog->mutex);
+	close(syslog->fd);
+	free(syslog->slots);
+	free(syslog->lens);
+	free(syslog->msgs);
+	free(syslog->iovs);
+	free(syslog);
+}
+
+unsigned long dlg_syslog_dropped(struct dlg_syslog* syslog) {
+	pthread_mutex_lock(&syslog->mutex);
+	unsigned long ret = syslog->dropped;
+	pthread_mutex_unlock(&syslog->mutex);
+	return ret;
+}
+
+void dlg_syslog_output(const struct dlg_origin* origin, const char* string,
+		void* data) {
+	// dlg level to syslog severity
+	static const unsigned severities[] = {7, 7, 6, 4, 3, 2};
+
+	struct dlg_syslog* syslog = (struct dlg_syslog*) data;
+	pthread_mutex_lock(&syslog->mutex);
+
+	if(syslog->count == syslog->queue_size) {
+		flush_locked(syslog);
+		if(syslog->count == syslog->queue_size) {
+			++syslog->dropped;
+			pthread_mutex_unlock(&syslog->mutex);
+			return;
+		}
+	}
+
+	unsigned slot = (syslog->head + syslog->count) % syslog->queue_size;
+	struct record rec;
+	rec.buf = syslog->slots + (size_t) slot * DLG_SYSLOG_MAX_RECORD;
+	rec.size = 0;
+
+	char buf[32];
+	int len = snprintf(buf, sizeof(buf), "<%u>1 ",
+		syslog->facility * 8 + severities[origin->level]);
+	append(&rec, buf, (size_t) len);
+	append_time(syslog, &rec);
+	append(&rec, syslog->header, syslog->header_len);
+
+	append_str(&rec, "[dlg@32473 file=\"");
+	append_param(&rec, origin->file ? origin->file : "");
+	len = snprintf(buf, sizeof(buf), "\" line=\"%u\" func=\"", origin->line);
+	append(&rec, buf, (size_t) len);
+	append_param(&rec, origin->func ? origin->func : "");
+	append_str(&rec, "\"");
+
+	if(*origin->tags) {
+		append_str(&rec, " tags=\"");
+		for(const char** tags = origin->tags; *tags; ++tags) {
+			if(tags != origin->tags) {
+				append(&rec, ",", 1);
+			}
+			append_param(&rec, *tags);
+		}
+		append_str(&rec, "\"");
+	}
+
+	if(origin->expr) {
+		append_str(&rec, " expr=\"");
+		append_param(&rec, origin->expr);
+		append_str(&rec, "\"");
+	}
+
+	append_str(&rec, "] ");
+	if(origin->expr && string) {
+		append_str(&rec, "assertion '");
+		append_str(&rec, origin->expr);
+		append_str(&rec, "' failed: '");
+		append_str(&rec, string);
+		append_str(&rec, "'");
+	} else if(origin->expr) {
+		append_str(&rec, "assertion '");
+		append_str(&rec, origin->expr);
+		append_str(&rec, "' failed");
+	} else if(string) {
+		append_str(&rec, string);
+	}
+
+	syslog->lens[slot] = rec.size;
+	++syslog->count;
+
+	if(syslog->count >= syslog->batch || origin->level >= dlg_level_error) {
+		flush_locked(syslog);
+	}
+
+	pthread_mutex_unlock(&syslog->mutex);
+}
@@ -0,0 +1,716 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Needed for syscall.
+#define _GNU_SOURCE
+
+#include <dlg/uring.h>
+#include <dlg/output.h>
+#include <dlg/index.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Without the kernel header (or syscall numbers) only the writer threads
+// are built, io_uring_setup is treated as unavailable.
+#if defined(__has_include)
+	#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+		#include <linux/io_uring.h>
+		#define DLG_HAVE_IO_URING
+	#endif
+#endif
+
+#define DLG_URING_THREADS 2u
+
+// How often writes and syncs failing with EAGAIN/EINTR are retried.
+#define DLG_URING_RETRIES 8u
+
+struct uring_buffer {
+	char* data;
+	size_t size; // filled bytes
+	size_t done; // bytes already written, see resubmission of short writes
+	uint64_t offset; // file offset once submitted
+	unsigned retries; // of the current write
+	struct iovec iov; // for unregistered buffers
+};
+
+struct dlg_uring {
+	int fd;
+	unsigned flags;
+	pthread_mutex_t mutex;
+
+	struct uring_buffer* buffers;
+	unsigned buffer_count;
+	size_t buffer_size;
+	unsigned* free; // stack of free buffer ids
+	unsigned free_count;
+	struct uring_buffer* current; // filled by producers, NULL if none
+	uint64_t offset; // file offset of the next submitted buffer
+	unsigned pending; // submitted buffers not yet released and linked syncs
+
+	unsigned long long dropped;
+	unsigned long long errors;
+	struct dlg_index* index; // with dlg_uring_index
+
+	bool async;
+#ifdef DLG_HAVE_IO_URING
+	struct {
+		int fd;
+		bool fixed; // buffers were registered
+		void* sq_map;
+		void* cq_map;
+		size_t sq_map_size;
+		size_t cq_map_size;
+		struct io_uring_sqe* sqes;
+		size_t sqes_size;
+		unsigned* sq_head;
+		unsigned* sq_tail;
+		unsigned* sq_mask;
+		unsigned* sq_entries;
+		unsigned* sq_array;
+		unsigned* cq_head;
+		unsigned* cq_tail;
+		unsigned* cq_mask;
+		struct io_uring_cqe* cqes;
+		unsigned unsubmitted;
+		int event; // eventfd waking the ring thread
+		uint64_t event_value;
+		struct iovec event_iov;
+	} ring;
+#endif
+
+	// the ring thread submitting and reaping all requests or, when io_uring
+	// is not used, the writer threads
+	pthread_t threads[DLG_URING_THREADS];
+	unsigned thread_count;
+	pthread_cond_t work; // signaled when queued or stopping
+	pthread_cond_t idle; // signaled when pending reaches 0
+	unsigned* queue; // fifo of submitted buffer ids
+	unsigned queue_head;
+	unsigned queue_count;
+	bool stop;
+};
+
+static unsigned buffer_id(struct dlg_uring* uring, struct uring_buffer* buf) {
+	return (unsigned) (buf - uring->buffers);
+}
+
+static void release(struct dlg_uring* uring, struct uring_buffer* buf) {
+	buf->size = 0;
+	buf->done = 0;
+	buf->retries = 0;
+	uring->free[uring->free_count++] = buffer_id(uring, buf);
+}
+
+// Called when a submitted buffer was released or a sync completed.
+static void complete(struct dlg_uring* uring) {
+	if(--uring->pending == 0) {
+		pthread_cond_broadcast(&uring->idle);
+	}
+}
+
+// Returns the id of the oldest queued buffer.
+static unsigned dequeue(struct dlg_uring* uring) {
+	unsigned id = uring->queue[uring->queue_head];
+	uring->queue_head = (uring->queue_head + 1) % uring->buffer_count;
+	--uring->queue_count;
+	return id;
+}
+
+// Writes the buffer and optionally syncs, called by the writer threads.
+static bool write_buffer(struct dlg_uring* uring, struct uring_buffer* buf) {
+	while(buf->done < buf->size) {
+		ssize_t ret = pwrite(uring->fd, buf->data + buf->done, buf->size - buf->done,
+			(off_t) (buf->offset + buf->done));
+		if(ret < 0 && errno == EINTR) {
+			continue;
+		} else if(ret <= 0) {
+			return false;
+		}
+
+		buf->done += (size_t) ret;
+	}
+
+	return !(uring->flags & dlg_uring_sync) || fdatasync(uring->fd) == 0;
+}
+
+static void* writer_thread(void* data) {
+	struct dlg_uring* uring = (struct dlg_uring*) data;
+	pthread_mutex_lock(&uring->mutex);
+	for(;;) {
+		while(!uring->queue_count && !uring->stop) {
+			pthread_cond_wait(&uring->work, &uring->mutex);
+		}
+
+		if(!uring->queue_count) {
+			break;
+		}
+
+		unsigned id = dequeue(uring);
+
+		// buffers in flight are only touched by their writer
+		pthread_mutex_unlock(&uring->mutex);
+		bool ok = write_buffer(uring, &uring->buffers[id]);
+		pthread_mutex_lock(&uring->mutex);
+
+		uring->errors += !ok;
+		release(uring, &uring->buffers[id]);
+		complete(uring);
+	}
+
+	pthread_mutex_unlock(&uring->mutex);
+	return NULL;
+}
+
+#ifdef DLG_HAVE_IO_URING
+
+// user_data: buffer id << 1, the sync bit and the retries of syncs << 32
+#define DLG_URING_SYNC_BIT 1u
+#define DLG_URING_EVENT UINT64_MAX // the read of the eventfd
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* params) {
+	return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+		unsigned flags) {
+	return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, const void* arg,
+		unsigned nr_args) {
+	return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_destroy(struct dlg_uring* uring) {
+	if(uring->ring.sqes) {
+		munmap(uring->ring.sqes, uring->ring.sqes_size);
+	}
+	if(uring->ring.cq_map && uring->ring.cq_map != uring->ring.sq_map) {
+		munmap(uring->ring.cq_map, uring->ring.cq_map_size);
+	}
+	if(uring->ring.sq_map) {
+		munmap(uring->ring.sq_map, uring->ring.sq_map_size);
+	}
+	close(uring->ring.fd);
+	if(uring->ring.event >= 0) {
+		close(uring->ring.event);
+	}
+}
+
+// Sets up the ring, returns false when io_uring can't be used.
+static bool ring_init(struct dlg_uring* uring) {
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = io_uring_setup(2 * uring->buffer_count, &params);
+	if(fd < 0) {
+		return false; // ENOSYS, EPERM (disabled via sysctl or seccomp), ...
+	}
+
+	memset(&uring->ring, 0, sizeof(uring->ring));
+	uring->ring.fd = fd;
+	uring->ring.event = eventfd(0, EFD_CLOEXEC);
+	uring->ring.sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	uring->ring.cq_map_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+
+	bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+	if(single && uring->ring.cq_map_size > uring->ring.sq_map_size) {
+		uring->ring.sq_map_size = uring->ring.cq_map_size;
+	}
+
+	void* sq = mmap(NULL, uring->ring.sq_map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	void* cq = sq;
+	if(sq != MAP_FAILED && !single) {
+		cq = mmap(NULL, uring->ring.cq_map_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	}
+
+	uring->ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* sqes = MAP_FAILED;
+	if(sq != MAP_FAILED && cq != MAP_FAILED) {
+		sqes = mmap(NULL, uring->ring.sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	}
+
+	uring->ring.sq_map = (sq == MAP_FAILED) ? NULL : sq;
+	uring->ring.cq_map = (cq == MAP_FAILED) ? NULL : cq;
+	uring->ring.sqes = (sqes == MAP_FAILED) ? NULL : (struct io_uring_sqe*) sqes;
+	if(!uring->ring.sqes || uring->ring.event < 0) {
+		ring_destroy(uring);
+		return false;
+	}
+
+	char* sqc = (char*) sq;
+	char* cqc = (char*) cq;
+	uring->ring.sq_head = (unsigned*) (sqc + params.sq_off.head);
+	uring->ring.sq_tail = (unsigned*) (sqc + params.sq_off.tail);
+	uring->ring.sq_mask = (unsigned*) (sqc + params.sq_off.ring_mask);
+	uring->ring.sq_entries = (unsigned*) (sqc + params.sq_off.ring_entries);
+	uring->ring.sq_array = (unsigned*) (sqc + params.sq_off.array);
+	uring->ring.cq_head = (unsigned*) (cqc + params.cq_off.head);
+	uring->ring.cq_tail = (unsigned*) (cqc + params.cq_off.tail);
+	uring->ring.cq_mask = (unsigned*) (cqc + params.cq_off.ring_mask);
+	uring->ring.cqes = (struct io_uring_cqe*) (cqc + params.cq_off.cqes);
+
+	// registered buffers save the page pinning per write but count
+	// against RLIMIT_MEMLOCK, so this may fail
+	struct iovec* iovs = (struct iovec*) calloc(uring->buffer_count, sizeof(*iovs));
+	if(iovs) {
+		for(unsigned i = 0u; i < uring->buffer_count; ++i) {
+			iovs[i].iov_base = uring->buffers[i].data;
+			iovs[i].iov_len = uring->buffer_size;
+		}
+		uring->ring.fixed = io_uring_register(fd, IORING_REGISTER_BUFFERS, iovs,
+			uring->buffer_count) == 0;
+		free(iovs);
+	}
+
+	return true;
+}
+
+static void ring_enter(struct dlg_uring* uring, unsigned min_complete, bool getevents) {
+	unsigned flags = getevents ? IORING_ENTER_GETEVENTS : 0u;
+	int ret = io_uring_enter(uring->ring.fd, uring->ring.unsubmitted, min_complete, flags);
+	if(ret > 0) {
+		uring->ring.unsubmitted -= (unsigned) ret;
+	}
+
+	// on EAGAIN/EBUSY/EINTR the entries are submitted with the next call
+}
+
+// Queues an sqe, submitting the queued ones first if the sq is full.
+static struct io_uring_sqe* ring_sqe(struct dlg_uring* uring) {
+	unsigned tail = *uring->ring.sq_tail;
+	while(tail - __atomic_load_n(uring->ring.sq_head, __ATOMIC_ACQUIRE) >=
+			*uring->ring.sq_entries) {
+		ring_enter(uring, 0, false);
+	}
+
+	unsigned id = tail & *uring->ring.sq_mask;
+	struct io_uring_sqe* sqe = &uring->ring.sqes[id];
+	memset(sqe, 0, sizeof(*sqe));
+	uring->ring.sq_array[id] = id;
+	__atomic_store_n(uring->ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++uring->ring.unsubmitted;
+	return sqe;
+}
+
+static void ring_sync(struct dlg_uring* uring, uint64_t user_data) {
+	struct io_uring_sqe* sqe = ring_sqe(uring);
+	sqe->opcode = IORING_OP_FSYNC;
+	sqe->fd = uring->fd;
+	sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+	sqe->user_data = user_data;
+	++uring->pending;
+}
+
+static void ring_submit_buffer(struct dlg_uring* uring, struct uring_buffer* buf) {
+	unsigned id = buffer_id(uring, buf);
+	bool sync = uring->flags & dlg_uring_sync;
+
+	struct io_uring_sqe* sqe = ring_sqe(uring);
+	if(uring->ring.fixed) {
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->addr = (uint64_t) (uintptr_t) (buf->data + buf->done);
+		sqe->len = (uint32_t) (buf->size - buf->done);
+		sqe->buf_index = (uint16_t) id;
+	} else {
+		buf->iov.iov_base = buf->data + buf->done;
+		buf->iov.iov_len = buf->size - buf->done;
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->addr = (uint64_t) (uintptr_t) &buf->iov;
+		sqe->len = 1;
+	}
+
+	sqe->fd = uring->fd;
+	sqe->off = buf->offset + buf->done;
+	sqe->user_data = (uint64_t) id << 1;
+
+	if(sync) {
+		sqe->flags = IOSQE_IO_LINK;
+		ring_sync(uring, ((uint64_t) id << 1) | DLG_URING_SYNC_BIT);
+	}
+}
+
+// Reads the eventfd, completes when the ring thread is woken.
+static void ring_read_event(struct dlg_uring* uring) {
+	uring->ring.event_iov.iov_base = &uring->ring.event_value;
+	uring->ring.event_iov.iov_len = sizeof(uring->ring.event_value);
+	struct io_uring_sqe* sqe = ring_sqe(uring);
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = uring->ring.event;
+	sqe->addr = (uint64_t) (uintptr_t) &uring->ring.event_iov;
+	sqe->len = 1;
+	sqe->user_data = DLG_URING_EVENT;
+}
+
+// Wakes the ring thread, e.g. to submit queued buffers.
+static void ring_wake(struct dlg_uring* uring) {
+	uint64_t one = 1u;
+	ssize_t ret = write(uring->ring.event, &one, sizeof(one));
+	(void) ret; // can only fail when the counter overflows, it's awake then
+}
+
+// Handles all available completions. Must be called with the mutex locked.
+static void ring_reap(struct dlg_uring* uring) {
+	unsigned head = *uring->ring.cq_head;
+	unsigned tail = __atomic_load_n(uring->ring.cq_tail, __ATOMIC_ACQUIRE);
+	for(; head != tail; ++head) {
+		struct io_uring_cqe* cqe = &uring->ring.cqes[head & *uring->ring.cq_mask];
+		uint64_t user_data = cqe->user_data;
+		int res = cqe->res;
+		if(user_data == DLG_URING_EVENT) {
+			ring_read_event(uring);
+			continue;
+		}
+
+		struct uring_buffer* buf = &uring->buffers[(user_data & UINT32_MAX) >> 1];
+		bool retry = res == -EAGAIN || res == -EINTR;
+		if(user_data & DLG_URING_SYNC_BIT) {
+			unsigned retries = (unsigned) (user_data >> 32);
+			if(retry && retries < DLG_URING_RETRIES) {
+				ring_sync(uring, (user_data & UINT32_MAX) | ((uint64_t) (retries + 1) << 32));
+			} else if(res < 0 && res != -ECANCELED) {
+				// Real sync errors (-EIO) are never retried, a second sync
+				// might not report them again
+				++uring->errors;
+			}
+
+			// canceled when the linked write failed (counted there) or
+			// was short (its rest is synced again)
+			complete(uring);
+			continue;
+		}
+
+		if(retry && buf->retries < DLG_URING_RETRIES) {
+			++buf->retries;
+			ring_submit_buffer(uring, buf);
+			continue;
+		}
+
+		if(res <= 0) {
+			++uring->errors;
+			release(uring, buf);
+			complete(uring);
+			continue;
+		}
+
+		buf->done += (size_t) res;
+		if(buf->done < buf->size) {
+			ring_submit_buffer(uring, buf); // write the rest
+		} else {
+			release(uring, buf);
+			complete(uring);
+		}
+	}
+
+	__atomic_store_n(uring->ring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+// Submits the queued buffers and reaps the completions. All requests are
+// made by this thread: they are bound to the submitting thread and canceled
+// when it exits, and reaping never blocks the logging threads.
+static void* ring_thread(void* data) {
+	struct dlg_uring* uring = (struct dlg_uring*) data;
+	pthread_mutex_lock(&uring->mutex);
+	ring_read_event(uring);
+	for(;;) {
+		while(uring->queue_count) {
+			ring_submit_buffer(uring, &uring->buffers[dequeue(uring)]);
+		}
+
+		if(uring->stop && !uring->pending) {
+			break;
+		}
+
+		// the ring is only used by this thread, wait without the mutex
+		pthread_mutex_unlock(&uring->mutex);
+		ring_enter(uring, 1, true);
+		pthread_mutex_lock(&uring->mutex);
+		ring_reap(uring);
+	}
+
+	pthread_mutex_unlock(&uring->mutex);
+	return NULL;
+}
+
+#endif // DLG_HAVE_IO_URING
+
+// Submits the current buffer. Must be called with the mutex locked.
+static void submit_locked(struct dlg_uring* uring) {
+	struct uring_buffer* buf = uring->current;
+	if(!buf || !buf->size) {
+		return;
+	}
+
+	uring->current = NULL;
+	buf->offset = uring->offset;
+	uring->offset += buf->size;
+
+	unsigned back = (uring->queue_head + uring->queue_count) % uring->buffer_count;
+	uring->queue[back] = buffer_id(uring, buf);
+	++uring->queue_count;
+	++uring->pending;
+
+#ifdef DLG_HAVE_IO_URING
+	if(uring->async) {
+		ring_wake(uring);
+		return;
+	}
+#endif
+
+	pthread_cond_signal(&uring->work);
+}
+
+// Returns a buffer with at least size bytes left or NULL if none is free.
+// Must be called with the mutex locked.
+static struct uring_buffer* buffer_locked(struct dlg_uring* uring, size_t size) {
+	if(uring->current && uring->buffer_size - uring->current->size >= size) {
+		return uring->current;
+	}
+
+	submit_locked(uring);
+	if(!uring->free_count) {
+		return NULL;
+	}
+
+	uring->current = &uring->buffers[uring->free[--uring->free_count]];
+	return uring->current;
+}
+
+struct dlg_uring* dlg_uring_create(const char* path, unsigned buffer_count,
+		size_t buffer_size, unsigned flags) {
+	buffer_count = buffer_count ? buffer_count : 8u;
+	buffer_size = buffer_size ? buffer_size : 64u * 1024u;
+	if(buffer_count > 1024u) { // io_uring limits the registered buffers
+		buffer_count = 1024u;
+	}
+
+	int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		fprintf(stderr, "dlg_uring_create: open: %s\n", strerror(errno));
+		return NULL;
+	}
+
+	// we write at explicit offsets (no O_APPEND, io_uring would ignore
+	// the offsets), so the file must not be written by others meanwhile
+	off_t end = lseek(fd, 0, SEEK_END);
+	struct dlg_uring* uring = (struct dlg_uring*) calloc(1, sizeof(*uring));
+	char* memory = NULL;
+	if(end < 0 || !uring || posix_memalign((void**) &memory, 4096,
+			buffer_count * buffer_size) != 0) {
+		fprintf(stderr, "dlg_uring_create: allocation failed\n");
+		free(uring);
+		close(fd);
+		return NULL;
+	}
+
+	uring->fd = fd;
+	uring->flags = flags;
+	uring->offset = (uint64_t) end;
+	uring->buffer_count = buffer_count;
+	uring->buffer_size = buffer_size;
+	uring->buffers = (struct uring_buffer*) calloc(buffer_count, sizeof(*uring->buffers));
+	uring->free = (unsigned*) calloc(buffer_count, sizeof(*uring->free));
+	uring->queue = (unsigned*) calloc(buffer_count, sizeof(*uring->queue));
+	if(!uring->buffers || !uring->free || !uring->queue) {
+		fprintf(stderr, "dlg_uring_create: allocation failed\n");
+		free(uring->buffers);
+		free(uring->free);
+		free(uring->queue);
+		free(uring);
+		free(memory);
+		close(fd);
+		return NULL;
+	}
+
+	for(unsigned i = 0u; i < buffer_count; ++i) {
+		uring->buffers[i].data = memory + (size_t) i * buffer_size;
+		uring->free[buffer_count - i - 1] = i;
+	}
+	uring->free_count = buffer_count;
+
+	pthread_mutex_init(&uring->mutex, NULL);
+	pthread_cond_init(&uring->work, NULL);
+	pthread_cond_init(&uring->idle, NULL);
+
+	if(flags & dlg_uring_index) {
+		uring->index = dlg_index_create(path, 0, false);
+	}
+
+#ifdef DLG_HAVE_IO_URING
+	uring->async = !(flags & dlg_uring_threads) && ring_init(uring);
+#endif
+
+	void* (*thread)(void*) = writer_thread;
+	unsigned thread_count = DLG_URING_THREADS;
+#ifdef DLG_HAVE_IO_URING
+	if(uring->async) {
+		thread = ring_thread;
+		thread_count = 1u;
+	}
+#endif
+
+	for(unsigned i = 0u; i < thread_count; ++i) {
+		if(pthread_create(&uring->threads[i], NULL, thread, uring) != 0) {
+			break;
+		}
+		++uring->thread_count;
+	}
+
+	if(!uring->thread_count) {
+		fprintf(stderr, "dlg_uring_create: could not start the threads\n");
+		dlg_uring_destroy(uring);
+		return NULL;
+	}
+
+	return uring;
+}
+
+void dlg_uring_destroy(struct dlg_uring* uring) {
+	if(!uring) {
+		return;
+	}
+
+	pthread_mutex_lock(&uring->mutex);
+	submit_locked(uring);
+	while(uring->pending && uring->thread_count) {
+		pthread_cond_wait(&uring->idle, &uring->mutex);
+	}
+
+	uring->stop = true;
+	pthread_cond_broadcast(&uring->work);
+#ifdef DLG_HAVE_IO_URING
+	if(uring->async) {
+		ring_wake(uring);
+	}
+#endif
+	pthread_mutex_unlock(&uring->mutex);
+
+	for(unsigned i = 0u; i < uring->thread_count; ++i) {
+		pthread_join(uring->threads[i], NULL);
+	}
+
+#ifdef DLG_HAVE_IO_URING
+	if(uring->async) {
+		ring_destroy(uring); // unregisters the buffers
+	}
+#endif
+
+	dlg_index_destroy(uring->index);
+	pthread_cond_destroy(&uring->work);
+	pthread_cond_destroy(&uring->idle);
+	pthread_mutex_destroy(&uring->mutex);
+	close(uring->fd);
+	free(uring->buffers[0].data);
+	free(uring->buffers);
+	free(uring->free);
+	free(uring->queue);
+	free(uring);
+}
+
+void dlg_uring_flush(struct dlg_uring* uring) {
+	pthread_mutex_lock(&uring->mutex);
+	submit_locked(uring);
+	pthread_mutex_unlock(&uring->mutex);
+}
+
+bool dlg_uring_write(struct dlg_uring* uring, const char* data, size_t size) {
+	size = (size < uring->buffer_size) ? size : uring->buffer_size;
+	pthread_mutex_lock(&uring->mutex);
+	struct uring_buffer* buf = buffer_locked(uring, size);
+	if(!buf) {
+		++uring->dropped;
+		pthread_mutex_unlock(&uring->mutex);
+		return false;
+	}
+
+	if(uring->index) {
+		// the current buffer is submitted next, at uring->offset
+		dlg_index_add_json(uring->index, uring->offset + buf->size, data, size);
+	}
+
+	memcpy(buf->data + buf->size, data, size);
+	buf->size += size;
+	pthread_mutex_unlock(&uring->mutex);
+	return true;
+}
+
+// Renders the record into buf, see dlg_generic_output_buf.
+static void render_buf(struct dlg_uring* uring, char* buf, size_t* size,
+		const struct dlg_origin* origin, const char* string) {
+	if(uring->flags & dlg_uring_json) {
+		dlg_generic_output_json_buf(buf, size, origin, string);
+	} else {
+		dlg_generic_output_buf(buf, size, dlg_output_file_line | dlg_output_newline,
+			origin, string, dlg_default_output_styles);
+	}
+}
+
+// Renders the record into the stack buffer or, if it does not fit,
+// into *heap. Returns the size, cut off at the buffer size.
+static size_t render(struct dlg_uring* uring, const struct dlg_origin* origin,
+		const char* string, char* stack, size_t stack_size, char** heap) {
+	size_t size = stack_size;
+	render_buf(uring, stack, &size, origin, string);
+	if(size < stack_size - 1) {
+		return size;
+	}
+
+	// possibly cut off
+	render_buf(uring, NULL, &size, origin, string);
+	size = (size < uring->buffer_size) ? size : uring->buffer_size;
+	if(!(*heap = (char*) malloc(size + 1))) {
+		return stack_size - 1;
+	}
+
+	++size;
+	render_buf(uring, *heap, &size, origin, string);
+	return size;
+}
+
+void dlg_uring_output(const struct dlg_origin* origin, const char* string, void* data) {
+	struct dlg_uring* uring = (struct dlg_uring*) data;
+
+	// render outside the lock, usually on the stack
+	char stack[1024];
+	char* heap = NULL;
+	size_t size = render(uring, origin, string, stack, sizeof(stack), &heap);
+	dlg_uring_write(uring, heap ? heap : stack, size);
+	free(heap);
+
+	if(origin->level >= dlg_level_error) {
+		dlg_uring_flush(uring);
+	}
+}
+
+bool dlg_uring_async(struct dlg_uring* uring) {
+	return uring->async;
+}
+
+unsigned long long dlg_uring_dropped(struct dlg_uring* uring) {
+	pthread_mutex_lock(&uring->mutex);
+	unsigned long long ret = uring->dropped;
+	pthread_mutex_unlock(&uring->mutex);
+	return ret;
+}
+
+unsigned long long dlg_uring_errors(struct dlg_uring* uring) {
+	pthread_mutex_lock(&uring->mutex);
+	unsigned long long ret = uring->errors;
+	pthread_mutex_unlock(&uring->mutex);
+	return ret;
+}
@@ -0,0 +1,73 @@
+#!/usr/bin/env python3
+# Generates dlg_impl.h, the single header version of dlg: dlg.h, output.h
+# and the implementation from dlg.c, which is only compiled when
+# DLG_IMPLEMENTATION is defined.
+# Usage: amalgamate.py <output> <dlg.h> <output.h> <dlg.c> [version]
+
+import re
+import sys
+
+include_dlg = re.compile(r'^\s*#\s*include\s*<dlg/[a-z]+\.h>\s*$')
+copyright = re.compile(r'^// (Copyright|Distributed under|See accompanying)')
+
+def read(path):
+	with open(path) as f:
+		return [l for l in f.read().splitlines() if not include_dlg.match(l)]
+
+def strip_copyright(lines):
+	while lines and (copyright.match(lines[0]) or not lines[0].strip()):
+		lines = lines[1:]
+	return lines
+
+def main():
+	if len(sys.argv) < 5:
+		print('usage: amalgamate.py <output> <dlg.h> <output.h> <dlg.c> [version]',
+			file=sys.stderr)
+		return 1
+
+	output, dlg_h, output_h, dlg_c = sys.argv[1:5]
+	version = ' ' + sys.argv[5] if len(sys.argv) > 5 else ''
+	header = read(dlg_h)
+	out_header = strip_copyright(read(output_h))
+	source = strip_copyright(read(dlg_c))
+
+	# feature test macros of dlg.c must come before any system header
+	first_include = next(i for i, l in enumerate(source) if l.startswith('#include'))
+	prologue, source = source[:first_include], source[first_include:]
+	while prologue and not prologue[-1].strip():
+		prologue.pop()
+
+	lines = header[:3] + [
+		'',
+		'// Single header version of dlg{}, generated from dlg.h, output.h and'.format(version),
+		'// dlg.c by src/tools/amalgamate.py, do not edit.',
+		'// Include it instead of dlg.h and output.h. In exactly one c (not c++)',
+		'// source file, define DLG_IMPLEMENTATION and include it before any other',
+		'// header to compile the implementation. Putting the implementation into',
+		'// the same translation unit as the logging code (or using lto) allows',
+		'// the compiler to inline the library functions into the callers.',
+		'',
+		'#ifndef DLG_STATIC',
+		'	#define DLG_STATIC',
+		'#endif',
+		'',
+		'#if defined(DLG_IMPLEMENTATION) && !defined(DLG_IMPL_H_IMPLEMENTED_)',
+	] + prologue + [
+		'#endif',
+		'',
+	] + header[3:] + [''] + out_header + [
+		'',
+		'#if defined(DLG_IMPLEMENTATION) && !defined(DLG_IMPL_H_IMPLEMENTED_)',
+		'#define DLG_IMPL_H_IMPLEMENTED_',
+		'',
+	] + source + [
+		'',
+		'#endif // DLG_IMPLEMENTATION',
+	]
+
+	with open(output, 'w') as f:
+		f.write('\n'.join(lines) + '\n')
+	return 0
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,460 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Query tool for json lines log files with a sidecar index (dlg/index.h).
+// Prints the records matching all given filters in file order. Blocks the
+// index rules out are skipped, the remaining ones (and parts of the file
+// not covered by the index) are scanned in parallel.
+// Usage:
+//  dlg-query [-l level] [-t tag]... [-s time] [-e time] [-j threads] [-c] [-v] <log>
+//  dlg-query -i [-b block size] <log>
+//  -i: (re)build the index <log>.idx of an existing file
+//  -l: minimum level (trace, debug, info, warn, error, fatal)
+//  -t: only records with the given tag, all given tags must match
+//  -s, -e: only records with start <= time < end; utc, trailing parts may be
+//      omitted, e.g. -s 2026-10-18T10:00 -e 2026-10-18T10:05
+//  -j: number of threads (number of cores by default)
+//  -c: only print the number of matching records
+//  -v: print how much of the file was scanned to stderr
+// When filters are given, records that can't be parsed never match.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlg/index.h>
+#include <dlg/output.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// size of the pieces not covered by the index are split into
+#define CHUNK_SIZE (256u * 1024u)
+
+static const char* const level_names[] = {
+	"trace", "debug", "info", "warn", "error", "fatal"
+};
+
+struct query {
+	int level; // -1 if not filtered
+	char** tags; // escaped as in the log
+	unsigned tag_count;
+	uint64_t tag_bits;
+	bool time;
+	int64_t start;
+	int64_t end;
+	bool count_only;
+};
+
+struct range {
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct result {
+	char* buf;
+	size_t size;
+	size_t cap;
+	unsigned long long count;
+	bool failed; // out of memory, matching records are missing
+};
+
+struct job {
+	const char* log;
+	const struct query* query;
+	const struct range* ranges;
+	struct result* results;
+	unsigned count;
+	unsigned next; // atomic
+};
+
+static bool filtered(const struct query* query) {
+	return query->level >= 0 || query->tag_count || query->time;
+}
+
+static bool block_matches(const struct query* query, const struct dlg_index_block* block) {
+	if(block->levels & DLG_INDEX_UNKNOWN) {
+		return true;
+	}
+
+	if(query->level >= 0 && !(block->levels & (0x3fu << query->level))) {
+		return false;
+	}
+
+	if((block->tags & query->tag_bits) != query->tag_bits) {
+		return false;
+	}
+
+	return !query->time || (block->time_min < query->end && block->time_max >= query->start);
+}
+
+static bool record_matches(const struct query* query, const char* line, size_t size) {
+	if(!filtered(query)) {
+		return true;
+	}
+
+	struct dlg_index_record record;
+	if(!dlg_index_parse(line, size, &record)) {
+		return false;
+	}
+
+	if(query->level >= 0 && (int) record.level < query->level) {
+		return false;
+	}
+
+	if(query->time && (record.time == DLG_INDEX_NO_TIME ||
+			record.time < query->start || record.time >= query->end)) {
+		return false;
+	}
+
+	for(unsigned i = 0u; i < query->tag_count; ++i) {
+		if(!dlg_index_has_tag(&record, query->tags[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void append(struct result* res, const char* data, size_t size) {
+	if(res->size + size > res->cap) {
+		size_t cap = res->cap ? res->cap * 2 : 64u * 1024u;
+		cap = (cap < res->size + size) ? res->size + size : cap;
+		char* buf = (char*) realloc(res->buf, cap);
+		if(!buf) {
+			res->failed = true;
+			return;
+		}
+
+		res->buf = buf;
+		res->cap = cap;
+	}
+
+	memcpy(res->buf + res->size, data, size);
+	res->size += size;
+}
+
+static void scan(struct job* job, const struct range* range, struct result* res) {
+	const char* it = job->log + range->offset;
+	const char* end = it + range->size;
+	while(it < end) {
+		const char* nl = (const char*) memchr(it, '\n', (size_t) (end - it));
+		const char* next = nl ? nl + 1 : end;
+		if(record_matches(job->query, it, (size_t) (next - it))) {
+			++res->count;
+			if(!job->query->count_only && !res->failed) {
+				append(res, it, (size_t) (next - it));
+			}
+		}
+
+		it = next;
+	}
+}
+
+static void* worker(void* data) {
+	struct job* job = (struct job*) data;
+	unsigned i;
+	while((i = __atomic_fetch_add(&job->next, 1u, __ATOMIC_RELAXED)) < job->count) {
+		scan(job, &job->ranges[i], &job->results[i]);
+	}
+	return NULL;
+}
+
+static bool add_range(struct range** ranges, size_t* count, size_t* cap,
+		uint64_t offset, uint64_t size) {
+	if(*count == *cap) {
+		*cap = *cap ? *cap * 2 : 256u;
+		struct range* r = (struct range*) realloc(*ranges, *cap * sizeof(**ranges));
+		if(!r) {
+			return false;
+		}
+		*ranges = r;
+	}
+
+	(*ranges)[*count].offset = offset;
+	(*ranges)[*count].size = size;
+	++*count;
+	return true;
+}
+
+// Splits the part not covered by the index at line ends.
+static bool add_unindexed(struct range** ranges, size_t* count, size_t* cap,
+		const char* log, uint64_t offset, uint64_t end) {
+	while(offset < end) {
+		uint64_t split = end;
+		if(end - offset > CHUNK_SIZE) {
+			const char* nl = (const char*) memchr(log + offset + CHUNK_SIZE, '\n',
+				(size_t) (end - offset - CHUNK_SIZE));
+			split = nl ? (uint64_t) (nl + 1 - log) : end;
+		}
+
+		if(!add_range(ranges, count, cap, offset, split - offset)) {
+			return false;
+		}
+		offset = split;
+	}
+
+	return true;
+}
+
+// Reads the index, returns the number of blocks (0 if there is none).
+static size_t read_index(const char* path, struct dlg_index_block** blocks) {
+	char idx_path[4096];
+	snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+	FILE* file = fopen(idx_path, "rb");
+	*blocks = NULL;
+	if(!file) {
+		return 0u;
+	}
+
+	struct dlg_index_header header;
+	size_t count = 0u;
+	if(fread(&header, sizeof(header), 1, file) == 1 && header.magic == DLG_INDEX_MAGIC &&
+			header.version == DLG_INDEX_VERSION && fseek(file, 0, SEEK_END) == 0) {
+		long size = ftell(file);
+		count = (size > (long) sizeof(header)) ?
+			((size_t) size - sizeof(header)) / sizeof(**blocks) : 0u;
+		*blocks = (struct dlg_index_block*) malloc((count ? count : 1u) * sizeof(**blocks));
+		fseek(file, (long) sizeof(header), SEEK_SET);
+		count = *blocks ? fread(*blocks, sizeof(**blocks), count, file) : 0u;
+	} else {
+		fprintf(stderr, "dlg-query: ignoring invalid index '%s'\n", idx_path);
+	}
+
+	fclose(file);
+	return count;
+}
+
+static int build_index(const char* path, const char* log, size_t size, unsigned block_size) {
+	struct dlg_index* index = dlg_index_create(path, block_size, true);
+	if(!index) {
+		return EXIT_FAILURE;
+	}
+
+	unsigned long long invalid = 0u;
+	for(size_t off = 0u; off < size;) {
+		const char* nl = (const char*) memchr(log + off, '\n', size - off);
+		size_t next = nl ? (size_t) (nl + 1 - log) : size;
+		invalid += !dlg_index_add_json(index, off, log + off, next - off);
+		off = next;
+	}
+
+	dlg_index_destroy(index);
+	if(invalid) {
+		fprintf(stderr, "dlg-query: %llu records could not be parsed\n", invalid);
+	}
+	return EXIT_SUCCESS;
+}
+
+// Returns the tag escaped as the json output writes it (the index hashes and
+// the records contain the escaped bytes), NULL if out of memory.
+static char* escape_tag(const char* tag) {
+	size_t size;
+	dlg_json_escape_buf(NULL, &size, tag, strlen(tag));
+	char* ret = (char*) malloc(++size);
+	if(ret) {
+		dlg_json_escape_buf(ret, &size, tag, strlen(tag));
+	}
+	return ret;
+}
+
+static int usage(const char* name) {
+	fprintf(stderr, "Usage: %s [-l level] [-t tag]... [-s time] [-e time] "
+		"[-j threads] [-c] [-v] <log>\n", name);
+	fprintf(stderr, "       %s -i [-b block size] <log>\n", name);
+	return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+	struct query query;
+	memset(&query, 0, sizeof(query));
+	query.level = -1;
+	query.start = INT64_MIN;
+	query.end = INT64_MAX;
+	query.tags = (char**) calloc((size_t) argc, sizeof(*query.tags));
+
+	bool build = false;
+	bool verbose = false;
+	unsigned block_size = 0u;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	const char* path = NULL;
+	for(int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const char* val = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = true;
+		if(!strcmp(arg, "-i")) {
+			build = true;
+			continue;
+		} else if(!strcmp(arg, "-c")) {
+			query.count_only = true;
+			continue;
+		} else if(!strcmp(arg, "-v")) {
+			verbose = true;
+			continue;
+		} else if(arg[0] != '-' && !path) {
+			path = arg;
+			continue;
+		} else if(!val) {
+			return usage(argv[0]);
+		} else if(!strcmp(arg, "-l")) {
+			query.level = -1;
+			for(int l = 0; l <= dlg_level_fatal; ++l) {
+				query.level = strcmp(val, level_names[l]) ? query.level : l;
+			}
+			ok = query.level >= 0;
+		} else if(!strcmp(arg, "-t")) {
+			char* tag = escape_tag(val);
+			if(!tag) {
+				fprintf(stderr, "dlg-query: out of memory\n");
+				return EXIT_FAILURE;
+			}
+			query.tags[query.tag_count++] = tag;
+			query.tag_bits |= dlg_index_tag_bit(tag, strlen(tag));
+		} else if(!strcmp(arg, "-s")) {
+			query.time = true;
+			ok = dlg_index_parse_time(val, strlen(val), &query.start);
+		} else if(!strcmp(arg, "-e")) {
+			query.time = true;
+			ok = dlg_index_parse_time(val, strlen(val), &query.end);
+		} else if(!strcmp(arg, "-j")) {
+			threads = atol(val);
+		} else if(!strcmp(arg, "-b")) {
+			block_size = (unsigned) atol(val);
+		} else {
+			return usage(argv[0]);
+		}
+
+		if(!ok) {
+			fprintf(stderr, "dlg-query: invalid value '%s' for %s\n", val, arg);
+			return EXIT_FAILURE;
+		}
+		++i;
+	}
+
+	if(!path) {
+		return usage(argv[0]);
+	}
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if(fd < 0 || fstat(fd, &st) != 0) {
+		perror("dlg-query: open");
+		return EXIT_FAILURE;
+	}
+
+	size_t size = (size_t) st.st_size;
+	const char* log = "";
+	if(size) {
+		void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map == MAP_FAILED) {
+			perror("dlg-query: mmap");
+			return EXIT_FAILURE;
+		}
+		log = (const char*) map;
+	}
+	close(fd);
+
+	if(build) {
+		return build_index(path, log, size, block_size);
+	}
+
+	// ranges to scan: matching blocks and everything the index doesn't cover
+	struct dlg_index_block* blocks;
+	size_t block_count = read_index(path, &blocks);
+	struct range* ranges = NULL;
+	size_t range_count = 0u;
+	size_t range_cap = 0u;
+	uint64_t pos = 0u;
+	size_t skipped = 0u;
+	bool ok = true;
+	for(size_t i = 0u; ok && i < block_count; ++i) {
+		const struct dlg_index_block* block = &blocks[i];
+		if(block->offset < pos || block->offset + block->size > size) {
+			continue; // the file was written without index meanwhile
+		}
+
+		ok = add_unindexed(&ranges, &range_count, &range_cap, log, pos, block->offset);
+		if(block_matches(&query, block)) {
+			ok = ok && add_range(&ranges, &range_count, &range_cap, block->offset, block->size);
+		} else {
+			++skipped;
+		}
+		pos = block->offset + block->size;
+	}
+
+	ok = ok && add_unindexed(&ranges, &range_count, &range_cap, log, pos, size);
+	free(blocks);
+	if(!ok) {
+		fprintf(stderr, "dlg-query: out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	// scan in windows to bound the memory held by results
+	threads = (threads < 1) ? 1 : (threads > 256) ? 256 : threads;
+	size_t window = (size_t) threads * 16u;
+	struct result* results = (struct result*) calloc(window, sizeof(*results));
+	pthread_t* handles = (pthread_t*) calloc((size_t) threads, sizeof(*handles));
+	unsigned long long count = 0u;
+	uint64_t scanned = 0u;
+	bool failed = false;
+	for(size_t first = 0u; first < range_count; first += window) {
+		struct job job;
+		job.log = log;
+		job.query = &query;
+		job.ranges = ranges + first;
+		job.results = results;
+		job.count = (unsigned) ((range_count - first < window) ? range_count - first : window);
+		job.next = 0u;
+
+		long spawned = 0;
+		for(; spawned < threads - 1 && (size_t) spawned + 1 < job.count; ++spawned) {
+			if(pthread_create(&handles[spawned], NULL, worker, &job) != 0) {
+				break;
+			}
+		}
+
+		worker(&job);
+		for(long t = 0; t < spawned; ++t) {
+			pthread_join(handles[t], NULL);
+		}
+
+		for(unsigned i = 0u; i < job.count; ++i) {
+			fwrite(results[i].buf, 1, results[i].size, stdout);
+			count += results[i].count;
+			scanned += job.ranges[i].size;
+			failed |= results[i].failed;
+			results[i].size = 0u;
+			results[i].count = 0u;
+		}
+	}
+
+	if(query.count_only) {
+		printf("%llu\n", count);
+	}
+
+	if(verbose) {
+		fprintf(stderr, "dlg-query: scanned %llu of %llu bytes, skipped %zu of %zu blocks\n",
+			(unsigned long long) scanned, (unsigned long long) size, skipped, block_count);
+	}
+
+	for(size_t i = 0u; i < window; ++i) {
+		free(results[i].buf);
+	}
+	free(results);
+	free(handles);
+	free(ranges);
+	for(unsigned i = 0u; i < query.tag_count; ++i) {
+		free(query.tags[i]);
+	}
+	free(query.tags);
+
+	if(failed) {
+		fprintf(stderr, "dlg-query: out of memory, matching records are missing\n");
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2026 Jan Kelling
+// Distributed under the Boost Software License, Version 1.0.
+// See accompanying file LICENSE or copy at http://www.boost.org/LICENSE_1_0.txt
+
+// Collector for the shared memory ring of dlg/shm.h.
+// Drains the ring in order to a file (appending) or stdout until
+// interrupted (SIGINT, SIGTERM), then reads the remaining records.
+// Usage: dlg-shm-collect [-u] [-p] <name> [output file]
+//  -u: remove the shared memory object when exiting
+//  -p: prefix every record with the pid of the writing process
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlg/shm.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void on_signal(int sig) {
+	(void) sig;
+	g_stop = 1;
+}
+
+struct output {
+	FILE* file;
+	bool pid;
+};
+
+static void write_record(const char* record, size_t size, unsigned pid, void* data) {
+	struct output* out = (struct output*) data;
+	if(out->pid) {
+		fprintf(out->file, "%u: ", pid);
+	}
+	fwrite(record, 1, size, out->file);
+}
+
+static int usage(const char* name) {
+	fprintf(stderr, "Usage: %s [-u] [-p] <name> [output file]\n", name);
+	return EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+	bool remove_shm = false;
+	struct output out = {stdout, false};
+	const char* name = NULL;
+	const char* path = NULL;
+	for(int i = 1; i < argc; ++i) {
+		if(!strcmp(argv[i], "-u")) {
+			remove_shm = true;
+		} else if(!strcmp(argv[i], "-p")) {
+			out.pid = true;
+		} else if(!name) {
+			name = argv[i];
+		} else if(!path) {
+			path = argv[i];
+		} else {
+			return usage(argv[0]);
+		}
+	}
+
+	if(!name) {
+		return usage(argv[0]);
+	}
+
+	if(path && !(out.file = fopen(path, "a"))) {
+		perror("dlg-shm-collect: fopen");
+		return EXIT_FAILURE;
+	}
+
+	struct dlg_shm* shm = dlg_shm_open(name, 0, 0);
+	if(!shm) {
+		return EXIT_FAILURE;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = on_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	while(!g_stop) {
+		if(dlg_shm_read(shm, write_record, &out)) {
+			fflush(out.file);
+		}
+		dlg_shm_wait(shm, 100);
+	}
+
+	dlg_shm_read(shm, write_record, &out);
+	fflush(out.file);
+
+	unsigned long long dropped = dlg_shm_dropped(shm);
+	unsigned long long abandoned = dlg_shm_abandoned(shm);
+	if(dropped || abandoned) {
+		fprintf(stderr, "dlg-shm-collect: %llu records dropped, %llu abandoned\n",
+			dropped, abandoned);
+	}
+
+	dlg_shm_close(shm);
+	if(remove_shm) {
+		dlg_shm_unlink(name);
+	}
+	if(out.file != stdout) {
+		fclose(out.file);
+	}
+
+	return EXIT_SUCCESS;
+}